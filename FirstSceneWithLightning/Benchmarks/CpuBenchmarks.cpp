@@ -0,0 +1,441 @@
+// Benchmarks of the CPU side of asset loading and per-frame math, on fixed data so runs can be compared.
+//   cpu_benchmarks [--json <results.json>] [--baseline <results.json>] [--tolerance <percent>] [--filter <text>] [--checks]
+// The reference checks run first and a failed one makes the program exit with 1, --checks runs only them.
+// --json writes the results, --baseline compares the medians with an earlier --json file and exits with 1 if
+// a benchmark got slower by more than --tolerance percent (10 by default), --filter runs only the benchmarks
+// whose name contains the text.
+#include "Camera.h"
+#include "Log.h"
+#include "MeshGenerators.h"
+#include "Model.h"
+#include "OcclusionCulling.h"
+#include "SceneGraph.h"
+#include "SoftwareRenderer.h"
+#include "Shader.h"
+#include "TangentSpace.h"
+#include "ThreadPool.h"
+
+#include <SOIL.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#ifndef BENCHMARK_DATA_DIR
+#define BENCHMARK_DATA_DIR "."
+#endif
+
+struct BenchmarkResult {
+    string name;
+    unsigned int items;      // things processed per run (triangles, boxes, nodes), 1 for a single call
+    unsigned int runsPerSample;
+    double medianNs, minNs, meanNs; // per run
+};
+
+// results have to go somewhere or the compiler drops the work
+static volatile float sink;
+
+// same sequence on every machine and run
+static float random01(unsigned int &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.f / 16777216.f);
+}
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(const string &filter) : filter(filter) {}
+
+    // one warm-up run, then SAMPLES samples of as many runs as fill SAMPLE_MS
+    void Run(const string &name, unsigned int items, const function<void()> &run)
+    {
+        if (!filter.empty() && name.find(filter) == string::npos)
+            return;
+        run();
+        unsigned int runsPerSample = 1;
+        while (runsPerSample < (1u << 24) && measure(run, runsPerSample) < SAMPLE_MS * 1e6 / 4)
+            runsPerSample *= 4;
+        vector<double> samples;
+        for (unsigned int i = 0; i < SAMPLES; i++)
+            samples.push_back(measure(run, runsPerSample) / runsPerSample);
+        std::sort(samples.begin(), samples.end());
+        BenchmarkResult result;
+        result.name = name;
+        result.items = items;
+        result.runsPerSample = runsPerSample;
+        result.medianNs = samples[SAMPLES / 2];
+        result.minNs = samples[0];
+        result.meanNs = 0.0;
+        for (unsigned int i = 0; i < SAMPLES; i++)
+            result.meanNs += samples[i] / SAMPLES;
+        results.push_back(result);
+        printf("%-28s %14.1f ns %12.2f ns/item  (min %.1f, %u x %u runs)\n", name.c_str(), result.medianNs,
+               result.medianNs / items, result.minNs, SAMPLES, runsPerSample);
+    }
+
+    const vector<BenchmarkResult> &GetResults() const
+    {
+        return results;
+    }
+
+private:
+    static const unsigned int SAMPLES = 15;
+    static const unsigned int SAMPLE_MS = 20;
+    string filter;
+    vector<BenchmarkResult> results;
+
+    static double measure(const function<void()> &run, unsigned int runs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < runs; i++)
+            run();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// a UV sphere with normals and texture coordinates as a Wavefront OBJ, the fixed input of the model benchmarks
+static bool writeSphereObj(const string &path, unsigned int rings, unsigned int segments)
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    for (unsigned int r = 0; r <= rings; r++)
+    {
+        float theta = glm::radians(180.f) * r / rings;
+        for (unsigned int s = 0; s <= segments; s++)
+        {
+            float phi = glm::radians(360.f) * s / segments;
+            glm::vec3 normal(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            file << "v " << normal.x << " " << normal.y << " " << normal.z << "\n";
+            file << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+            file << "vt " << (float)s / segments << " " << 1.f - (float)r / rings << "\n";
+        }
+    }
+    for (unsigned int r = 0; r < rings; r++)
+    {
+        for (unsigned int s = 0; s < segments; s++)
+        {
+            unsigned int a = r * (segments + 1) + s + 1, b = a + segments + 1; // OBJ indices start at 1
+            file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+                 << b + 1 << "/" << b + 1 << "/" << b + 1 << "\n";
+            file << "f " << a << "/" << a << "/" << a << " " << b + 1 << "/" << b + 1 << "/" << b + 1 << " "
+                 << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+        }
+    }
+    return (bool)file;
+}
+
+// the software renderer as a reference: two quads under an orthographic camera, the farther one drawn last,
+// have to cover exactly the pixels and leave exactly the depths worked out by hand
+static bool checkSoftwareRenderer()
+{
+    const unsigned int size = 64;
+    ThreadPool pool;
+    SoftwareRenderer renderer(pool, size, size);
+    Mesh quad = createQuadMesh(vector<Texture>(), true);
+    glm::mat4 projection = glm::ortho(-1.f, 1.f, -1.f, 1.f, 0.1f, 10.f);
+    SoftwareMaterial material = { SOFTWARE_UNLIT, nullptr, nullptr, nullptr, glm::vec3(1.f) };
+    // near covers NDC x [0, 1], far x [-0.5, 0.5], both y [-0.5, 0.5]
+    glm::mat4 nearModel = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.5f, 0.f, -3.f)), glm::vec3(0.5f));
+    glm::mat4 farModel = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -5.f)), glm::vec3(0.5f));
+    renderer.BeginFrame(glm::mat4(1.f), projection, glm::vec3(0.f));
+    renderer.DrawMesh(quad, nearModel, material);
+    renderer.DrawMesh(quad, farModel, material);
+    renderer.EndFrame();
+
+    glm::vec4 nearClip = projection * glm::vec4(0.f, 0.f, -3.f, 1.f), farClip = projection * glm::vec4(0.f, 0.f, -5.f, 1.f);
+    float nearDepth = nearClip.z / nearClip.w, farDepth = farClip.z / farClip.w;
+    unsigned int wrongPixels = 0;
+    for (unsigned int y = 0; y < size; y++)
+    {
+        for (unsigned int x = 0; x < size; x++)
+        {
+            // pixel centers, the quads' edges fall between them
+            bool isInRows = y >= size / 4 && y < size * 3 / 4;
+            float expected = 1.f;
+            if (isInRows && x >= size / 2)
+                expected = nearDepth;
+            else if (isInRows && x >= size / 4)
+                expected = farDepth;
+            wrongPixels += std::fabs(renderer.GetDepth(x, y) - expected) > 1e-5f;
+        }
+    }
+    bool isPassed = wrongPixels == 0 && renderer.GetTriangleCount() == 4;
+    printf("%-28s %s (%u of %u pixels wrong)\n", "software_reference", isPassed ? "ok" : "FAILED", wrongPixels, size * size);
+    return isPassed;
+}
+
+static void writeJson(const string &path, const vector<BenchmarkResult> &results)
+{
+    std::ofstream file(path);
+    file << "{\n  \"benchmarks\": [\n";
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &result = results[i];
+        file << "    { \"name\": \"" << result.name << "\", \"items\": " << result.items
+             << ", \"runs_per_sample\": " << result.runsPerSample << ", \"median_ns\": " << result.medianNs
+             << ", \"min_ns\": " << result.minNs << ", \"mean_ns\": " << result.meanNs
+             << ", \"median_ns_per_item\": " << result.medianNs / result.items << " }"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+}
+
+// name -> median_ns of a file written by writeJson, one benchmark per line
+static vector<pair<string, double>> readJson(const string &path)
+{
+    vector<pair<string, double>> medians;
+    std::ifstream file(path);
+    string line;
+    while (std::getline(file, line))
+    {
+        size_t name = line.find("\"name\": \""), median = line.find("\"median_ns\": ");
+        if (name == string::npos || median == string::npos)
+            continue;
+        name += 9;
+        medians.push_back(make_pair(line.substr(name, line.find('"', name) - name), atof(line.c_str() + median + 13)));
+    }
+    return medians;
+}
+
+// prints the change of every benchmark that is in both, returns how many got slower than the tolerance allows
+static unsigned int compareWithBaseline(const vector<BenchmarkResult> &results, const vector<pair<string, double>> &baseline,
+                                        double tolerancePercent)
+{
+    unsigned int regressions = 0;
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        for (unsigned int j = 0; j < baseline.size(); j++)
+        {
+            if (baseline[j].first != results[i].name || baseline[j].second <= 0.0)
+                continue;
+            double change = (results[i].medianNs / baseline[j].second - 1.0) * 100.0;
+            bool isRegression = change > tolerancePercent;
+            printf("%-28s %+7.1f%%%s\n", results[i].name.c_str(), change, isRegression ? "  REGRESSION" : "");
+            regressions += isRegression;
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    string jsonPath, baselinePath, filter;
+    double tolerancePercent = 10.0;
+    bool isChecksOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "--checks")
+            isChecksOnly = true;
+        else if (i + 1 >= argc)
+            break;
+        else if (option == "--json")
+            jsonPath = argv[++i];
+        else if (option == "--baseline")
+            baselinePath = argv[++i];
+        else if (option == "--tolerance")
+            tolerancePercent = atof(argv[++i]);
+        else if (option == "--filter")
+            filter = argv[++i];
+    }
+    if (!checkSoftwareRenderer())
+        return 1;
+    if (isChecksOnly)
+        return 0;
+    const string dataDir = BENCHMARK_DATA_DIR;
+    BenchmarkRunner runner(filter);
+
+    // model import: Assimp alone, then with the conversion into Mesh (Model::processMesh); the difference is the conversion
+    const string spherePath = "benchmark_sphere.obj";
+    const unsigned int sphereTriangles = 64 * 128 * 2;
+    if (writeSphereObj(spherePath, 64, 128)) {
+        runner.Run("assimp_read_sphere", sphereTriangles, [&]() {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(spherePath, MODEL_IMPORT_FLAGS);
+            sink = sink + (scene ? (float)scene->mNumMeshes : 0.f);
+        });
+        runner.Run("model_load_sphere", sphereTriangles, [&]() {
+            Model model(spherePath, false, true);
+            sink = sink + (float)model.meshes.size();
+        });
+        std::remove(spherePath.c_str());
+    } else {
+        LOG(LOG_ERROR) << "Couldn't write " << spherePath << ", the model benchmarks are skipped";
+    }
+
+    // tangents of a 256x256 quad grid with jittered positions and texture coordinates, as createQuadMesh does them
+    {
+        const unsigned int gridSize = 256;
+        vector<glm::vec3> positions;
+        vector<glm::vec2> uvs;
+        unsigned int state = 1;
+        for (unsigned int y = 0; y <= gridSize; y++)
+        {
+            for (unsigned int x = 0; x <= gridSize; x++)
+            {
+                positions.push_back(glm::vec3(x + random01(state) * 0.3f, y + random01(state) * 0.3f, random01(state)));
+                uvs.push_back(glm::vec2((float)x / gridSize, (float)y / gridSize) + glm::vec2(random01(state), random01(state)) * 0.001f);
+            }
+        }
+        runner.Run("quad_tangents", gridSize * gridSize * 2, [&]() {
+            glm::vec3 tangent, bitangent, sum(0.f);
+            for (unsigned int y = 0; y < gridSize; y++)
+            {
+                for (unsigned int x = 0; x < gridSize; x++)
+                {
+                    unsigned int a = y * (gridSize + 1) + x, b = a + gridSize + 1;
+                    calculateTriangleTangents(positions[a], positions[b], positions[b + 1], uvs[a], uvs[b], uvs[b + 1], tangent, bitangent);
+                    sum += tangent + bitangent;
+                    calculateTriangleTangents(positions[a], positions[b + 1], positions[a + 1], uvs[a], uvs[b + 1], uvs[a + 1], tangent, bitangent);
+                    sum += tangent + bitangent;
+                }
+            }
+            sink = sink + sum.x;
+        });
+
+        // the same grid as one indexed mesh through GenerateTangents, in place and on the pool
+        vector<Vertex> vertices(positions.size());
+        for (unsigned int i = 0; i < positions.size(); i++)
+        {
+            vertices[i].Position = positions[i];
+            vertices[i].Normal = glm::vec3(0.f, 0.f, 1.f);
+            vertices[i].TexCoords = uvs[i];
+        }
+        vector<unsigned int> indices;
+        for (unsigned int y = 0; y < gridSize; y++)
+        {
+            for (unsigned int x = 0; x < gridSize; x++)
+            {
+                unsigned int a = y * (gridSize + 1) + x, b = a + gridSize + 1;
+                unsigned int quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        ThreadPool pool;
+        runner.Run("mesh_tangents", gridSize * gridSize * 2, [&]() {
+            GenerateTangents(vertices, indices);
+            sink = sink + vertices[0].Tangent.x;
+        });
+        runner.Run("mesh_tangents_parallel", gridSize * gridSize * 2, [&]() {
+            GenerateTangents(vertices, indices, &pool);
+            sink = sink + vertices[0].Tangent.x;
+        });
+    }
+
+    // the decode step of TextureFromFile, a JPEG and a TGA of the scene
+    const string textures[2] = { dataDir + "/Textures/Bricks/bricks.jpg", dataDir + "/Textures/Skybox/posx.tga" };
+    const string textureNames[2] = { "texture_decode_jpg", "texture_decode_tga" };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        int width, height, components;
+        unsigned char *data = SOIL_load_image(textures[i].c_str(), &width, &height, &components, 0);
+        if (!data) {
+            LOG(LOG_ERROR) << "Couldn't load " << textures[i] << ", " << textureNames[i] << " is skipped";
+            continue;
+        }
+        SOIL_free_image_data(data);
+        runner.Run(textureNames[i], width * height, [&]() {
+            unsigned char *data = SOIL_load_image(textures[i].c_str(), &width, &height, &components, 0);
+            sink = sink + (data ? data[0] : 0);
+            SOIL_free_image_data(data);
+        });
+    }
+
+    // what the Shader constructors read before handing the source to GL
+    const string shaderPaths[2] = { dataDir + "/Shaders/ParallaxMapping/pm_quad.vert", dataDir + "/Shaders/ParallaxMapping/pm_quad.frag" };
+    runner.Run("shader_source_load", 2, [&]() {
+        for (unsigned int i = 0; i < 2; i++)
+            sink = sink + (float)Shader::LoadSource(shaderPaths[i].c_str()).size();
+    });
+
+    // mouse look: updateCameraVectors through ProcessMouseMovement, then the view matrix
+    {
+        Camera camera(glm::vec3(0.f, 1.f, 3.f));
+        float direction = 1.f;
+        runner.Run("camera_look", 1, [&]() {
+            camera.ProcessMouseMovement(3.f * direction, 1.f * direction);
+            direction = -direction;
+            sink = sink + camera.GetViewMatrix()[3][0];
+        });
+    }
+
+    // 64 objects of 63 nodes each, every object moves every frame
+    {
+        SceneGraph graph;
+        vector<NodeId> roots;
+        unsigned int state = 2;
+        for (unsigned int object = 0; object < 64; object++)
+        {
+            NodeId root = graph.AddNode(NO_PARENT, glm::translate(glm::mat4(1.f), glm::vec3(object * 2.f, 0.f, 0.f)));
+            roots.push_back(root);
+            vector<NodeId> nodes(1, root);
+            for (unsigned int i = 1; i < 63; i++)
+                nodes.push_back(graph.AddNode(nodes[(i - 1) / 2], glm::translate(glm::mat4(1.f), glm::vec3(random01(state), 1.f, random01(state)))));
+        }
+        float angle = 0.f;
+        runner.Run("scene_graph_update", graph.Size(), [&]() {
+            angle += 0.01f;
+            for (unsigned int i = 0; i < roots.size(); i++)
+                graph.SetLocalTransform(roots[i], glm::vec3(i * 2.f, 0.f, 0.f), glm::angleAxis(angle, glm::vec3(0.f, 1.f, 0.f)), glm::vec3(1.f));
+            sink = sink + (float)graph.UpdateWorldTransforms();
+        });
+    }
+
+    // view frustum and occlusion tests of 4096 boxes scattered around a wall, the way SceneLoader::CullOccluded runs them
+    {
+        ThreadPool pool;
+        OcclusionCuller culler(pool);
+        Mesh wall = createQuadMesh(vector<Texture>(), true);
+        glm::mat4 wallModel = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -5.f)), glm::vec3(4.f, 2.f, 1.f));
+        glm::mat4 viewProjection = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 100.f)
+            * glm::lookAt(glm::vec3(0.f, 0.f, 3.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+        vector<glm::vec3> boxes;
+        unsigned int state = 3;
+        for (unsigned int i = 0; i < 4096; i++)
+            boxes.push_back(glm::vec3(random01(state) * 40.f - 20.f, random01(state) * 10.f - 5.f, random01(state) * -40.f));
+        runner.Run("occlusion_cull_boxes", boxes.size(), [&]() {
+            culler.BeginFrame(viewProjection);
+            culler.AddOccluder(wallModel, wall.vertices, wall.indices);
+            culler.Rasterize();
+            unsigned int visible = 0;
+            for (unsigned int i = 0; i < boxes.size(); i++)
+                visible += culler.IsVisible(boxes[i] - glm::vec3(0.5f), boxes[i] + glm::vec3(0.5f));
+            sink = sink + (float)visible;
+        });
+    }
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath, runner.GetResults());
+        printf("Results written to %s\n", jsonPath.c_str());
+    }
+    if (!baselinePath.empty()) {
+        vector<pair<string, double>> baseline = readJson(baselinePath);
+        if (baseline.empty()) {
+            LOG(LOG_ERROR) << "Couldn't read any results from " << baselinePath;
+            return 1;
+        }
+        unsigned int regressions = compareWithBaseline(runner.GetResults(), baseline, tolerancePercent);
+        if (regressions > 0) {
+            printf("%u benchmarks are more than %.0f%% slower than %s\n", regressions, tolerancePercent, baselinePath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
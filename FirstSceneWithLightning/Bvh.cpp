@@ -0,0 +1,565 @@
+#include "Bvh.h"
+#include "Simd.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+static const float NO_ENTRY = std::numeric_limits<float>::infinity();
+
+// half the surface area, the SAH only compares them
+static float halfArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+    glm::vec3 extent = boundsMax - boundsMin;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// distance along the ray to where it enters the box, NO_ENTRY if it misses it before tMax
+static float intersectBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::vec3 &origin, const glm::vec3 &invDirection, float tMax)
+{
+    glm::vec3 t1 = (boundsMin - origin) * invDirection;
+    glm::vec3 t2 = (boundsMax - origin) * invDirection;
+    float tNear = max(max(min(t1.x, t2.x), min(t1.y, t2.y)), max(min(t1.z, t2.z), 0.f));
+    float tFar = min(min(max(t1.x, t2.x), max(t1.y, t2.y)), min(max(t1.z, t2.z), tMax));
+    return tNear <= tFar ? tNear : NO_ENTRY;
+}
+
+void Bvh::Build(const Model &model, ThreadPool &pool)
+{
+    nodes.clear();
+    triangles.clear();
+    // node transforms relative to the model's root, parents are stored before their children
+    vector<glm::mat4> nodeTransforms(model.nodes.size());
+    vector<Triangle> source;
+    unsigned int uploadedOnlyCount = 0;
+    for (unsigned int n = 0; n < model.nodes.size(); n++)
+    {
+        const ModelNode &modelNode = model.nodes[n];
+        nodeTransforms[n] = modelNode.parent < 0 ? modelNode.transform : nodeTransforms[modelNode.parent] * modelNode.transform;
+        for (unsigned int m = 0; m < modelNode.meshes.size(); m++)
+        {
+            const Mesh &mesh = model.meshes[modelNode.meshes[m]];
+            if ((mesh.indexCount > 0 && mesh.indices.empty()) || (mesh.vertexCount > 0 && mesh.vertices.empty())) {
+                uploadedOnlyCount++;
+                continue;
+            }
+            unsigned int cornerCount = mesh.indices.empty() ? mesh.vertices.size() : mesh.indices.size();
+            for (unsigned int i = 0; i + 2 < cornerCount; i += 3)
+            {
+                glm::vec3 corners[3];
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    unsigned int vertex = mesh.indices.empty() ? i + c : mesh.indices[i + c];
+                    corners[c] = glm::vec3(nodeTransforms[n] * glm::vec4(mesh.vertices[vertex].Position, 1.f));
+                }
+                Triangle triangle;
+                triangle.v0 = corners[0];
+                triangle.edge1 = corners[1] - corners[0];
+                triangle.edge2 = corners[2] - corners[0];
+                triangle.mesh = modelNode.meshes[m];
+                triangle.index = i / 3;
+                source.push_back(triangle);
+            }
+        }
+    }
+    if (uploadedOnlyCount > 0) {
+        LOG(LOG_ERROR) << "ERROR::BVH::BUILD:: " << uploadedOnlyCount << " mesh instances of " << model.directory
+            << " have no CPU copy and are left out, load the model CPU-only or with isCpuDataKept";
+    }
+    if (source.empty())
+        return;
+
+    vector<BuildPrimitive> primitives(source.size());
+    vector<unsigned int> order(source.size());
+    for (unsigned int i = 0; i < source.size(); i++)
+    {
+        glm::vec3 v1 = source[i].v0 + source[i].edge1, v2 = source[i].v0 + source[i].edge2;
+        primitives[i].boundsMin = glm::min(source[i].v0, glm::min(v1, v2));
+        primitives[i].boundsMax = glm::max(source[i].v0, glm::max(v1, v2));
+        primitives[i].centroid = (primitives[i].boundsMin + primitives[i].boundsMax) * 0.5f;
+        order[i] = i;
+    }
+
+    // enough subtrees for every thread to get a few of them
+    unsigned int taskDepth = 0;
+    while (pool.GetThreadCount() > 1 && (1u << taskDepth) < pool.GetThreadCount() * 4)
+        taskDepth++;
+    vector<BuildTask> tasks;
+    nodes.reserve(source.size() * 2 / MAX_LEAF_SIZE + 1);
+    nodes.push_back(Node());
+    buildNode(nodes, 0, 0, source.size(), primitives, order, 0, taskDepth, pool.GetThreadCount() > 1 ? &tasks : nullptr);
+    pool.ParallelFor(tasks.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int t = begin; t < end; t++)
+        {
+            BuildTask &task = tasks[t];
+            task.nodes.push_back(Node());
+            // the tasks work on disjoint ranges of order, so they can partition it in place side by side
+            buildNode(task.nodes, 0, task.begin, task.end, primitives, order, task.depth, 0, nullptr);
+        }
+    });
+    // splice the subtrees in: the root replaces the placeholder, the rest goes to the end
+    for (unsigned int t = 0; t < tasks.size(); t++)
+    {
+        const vector<Node> &local = tasks[t].nodes;
+        unsigned int base = nodes.size();
+        for (unsigned int j = 0; j < local.size(); j++)
+        {
+            Node node = local[j];
+            if (node.count == 0)
+                node.leftOrFirst = base + node.leftOrFirst - 1;
+            if (j == 0)
+                nodes[tasks[t].node] = node;
+            else
+                nodes.push_back(node);
+        }
+    }
+    triangles.resize(source.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        triangles[i] = source[order[i]];
+}
+
+RayHit Bvh::Intersect(const Ray &ray) const
+{
+    RayHit hit;
+    traceSingle<false>(ray, hit);
+    return hit;
+}
+
+bool Bvh::IsOccluded(const Ray &ray) const
+{
+    RayHit hit;
+    traceSingle<true>(ray, hit);
+    return hit.IsHit();
+}
+
+void Bvh::IntersectPacket(const Ray rays[4], RayHit hits[4]) const
+{
+    tracePacket<false>(rays, hits);
+}
+
+void Bvh::IsOccludedPacket(const Ray rays[4], bool occluded[4]) const
+{
+    RayHit hits[4];
+    tracePacket<true>(rays, hits);
+    for (unsigned int i = 0; i < 4; i++)
+        occluded[i] = hits[i].IsHit();
+}
+
+void Bvh::IntersectBatch(const vector<Ray> &rays, vector<RayHit> &hits, ThreadPool &pool) const
+{
+    hits.resize(rays.size());
+    unsigned int packetCount = (rays.size() + 3) / 4;
+    pool.ParallelFor(packetCount, 64, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int p = begin; p < end; p++)
+        {
+            Ray packet[4];
+            RayHit packetHits[4];
+            for (unsigned int i = 0; i < 4; i++)
+                packet[i] = p * 4 + i < rays.size() ? rays[p * 4 + i] : Ray(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), -1.f);
+            IntersectPacket(packet, packetHits);
+            for (unsigned int i = 0; i < 4 && p * 4 + i < rays.size(); i++)
+                hits[p * 4 + i] = packetHits[i];
+        }
+    });
+}
+
+void Bvh::IsOccludedBatch(const vector<Ray> &rays, vector<unsigned char> &occluded, ThreadPool &pool) const
+{
+    occluded.resize(rays.size());
+    unsigned int packetCount = (rays.size() + 3) / 4;
+    pool.ParallelFor(packetCount, 64, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int p = begin; p < end; p++)
+        {
+            Ray packet[4];
+            bool packetOccluded[4];
+            for (unsigned int i = 0; i < 4; i++)
+                packet[i] = p * 4 + i < rays.size() ? rays[p * 4 + i] : Ray(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), -1.f);
+            IsOccludedPacket(packet, packetOccluded);
+            for (unsigned int i = 0; i < 4 && p * 4 + i < rays.size(); i++)
+                occluded[p * 4 + i] = packetOccluded[i];
+        }
+    });
+}
+
+unsigned int Bvh::GetNodeCount() const
+{
+    return nodes.size();
+}
+
+unsigned int Bvh::GetTriangleCount() const
+{
+    return triangles.size();
+}
+
+glm::vec3 Bvh::GetBoundsMin() const
+{
+    return nodes.empty() ? glm::vec3(0.f) : nodes[0].boundsMin;
+}
+
+glm::vec3 Bvh::GetBoundsMax() const
+{
+    return nodes.empty() ? glm::vec3(0.f) : nodes[0].boundsMax;
+}
+
+void Bvh::buildNode(vector<Node> &target, unsigned int node, unsigned int begin, unsigned int end,
+                    const vector<BuildPrimitive> &primitives, vector<unsigned int> &order,
+                    unsigned int depth, unsigned int taskDepth, vector<BuildTask> *tasks) const
+{
+    glm::vec3 boundsMin(NO_ENTRY), boundsMax(-NO_ENTRY), centroidMin(NO_ENTRY), centroidMax(-NO_ENTRY);
+    for (unsigned int i = begin; i < end; i++)
+    {
+        const BuildPrimitive &primitive = primitives[order[i]];
+        boundsMin = glm::min(boundsMin, primitive.boundsMin);
+        boundsMax = glm::max(boundsMax, primitive.boundsMax);
+        centroidMin = glm::min(centroidMin, primitive.centroid);
+        centroidMax = glm::max(centroidMax, primitive.centroid);
+    }
+    target[node].boundsMin = boundsMin;
+    target[node].boundsMax = boundsMax;
+    unsigned int count = end - begin;
+    // past STACK_SIZE levels the rest stays in one leaf, however big, so that traversal can't overflow its stack
+    if (count <= 2 || depth >= STACK_SIZE) {
+        target[node].leftOrFirst = begin;
+        target[node].count = count;
+        return;
+    }
+    if (tasks && depth >= taskDepth && count > 1024) {
+        BuildTask task;
+        task.node = node;
+        task.begin = begin;
+        task.end = end;
+        task.depth = depth;
+        tasks->push_back(task);
+        target[node].count = 0;
+        return;
+    }
+
+    // binned SAH over all three axes
+    float bestCost = NO_ENTRY;
+    int bestAxis = -1;
+    unsigned int bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.f)
+            continue;
+        float scale = BIN_COUNT / extent;
+        unsigned int binCounts[BIN_COUNT] = { 0 };
+        glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+        for (unsigned int b = 0; b < BIN_COUNT; b++)
+        {
+            binMin[b] = glm::vec3(NO_ENTRY);
+            binMax[b] = glm::vec3(-NO_ENTRY);
+        }
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const BuildPrimitive &primitive = primitives[order[i]];
+            unsigned int bin = min(BIN_COUNT - 1, (unsigned int)((primitive.centroid[axis] - centroidMin[axis]) * scale));
+            binCounts[bin]++;
+            binMin[bin] = glm::min(binMin[bin], primitive.boundsMin);
+            binMax[bin] = glm::max(binMax[bin], primitive.boundsMax);
+        }
+        // costs of the planes between bins from the right side first, then sweep from the left
+        float rightCosts[BIN_COUNT];
+        glm::vec3 sweepMin(NO_ENTRY), sweepMax(-NO_ENTRY);
+        unsigned int sweepCount = 0;
+        for (unsigned int b = BIN_COUNT - 1; b > 0; b--)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b]);
+            sweepMax = glm::max(sweepMax, binMax[b]);
+            sweepCount += binCounts[b];
+            rightCosts[b] = sweepCount ? sweepCount * halfArea(sweepMin, sweepMax) : 0.f;
+        }
+        sweepMin = glm::vec3(NO_ENTRY);
+        sweepMax = glm::vec3(-NO_ENTRY);
+        sweepCount = 0;
+        for (unsigned int b = 1; b < BIN_COUNT; b++)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b - 1]);
+            sweepMax = glm::max(sweepMax, binMax[b - 1]);
+            sweepCount += binCounts[b - 1];
+            if (sweepCount == 0 || sweepCount == count)
+                continue;
+            float cost = sweepCount * halfArea(sweepMin, sweepMax) + rightCosts[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // traversal and intersection cost the same, a split has to beat testing every triangle
+    float leafCost = (float)count;
+    float splitCost = 1.f + bestCost / max(halfArea(boundsMin, boundsMax), 1e-20f);
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= leafCost)) {
+        target[node].leftOrFirst = begin;
+        target[node].count = count;
+        return;
+    }
+    unsigned int middle;
+    if (bestAxis < 0) {
+        // every centroid in the same place, any split is as good
+        middle = begin + count / 2;
+    } else {
+        float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        float axisMin = centroidMin[bestAxis];
+        middle = std::partition(order.begin() + begin, order.begin() + end, [&](unsigned int primitive) {
+            return min(BIN_COUNT - 1, (unsigned int)((primitives[primitive].centroid[bestAxis] - axisMin) * scale)) < bestSplit;
+        }) - order.begin();
+    }
+    unsigned int left = target.size();
+    target.push_back(Node());
+    target.push_back(Node());
+    target[node].leftOrFirst = left;
+    target[node].count = 0;
+    buildNode(target, left, begin, middle, primitives, order, depth + 1, taskDepth, tasks);
+    buildNode(target, left + 1, middle, end, primitives, order, depth + 1, taskDepth, tasks);
+}
+
+bool Bvh::intersectTriangle(const Triangle &triangle, const Ray &ray, float &t, float &u, float &v) const
+{
+    glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+    float determinant = glm::dot(triangle.edge1, p);
+    // both faces count
+    if (std::fabs(determinant) < 1e-12f)
+        return false;
+    float invDeterminant = 1.f / determinant;
+    glm::vec3 s = ray.origin - triangle.v0;
+    u = glm::dot(s, p) * invDeterminant;
+    if (u < 0.f || u > 1.f)
+        return false;
+    glm::vec3 q = glm::cross(s, triangle.edge1);
+    v = glm::dot(ray.direction, q) * invDeterminant;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+    t = glm::dot(triangle.edge2, q) * invDeterminant;
+    return t > 0.f;
+}
+
+template <bool isAnyHit>
+void Bvh::traceSingle(const Ray &ray, RayHit &hit) const
+{
+    hit = RayHit();
+    if (nodes.empty() || ray.tMax < 0.f)
+        return;
+    glm::vec3 invDirection = glm::vec3(1.f) / ray.direction;
+    float tMax = ray.tMax;
+    if (intersectBounds(nodes[0].boundsMin, nodes[0].boundsMax, ray.origin, invDirection, tMax) == NO_ENTRY)
+        return;
+    // nodes still to visit and where the ray enters them, skipped once a nearer hit is found
+    unsigned int stack[STACK_SIZE];
+    float stackEntry[STACK_SIZE];
+    unsigned int stackSize = 0;
+    unsigned int current = 0;
+    while (true)
+    {
+        const Node &node = nodes[current];
+        if (node.count) {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+            {
+                float t, u, v;
+                if (intersectTriangle(triangles[i], ray, t, u, v) && t < tMax) {
+                    tMax = t;
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.mesh = triangles[i].mesh;
+                    hit.triangle = triangles[i].index;
+                    if (isAnyHit)
+                        return;
+                }
+            }
+        } else {
+            const Node &left = nodes[node.leftOrFirst], &right = nodes[node.leftOrFirst + 1];
+            float leftEntry = intersectBounds(left.boundsMin, left.boundsMax, ray.origin, invDirection, tMax);
+            float rightEntry = intersectBounds(right.boundsMin, right.boundsMax, ray.origin, invDirection, tMax);
+            unsigned int nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            if (rightEntry < leftEntry) {
+                std::swap(nearChild, farChild);
+                std::swap(leftEntry, rightEntry);
+            }
+            if (leftEntry != NO_ENTRY) {
+                if (rightEntry != NO_ENTRY) {
+                    assert(stackSize < STACK_SIZE);
+                    stack[stackSize] = farChild;
+                    stackEntry[stackSize++] = rightEntry;
+                }
+                current = nearChild;
+                continue;
+            }
+        }
+        // next node from the stack that can still hold something nearer
+        while (stackSize > 0 && stackEntry[stackSize - 1] > tMax)
+            stackSize--;
+        if (stackSize == 0)
+            return;
+        current = stack[--stackSize];
+    }
+}
+
+#if USE_SSE
+struct RayPacket {
+    __m128 originX, originY, originZ;
+    __m128 directionX, directionY, directionZ;
+    __m128 invDirectionX, invDirectionY, invDirectionZ;
+};
+
+// lanes of the packet that enter the box before their tMax, entry is the nearest entry among them
+static __m128 intersectBoundsPacket(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const RayPacket &packet, __m128 tMax, float &entry)
+{
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.x), packet.originX), packet.invDirectionX);
+    __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.x), packet.originX), packet.invDirectionX);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.y), packet.originY), packet.invDirectionY);
+    __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.y), packet.originY), packet.invDirectionY);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.z), packet.originZ), packet.invDirectionZ);
+    __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.z), packet.originZ), packet.invDirectionZ);
+    __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+    __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), tMax));
+    __m128 isHit = _mm_cmple_ps(tNear, tFar);
+    entry = NO_ENTRY;
+    if (_mm_movemask_ps(isHit)) {
+        float entries[4];
+        _mm_storeu_ps(entries, _mm_or_ps(_mm_and_ps(isHit, tNear), _mm_andnot_ps(isHit, _mm_set1_ps(NO_ENTRY))));
+        entry = min(min(entries[0], entries[1]), min(entries[2], entries[3]));
+    }
+    return isHit;
+}
+
+static __m128 blend(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+{
+    return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+#endif
+
+template <bool isAnyHit>
+void Bvh::tracePacket(const Ray rays[4], RayHit hits[4]) const
+{
+#if USE_SSE
+    for (unsigned int i = 0; i < 4; i++)
+        hits[i] = RayHit();
+    if (nodes.empty())
+        return;
+    RayPacket packet;
+    packet.originX = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+    packet.originY = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+    packet.originZ = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+    packet.directionX = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x, rays[3].direction.x);
+    packet.directionY = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y, rays[3].direction.y);
+    packet.directionZ = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z, rays[3].direction.z);
+    const __m128 one = _mm_set1_ps(1.f);
+    packet.invDirectionX = _mm_div_ps(one, packet.directionX);
+    packet.invDirectionY = _mm_div_ps(one, packet.directionY);
+    packet.invDirectionZ = _mm_div_ps(one, packet.directionZ);
+    // rays with a negative tMax never enter a box, that is how finished and padding lanes drop out
+    __m128 tMax = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+    __m128 hitT = tMax, hitU = _mm_setzero_ps(), hitV = _mm_setzero_ps();
+    __m128 isHit = _mm_setzero_ps();
+    __m128i hitTriangle = _mm_set1_epi32(-1);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps(-0.f);
+
+    float entry;
+    if (!_mm_movemask_ps(intersectBoundsPacket(nodes[0].boundsMin, nodes[0].boundsMax, packet, tMax, entry)))
+        return;
+    unsigned int stack[STACK_SIZE];
+    float stackEntry[STACK_SIZE];
+    unsigned int stackSize = 0;
+    unsigned int current = 0;
+    while (true)
+    {
+        const Node &node = nodes[current];
+        if (node.count) {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+            {
+                const Triangle &triangle = triangles[i];
+                __m128 edge1X = _mm_set1_ps(triangle.edge1.x), edge1Y = _mm_set1_ps(triangle.edge1.y), edge1Z = _mm_set1_ps(triangle.edge1.z);
+                __m128 edge2X = _mm_set1_ps(triangle.edge2.x), edge2Y = _mm_set1_ps(triangle.edge2.y), edge2Z = _mm_set1_ps(triangle.edge2.z);
+                // p = direction x edge2
+                __m128 pX = _mm_sub_ps(_mm_mul_ps(packet.directionY, edge2Z), _mm_mul_ps(packet.directionZ, edge2Y));
+                __m128 pY = _mm_sub_ps(_mm_mul_ps(packet.directionZ, edge2X), _mm_mul_ps(packet.directionX, edge2Z));
+                __m128 pZ = _mm_sub_ps(_mm_mul_ps(packet.directionX, edge2Y), _mm_mul_ps(packet.directionY, edge2X));
+                __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+                __m128 invDeterminant = _mm_div_ps(one, determinant);
+                __m128 sX = _mm_sub_ps(packet.originX, _mm_set1_ps(triangle.v0.x));
+                __m128 sY = _mm_sub_ps(packet.originY, _mm_set1_ps(triangle.v0.y));
+                __m128 sZ = _mm_sub_ps(packet.originZ, _mm_set1_ps(triangle.v0.z));
+                __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), invDeterminant);
+                // q = s x edge1
+                __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+                __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+                __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+                __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.directionX, qX), _mm_mul_ps(packet.directionY, qY)), _mm_mul_ps(packet.directionZ, qZ)), invDeterminant);
+                __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), invDeterminant);
+                __m128 isTriangleHit = _mm_cmpgt_ps(_mm_andnot_ps(signBit, determinant), _mm_set1_ps(1e-12f));
+                isTriangleHit = _mm_and_ps(isTriangleHit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+                isTriangleHit = _mm_and_ps(isTriangleHit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+                isTriangleHit = _mm_and_ps(isTriangleHit, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, tMax)));
+                if (!_mm_movemask_ps(isTriangleHit))
+                    continue;
+                hitT = blend(isTriangleHit, t, hitT);
+                hitU = blend(isTriangleHit, u, hitU);
+                hitV = blend(isTriangleHit, v, hitV);
+                __m128i triangleMask = _mm_castps_si128(isTriangleHit);
+                hitTriangle = _mm_or_si128(_mm_and_si128(triangleMask, _mm_set1_epi32((int)i)), _mm_andnot_si128(triangleMask, hitTriangle));
+                isHit = _mm_or_ps(isHit, isTriangleHit);
+                // any hit is enough for a visibility ray, it leaves the packet
+                tMax = blend(isTriangleHit, isAnyHit ? _mm_set1_ps(-1.f) : t, tMax);
+            }
+            if (isAnyHit && _mm_movemask_ps(_mm_cmpge_ps(tMax, zero)) == 0)
+                break;
+        } else {
+            float leftEntry, rightEntry;
+            __m128 isLeftHit = intersectBoundsPacket(nodes[node.leftOrFirst].boundsMin, nodes[node.leftOrFirst].boundsMax, packet, tMax, leftEntry);
+            __m128 isRightHit = intersectBoundsPacket(nodes[node.leftOrFirst + 1].boundsMin, nodes[node.leftOrFirst + 1].boundsMax, packet, tMax, rightEntry);
+            unsigned int nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            bool isNearHit = _mm_movemask_ps(isLeftHit) != 0, isFarHit = _mm_movemask_ps(isRightHit) != 0;
+            if (rightEntry < leftEntry) {
+                std::swap(nearChild, farChild);
+                std::swap(leftEntry, rightEntry);
+                std::swap(isNearHit, isFarHit);
+            }
+            if (isNearHit) {
+                if (isFarHit) {
+                    assert(stackSize < STACK_SIZE);
+                    stack[stackSize] = farChild;
+                    stackEntry[stackSize++] = rightEntry;
+                }
+                current = nearChild;
+                continue;
+            }
+        }
+        // the packet is done with a stack node once every ray has a nearer hit
+        float farthestT[4];
+        _mm_storeu_ps(farthestT, tMax);
+        float packetTMax = max(max(farthestT[0], farthestT[1]), max(farthestT[2], farthestT[3]));
+        while (stackSize > 0 && stackEntry[stackSize - 1] > packetTMax)
+            stackSize--;
+        if (stackSize == 0)
+            break;
+        current = stack[--stackSize];
+    }
+
+    float t[4], u[4], v[4];
+    int triangleIndex[4];
+    _mm_storeu_ps(t, hitT);
+    _mm_storeu_ps(u, hitU);
+    _mm_storeu_ps(v, hitV);
+    _mm_storeu_si128((__m128i *)triangleIndex, hitTriangle);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        if (triangleIndex[i] < 0)
+            continue;
+        hits[i].t = t[i];
+        hits[i].u = u[i];
+        hits[i].v = v[i];
+        hits[i].mesh = triangles[triangleIndex[i]].mesh;
+        hits[i].triangle = triangles[triangleIndex[i]].index;
+    }
+#else
+    for (unsigned int i = 0; i < 4; i++)
+        traceSingle<isAnyHit>(rays[i], hits[i]);
+#endif
+}
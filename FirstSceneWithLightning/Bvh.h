@@ -0,0 +1,99 @@
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "ThreadPool.h"
+
+#include <vector>
+using namespace std;
+
+const unsigned int BVH_NO_HIT = 0xFFFFFFFFu;
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // doesn't have to be normalized, t is measured in its lengths
+    float tMax;          // hits farther than this are ignored, negative for a ray that should hit nothing
+
+    Ray() : origin(0.f), direction(0.f, 0.f, -1.f), tMax(1e30f) {}
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction, float tMax = 1e30f) : origin(origin), direction(direction), tMax(tMax) {}
+};
+
+struct RayHit {
+    float t;
+    float u, v;            // barycentrics of the hit point, weights of the triangle's 2nd and 3rd corners
+    unsigned int mesh;     // index in Model::meshes
+    unsigned int triangle; // index of the triangle in the mesh, BVH_NO_HIT if nothing was hit
+
+    RayHit() : t(1e30f), u(0.f), v(0.f), mesh(BVH_NO_HIT), triangle(BVH_NO_HIT) {}
+    bool IsHit() const { return triangle != BVH_NO_HIT; }
+};
+
+// Bounding volume hierarchy over the triangles of all meshes of a Model, in the model's own space
+// (node transforms of the model file applied). Built top-down with the surface area heuristic over 16 bins,
+// the upper levels on the calling thread and the subtrees below them on the pool's threads.
+// Nodes are one flat array of 32 bytes each, the two children of a node are next to each other.
+// Rays are traced one at a time or in packets of 4 that go through the tree together with SSE.
+class Bvh
+{
+public:
+    // reads the CPU copies of the meshes: the model has to be CPU-only or loaded with isCpuDataKept, GL meshes
+    // drop their copies once uploaded. Meshes without a copy are left out with an error
+    void Build(const Model &model, ThreadPool &pool);
+
+    // nearest hit
+    RayHit Intersect(const Ray &ray) const;
+    // true as soon as anything is hit, for shadow and visibility rays
+    bool IsOccluded(const Ray &ray) const;
+    // 4 rays at once, best when they are close to each other in origin and direction
+    void IntersectPacket(const Ray rays[4], RayHit hits[4]) const;
+    void IsOccludedPacket(const Ray rays[4], bool occluded[4]) const;
+    // any number of rays in packets of 4 over the pool, neighbouring rays should be coherent
+    void IntersectBatch(const vector<Ray> &rays, vector<RayHit> &hits, ThreadPool &pool) const;
+    // 1 for an occluded ray; not vector<bool>, its bits can't be written from several threads
+    void IsOccludedBatch(const vector<Ray> &rays, vector<unsigned char> &occluded, ThreadPool &pool) const;
+
+    unsigned int GetNodeCount() const;
+    unsigned int GetTriangleCount() const;
+    glm::vec3 GetBoundsMin() const;
+    glm::vec3 GetBoundsMax() const;
+
+private:
+    static const unsigned int BIN_COUNT = 16;
+    static const unsigned int MAX_LEAF_SIZE = 8;
+    // deepest node the builder makes, a traversal never has more nodes than that waiting on its stack
+    static const unsigned int STACK_SIZE = 64;
+
+    struct Node {
+        glm::vec3 boundsMin;
+        unsigned int leftOrFirst; // interior: index of the left child, the right one follows it; leaf: first triangle
+        glm::vec3 boundsMax;
+        unsigned int count;       // triangles of a leaf, 0 for an interior node
+    };
+    // Moller-Trumbore form
+    struct Triangle {
+        glm::vec3 v0, edge1, edge2;
+        unsigned int mesh, index;
+    };
+    struct BuildPrimitive {
+        glm::vec3 boundsMin, boundsMax, centroid;
+    };
+    // a subtree left for the pool: its root goes to nodes[node], the rest is built into its own array first
+    struct BuildTask {
+        unsigned int node, begin, end, depth;
+        vector<Node> nodes;
+    };
+
+    vector<Node> nodes;
+    vector<Triangle> triangles;
+
+    void buildNode(vector<Node> &target, unsigned int node, unsigned int begin, unsigned int end,
+                   const vector<BuildPrimitive> &primitives, vector<unsigned int> &order,
+                   unsigned int depth, unsigned int taskDepth, vector<BuildTask> *tasks) const;
+    bool intersectTriangle(const Triangle &triangle, const Ray &ray, float &t, float &u, float &v) const;
+    template <bool isAnyHit> void traceSingle(const Ray &ray, RayHit &hit) const;
+    template <bool isAnyHit> void tracePacket(const Ray rays[4], RayHit hits[4]) const;
+};
+#endif
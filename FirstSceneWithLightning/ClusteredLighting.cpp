@@ -0,0 +1,287 @@
+#include "ClusteredLighting.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Simd.h"
+
+#include <cmath>
+
+const unsigned int CLUSTERS_PER_SLICE = CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+const unsigned int CLUSTER_TOTAL = CLUSTERS_PER_SLICE * CLUSTER_COUNT_Z;
+
+ClusteredLighting::ClusteredLighting(ThreadPool &pool)
+    : pool(pool), clusterProjection(0.f), clusterNear(0.f), clusterFar(0.f), lightCount(0), sliceScale(0.f), sliceBias(0.f),
+      lightBuffer(0), lightTexture(0), rangeBuffer(0), rangeTexture(0), indexBuffer(0), indexTexture(0)
+{
+    clusterMin.resize(CLUSTER_TOTAL);
+    clusterMax.resize(CLUSTER_TOTAL);
+    clusterRanges.resize(CLUSTER_TOTAL * 2);
+    slices.resize(CLUSTER_COUNT_Z);
+}
+
+void ClusteredLighting::Update(const vector<Light> &lights, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar)
+{
+    if (projection != clusterProjection || zNear != clusterNear || zFar != clusterFar)
+        buildClusterBounds(projection, zNear, zFar);
+
+    lightCount = lights.size();
+    viewLights.resize(lightCount);
+    lightData.resize(lightCount * 3);
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        const Light &light = lights[i];
+        viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.f)), light.radius);
+        lightData[i * 3 + 0] = glm::vec4(light.position, light.radius);
+        lightData[i * 3 + 1] = glm::vec4(light.color, light.spotCosInner);
+        lightData[i * 3 + 2] = glm::vec4(light.direction, light.spotCosOuter);
+    }
+
+    // every slice has its own scratch and its own part of clusterRanges, the jobs share nothing else
+    pool.ParallelFor(CLUSTER_COUNT_Z, 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int slice = begin; slice < end; slice++)
+            binSlice(slice);
+    });
+
+    // slice lists were built with offsets local to the slice, put them one after another
+    lightIndices.clear();
+    for (unsigned int slice = 0; slice < CLUSTER_COUNT_Z; slice++)
+    {
+        unsigned int base = lightIndices.size();
+        for (unsigned int cluster = slice * CLUSTERS_PER_SLICE; cluster < (slice + 1) * CLUSTERS_PER_SLICE; cluster++)
+            clusterRanges[cluster * 2] += base;
+        lightIndices.insert(lightIndices.end(), slices[slice].indices.begin(), slices[slice].indices.end());
+    }
+    upload();
+}
+
+void ClusteredLighting::Bind(Shader &shader, unsigned int firstUnit, unsigned int screenWidth, unsigned int screenHeight) const
+{
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    GlStats::BindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    shader.setInt("lightData", firstUnit);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    GlStats::BindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+    shader.setInt("clusterRanges", firstUnit + 1);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+    GlStats::BindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    shader.setInt("clusterLights", firstUnit + 2);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform3i(glGetUniformLocation(shader.ID, "clusterCount"), CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z);
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
+    shader.setVec2("clusterScreenSize", (float)screenWidth, (float)screenHeight);
+    shader.setFloat("clusterSliceScale", sliceScale);
+    shader.setFloat("clusterSliceBias", sliceBias);
+}
+
+unsigned int ClusteredLighting::GetLightCount() const
+{
+    return lightCount;
+}
+
+unsigned int ClusteredLighting::GetLightReferenceCount() const
+{
+    return lightIndices.size();
+}
+
+void ClusteredLighting::Clear()
+{
+    unsigned int textures[] = { lightTexture, rangeTexture, indexTexture }, buffers[] = { lightBuffer, rangeBuffer, indexBuffer };
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_TEXTURE, textures[i]);
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, buffers[i]);
+    }
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+    lightTexture = rangeTexture = indexTexture = 0;
+    lightBuffer = rangeBuffer = indexBuffer = 0;
+}
+
+void ClusteredLighting::buildClusterBounds(const glm::mat4 &projection, float zNear, float zFar)
+{
+    clusterProjection = projection;
+    clusterNear = zNear;
+    clusterFar = zFar;
+    // slice = log(depth) * scale + bias, the same formula the shaders use
+    sliceScale = CLUSTER_COUNT_Z / std::log(zFar / zNear);
+    sliceBias = -std::log(zNear) * sliceScale;
+    // a view-space point at depth d seen at NDC (x, y) is (x * d / P[0][0], y * d / P[1][1], -d)
+    float scaleX = 1.f / projection[0][0];
+    float scaleY = 1.f / projection[1][1];
+    for (unsigned int k = 0; k < CLUSTER_COUNT_Z; k++)
+    {
+        float nearDepth = zNear * std::pow(zFar / zNear, (float)k / CLUSTER_COUNT_Z);
+        float farDepth = zNear * std::pow(zFar / zNear, (float)(k + 1) / CLUSTER_COUNT_Z);
+        for (unsigned int j = 0; j < CLUSTER_COUNT_Y; j++)
+        {
+            float y0 = -1.f + 2.f * j / CLUSTER_COUNT_Y;
+            float y1 = -1.f + 2.f * (j + 1) / CLUSTER_COUNT_Y;
+            for (unsigned int i = 0; i < CLUSTER_COUNT_X; i++)
+            {
+                float x0 = -1.f + 2.f * i / CLUSTER_COUNT_X;
+                float x1 = -1.f + 2.f * (i + 1) / CLUSTER_COUNT_X;
+                // the tile widens with depth, its x and y extremes are on the near or on the far plane
+                glm::vec3 minCorner(1e30f), maxCorner(-1e30f);
+                float depths[2] = { nearDepth, farDepth };
+                for (int d = 0; d < 2; d++)
+                {
+                    glm::vec3 a(x0 * scaleX * depths[d], y0 * scaleY * depths[d], -depths[d]);
+                    glm::vec3 b(x1 * scaleX * depths[d], y1 * scaleY * depths[d], -depths[d]);
+                    minCorner = glm::min(minCorner, glm::min(a, b));
+                    maxCorner = glm::max(maxCorner, glm::max(a, b));
+                }
+                unsigned int cluster = i + CLUSTER_COUNT_X * (j + CLUSTER_COUNT_Y * k);
+                clusterMin[cluster] = minCorner;
+                clusterMax[cluster] = maxCorner;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::binSlice(unsigned int slice)
+{
+    SliceBins &bins = slices[slice];
+    unsigned int firstCluster = slice * CLUSTERS_PER_SLICE;
+    float sliceNear = -clusterMax[firstCluster].z;
+    float sliceFar = -clusterMin[firstCluster].z;
+
+    // most lights are nowhere near a given depth slice, only the rest is tested against its clusters
+    bins.candidates.clear();
+    bins.x.clear();
+    bins.y.clear();
+    bins.z.clear();
+    bins.radius.clear();
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        float depth = -viewLights[i].z;
+        float radius = viewLights[i].w;
+        if (depth + radius < sliceNear || depth - radius > sliceFar)
+            continue;
+        bins.candidates.push_back(i);
+        bins.x.push_back(viewLights[i].x);
+        bins.y.push_back(viewLights[i].y);
+        bins.z.push_back(viewLights[i].z);
+        bins.radius.push_back(radius);
+    }
+    unsigned int candidateCount = bins.candidates.size();
+    // padding lights are far away with no radius, they never touch a cluster
+    while (bins.x.size() % 4)
+    {
+        bins.x.push_back(1e30f);
+        bins.y.push_back(1e30f);
+        bins.z.push_back(1e30f);
+        bins.radius.push_back(0.f);
+    }
+
+    bins.indices.clear();
+    for (unsigned int cluster = firstCluster; cluster < firstCluster + CLUSTERS_PER_SLICE; cluster++)
+    {
+        unsigned int offset = bins.indices.size();
+        const glm::vec3 &minCorner = clusterMin[cluster];
+        const glm::vec3 &maxCorner = clusterMax[cluster];
+        // sphere touches the box if the closest point of the box is within the radius
+#if USE_SSE
+        __m128 minX = _mm_set1_ps(minCorner.x), minY = _mm_set1_ps(minCorner.y), minZ = _mm_set1_ps(minCorner.z);
+        __m128 maxX = _mm_set1_ps(maxCorner.x), maxY = _mm_set1_ps(maxCorner.y), maxZ = _mm_set1_ps(maxCorner.z);
+        __m128 zero = _mm_setzero_ps();
+        for (unsigned int i = 0; i < candidateCount; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&bins.x[i]);
+            __m128 y = _mm_loadu_ps(&bins.y[i]);
+            __m128 z = _mm_loadu_ps(&bins.z[i]);
+            __m128 r = _mm_loadu_ps(&bins.radius[i]);
+            __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)));
+            __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)));
+            __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)));
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(r, r)));
+            while (mask)
+            {
+                unsigned int lane = 0;
+                while (!(mask & (1 << lane)))
+                    lane++;
+                mask &= ~(1 << lane);
+                if (i + lane < candidateCount)
+                    bins.indices.push_back(bins.candidates[i + lane]);
+            }
+        }
+#else
+        for (unsigned int i = 0; i < candidateCount; i++)
+        {
+            glm::vec3 center(bins.x[i], bins.y[i], bins.z[i]);
+            glm::vec3 delta = glm::max(glm::vec3(0.f), glm::max(minCorner - center, center - maxCorner));
+            if (glm::dot(delta, delta) <= bins.radius[i] * bins.radius[i])
+                bins.indices.push_back(bins.candidates[i]);
+        }
+#endif
+        unsigned int count = bins.indices.size() - offset;
+        if (count > MAX_LIGHTS_PER_CLUSTER) {
+            bins.indices.resize(offset + MAX_LIGHTS_PER_CLUSTER);
+            count = MAX_LIGHTS_PER_CLUSTER;
+        }
+        clusterRanges[cluster * 2] = offset;
+        clusterRanges[cluster * 2 + 1] = count;
+    }
+}
+
+static void uploadTextureBuffer(unsigned int &buffer, unsigned int &texture, GLenum format, const void *data, size_t size)
+{
+    if (!buffer) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        // the texture is a view of the buffer, the memory is counted with the buffer
+        GpuResourceRegistry::Get().Add(GPU_BUFFER, buffer, 16, "clustered lighting");
+        GpuResourceRegistry::Get().Add(GPU_TEXTURE, texture, 0, "clustered lighting");
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // a new store every frame, the driver doesn't have to wait for the last frame's draws to finish reading the old one.
+    // Empty lists still get a store, texture buffers need one
+    GlStats::BufferData(GL_TEXTURE_BUFFER, size ? size : 16, size ? data : nullptr, GL_STREAM_DRAW);
+    GpuResourceRegistry::Get().SetBytes(GPU_BUFFER, buffer, size ? size : 16);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::upload()
+{
+    uploadTextureBuffer(lightBuffer, lightTexture, GL_RGBA32F, lightData.data(), lightData.size() * sizeof(glm::vec4));
+    uploadTextureBuffer(rangeBuffer, rangeTexture, GL_RG32UI, clusterRanges.data(), clusterRanges.size() * sizeof(unsigned int));
+    uploadTextureBuffer(indexBuffer, indexTexture, GL_R32UI, lightIndices.data(), lightIndices.size() * sizeof(unsigned int));
+}
+
+// cheap deterministic pseudo-random number in [0, 1) for the demo lights
+static float hashToUnit(unsigned int value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352d;
+    value ^= value >> 15;
+    value *= 0x846ca68b;
+    value ^= value >> 16;
+    return (value & 0xFFFFFF) / (float)0x1000000;
+}
+
+void addDemoLights(vector<Light> &lights, unsigned int count, double time)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // each light circles around its own point of the box around the wall, the floor and the bench
+        glm::vec3 center(-4.f + 8.f * hashToUnit(i * 7 + 0), -1.8f + 3.3f * hashToUnit(i * 7 + 1), -1.8f + 9.f * hashToUnit(i * 7 + 2));
+        float orbit = 0.3f + 1.2f * hashToUnit(i * 7 + 3);
+        float speed = 0.3f + 1.5f * hashToUnit(i * 7 + 4);
+        float phase = 6.2831853f * hashToUnit(i * 7 + 5);
+        float hue = hashToUnit(i * 7 + 6);
+        float angle = phase + speed * (float)time;
+
+        Light light;
+        light.position = center + orbit * glm::vec3(std::cos(angle), 0.3f * std::sin(2.f * angle), std::sin(angle));
+        light.radius = 1.5f;
+        // saturated color from the hue
+        light.color = glm::clamp(glm::abs(glm::mod(hue * 6.f + glm::vec3(0.f, 4.f, 2.f), 6.f) - 3.f) - 1.f, 0.f, 1.f) * 0.8f;
+        light.direction = glm::vec3(0.f, -1.f, 0.f);
+        lights.push_back(light);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "ThreadPool.h"
+
+#include <vector>
+using namespace std;
+
+// A point light, or a spot light if spotCosOuter > -1
+struct Light {
+    glm::vec3 position;
+    float radius;           // the light doesn't reach further than this
+    glm::vec3 color;        // intensity included
+    glm::vec3 direction;    // spot lights only, normalized
+    float spotCosOuter = -2.f;
+    float spotCosInner = -2.f;
+};
+
+const unsigned int CLUSTER_COUNT_X = 16;
+const unsigned int CLUSTER_COUNT_Y = 9;
+const unsigned int CLUSTER_COUNT_Z = 24;
+// caps the shader loop in the most crowded clusters
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Clustered forward lighting: the view frustum is cut into CLUSTER_COUNT_X x CLUSTER_COUNT_Y screen tiles
+// and CLUSTER_COUNT_Z depth slices (exponentially spaced, so near clusters stay small), and every frame
+// each cluster gets the list of lights whose sphere touches it. A lit fragment finds its cluster from
+// its screen position and view depth and only loops over that list.
+// The binning runs on the CPU, one depth slice per job on the thread pool, with SSE testing four lights at once.
+// Lights, cluster ranges and light lists go to the shaders in texture buffers (GL 3.1), see Bind().
+class ClusteredLighting
+{
+public:
+    explicit ClusteredLighting(ThreadPool &pool);
+
+    // bins the lights for this camera and uploads the result
+    void Update(const vector<Light> &lights, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar);
+    // binds the three buffers to texture units firstUnit..firstUnit + 2 and sets the cluster uniforms, the shader has to be in use.
+    // screenWidth and screenHeight are the size of the viewport the scene is drawn to.
+    void Bind(Shader &shader, unsigned int firstUnit, unsigned int screenWidth, unsigned int screenHeight) const;
+
+    unsigned int GetLightCount() const;
+    // total length of all cluster light lists, how much lighting work the frame has
+    unsigned int GetLightReferenceCount() const;
+    // deletes the buffers, has to be called while the GL context is still alive
+    void Clear();
+
+private:
+    ThreadPool &pool;
+
+    // view-space bounds of every cluster, rebuilt when the projection changes
+    vector<glm::vec3> clusterMin;
+    vector<glm::vec3> clusterMax;
+    glm::mat4 clusterProjection;
+    float clusterNear, clusterFar;
+
+    // lights in view space
+    vector<glm::vec4> viewLights;        // xyz position, w radius
+    // scratch of one depth slice, only the job binning that slice touches it
+    struct SliceBins {
+        // lights that overlap the slice in depth, structure of arrays padded to a multiple of 4 for the SSE test
+        vector<unsigned int> candidates;
+        vector<float> x, y, z, radius;
+        vector<unsigned int> indices;    // light lists of the slice's clusters, one after another
+    };
+    vector<SliceBins> slices;
+    vector<unsigned int> clusterRanges;  // offset and count per cluster
+    vector<unsigned int> lightIndices;
+    vector<glm::vec4> lightData;         // 3 texels per light
+
+    unsigned int lightCount;
+    float sliceScale, sliceBias;
+
+    unsigned int lightBuffer, lightTexture;
+    unsigned int rangeBuffer, rangeTexture;
+    unsigned int indexBuffer, indexTexture;
+
+    void buildClusterBounds(const glm::mat4 &projection, float zNear, float zFar);
+    void binSlice(unsigned int slice);
+    void upload();
+};
+
+// adds count small colored lights flying around the scene, they move with time
+void addDemoLights(vector<Light> &lights, unsigned int count, double time);
+#endif
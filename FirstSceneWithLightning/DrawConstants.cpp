@@ -0,0 +1,107 @@
+#include "DrawConstants.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Log.h"
+
+#include <cstring>
+
+DrawConstantRing::DrawConstantRing(unsigned int slotsPerSegment)
+    : slotsPerSegment(slotsPerSegment), slotSize(0), buffer(0), mapped(nullptr), segment(0), slot(0)
+{
+}
+
+void DrawConstantRing::SetupShader(Shader &shader)
+{
+    GLuint block = glGetUniformBlockIndex(shader.ID, "DrawConstants");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.ID, block, UNIFORM_BINDING);
+}
+
+void DrawConstantRing::Bind(const glm::mat4 &model, int materialIndex)
+{
+    if (!buffer)
+        create();
+    if (slot == slotsPerSegment)
+        nextSegment();
+
+    DrawConstants constants;
+    constants.model = model;
+    // inverse transpose once per draw instead of once per vertex
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (unsigned int i = 0; i < 3; i++)
+        constants.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.f);
+    constants.materialIndex = materialIndex;
+    constants.padding[0] = constants.padding[1] = constants.padding[2] = 0;
+
+    size_t offset = (size_t)(segment * slotsPerSegment + slot) * slotSize;
+    if (mapped) {
+        memcpy(mapped + offset, &constants, sizeof(constants));
+        GlStats::Count(GL_STAT_BUFFER_BYTES, sizeof(constants));
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        GlStats::BufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(constants), &constants);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, buffer, offset, sizeof(constants));
+    slot++;
+}
+
+void DrawConstantRing::Clear()
+{
+    for (unsigned int i = 0; i < fences.size(); i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    fences.clear();
+    if (buffer) {
+        if (mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    segment = slot = 0;
+}
+
+void DrawConstantRing::create()
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotSize = (sizeof(DrawConstants) + alignment - 1) / alignment * alignment;
+    size_t bytes = (size_t)SEGMENTS * slotsPerSegment * slotSize;
+
+    glGenBuffers(1, &buffer);
+    GpuResourceRegistry::Get().Add(GPU_BUFFER, buffer, bytes, "draw constant ring");
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        // dynamic storage keeps glBufferSubData working if the mapping fails
+        glBufferStorage(GL_UNIFORM_BUFFER, bytes, nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+        mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, bytes, flags);
+        if (!mapped)
+            LOG(LOG_ERROR) << "ERROR::DRAW_CONSTANTS::MAP:: Persistent mapping failed, falling back to glBufferSubData";
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    fences.assign(SEGMENTS, (GLsync)0);
+    segment = slot = 0;
+}
+
+void DrawConstantRing::nextSegment()
+{
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % SEGMENTS;
+    slot = 0;
+    if (!fences[segment])
+        return;
+    // only blocks when the GPU is a whole ring behind, the flush makes sure the fence gets there at all
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fences[segment], waitFlags, 1000000) == GL_TIMEOUT_EXPIRED)
+        waitFlags = 0;
+    glDeleteSync(fences[segment]);
+    fences[segment] = 0;
+}
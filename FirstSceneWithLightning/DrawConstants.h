@@ -0,0 +1,54 @@
+#pragma once
+#ifndef DRAW_CONSTANTS_H
+#define DRAW_CONSTANTS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+#include <vector>
+using namespace std;
+
+// The DrawConstants uniform block of the scene shaders, in std140 layout
+struct DrawConstants {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // mat3 columns, padded to vec4
+    int materialIndex;         // in the Materials block, see MaterialTable
+    int padding[3];
+};
+
+// Per-draw constants written into a ring of uniform buffer slots instead of setting uniforms before every draw.
+// The ring is split into segments: a fence goes in after the draws of a segment and the segment is only written
+// again once the GPU has passed it, so writes never wait on draws in flight unless the ring is too small.
+// The buffer stays mapped (persistent and coherent) where buffer storage is supported, otherwise every slot is
+// written with glBufferSubData. Each draw binds its slot with glBindBufferRange.
+class DrawConstantRing
+{
+public:
+    static const unsigned int UNIFORM_BINDING = 1; // Materials has 0
+    static const unsigned int SEGMENTS = 4;
+
+    DrawConstantRing(unsigned int slotsPerSegment = 1024);
+
+    // points the shader's DrawConstants block at the ring, once after creating it
+    static void SetupShader(Shader &shader);
+    // writes the constants of a draw with this model matrix and binds them, creates the buffer on first use
+    void Bind(const glm::mat4 &model, int materialIndex);
+    // deletes the buffer and the fences, needs the GL context
+    void Clear();
+
+private:
+    unsigned int slotsPerSegment;
+    unsigned int slotSize; // sizeof(DrawConstants) rounded up to the uniform buffer offset alignment
+    unsigned int buffer;
+    unsigned char *mapped; // nullptr without persistent mapping
+    unsigned int segment;
+    unsigned int slot;     // next free slot of the segment
+    vector<GLsync> fences; // per segment, 0 once the segment is free
+
+    void create();
+    // fences the current segment and waits until the next one is free
+    void nextSegment();
+};
+#endif
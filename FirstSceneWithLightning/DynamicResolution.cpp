@@ -0,0 +1,103 @@
+#include "DynamicResolution.h"
+
+#include <cmath>
+
+// scale only changes in these steps, so the render target pool sees a handful of sizes and not a new one every frame
+const float SCALE_STEP = 0.05f;
+// frames to wait after a change before judging again, the average needs time to show the effect of the new scale
+const unsigned int SETTLE_FRAMES = 15;
+// weight of a new sample in the running average
+const double AVERAGE_WEIGHT = 0.1;
+
+GpuFrameTimer::GpuFrameTimer() : issued(0), polled(0), running(false)
+{
+    glGenQueries(QUERY_COUNT, queries);
+}
+
+void GpuFrameTimer::Begin()
+{
+    // all queries are still in flight, skip timing this frame rather than stall
+    if (issued - polled >= QUERY_COUNT)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, queries[issued % QUERY_COUNT]);
+    running = true;
+}
+
+void GpuFrameTimer::End()
+{
+    if (!running)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    running = false;
+    issued++;
+}
+
+bool GpuFrameTimer::Poll(double &milliseconds)
+{
+    if (polled == issued)
+        return false;
+    unsigned int query = queries[polled % QUERY_COUNT];
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    polled++;
+    milliseconds = elapsed / 1e6;
+    return true;
+}
+
+DynamicResolution::DynamicResolution(double targetFrameMs, float minScale, float maxScale)
+    : targetFrameMs(targetFrameMs), minScale(minScale), maxScale(maxScale)
+{
+    Reset();
+}
+
+bool DynamicResolution::Update(double frameMs)
+{
+    averageFrameMs = averageFrameMs < 0.0 ? frameMs : averageFrameMs * (1.0 - AVERAGE_WEIGHT) + frameMs * AVERAGE_WEIGHT;
+    if (++framesSinceChange < SETTLE_FRAMES)
+        return false;
+    // leave a dead zone around the target so the scale doesn't oscillate between two neighbouring steps
+    if (averageFrameMs < targetFrameMs * 1.05 && averageFrameMs > targetFrameMs * 0.8)
+        return false;
+
+    float wanted = scale * (float)std::sqrt(targetFrameMs / averageFrameMs);
+    float newScale = std::floor(wanted / SCALE_STEP + 0.5f) * SCALE_STEP;
+    // go down as fast as needed, but climb back one step at a time
+    if (newScale > scale + SCALE_STEP)
+        newScale = scale + SCALE_STEP;
+    if (newScale < minScale)
+        newScale = minScale;
+    if (newScale > maxScale)
+        newScale = maxScale;
+    if (std::fabs(newScale - scale) < SCALE_STEP * 0.5f)
+        return false;
+    scale = newScale;
+    framesSinceChange = 0;
+    return true;
+}
+
+float DynamicResolution::GetScale() const
+{
+    return scale;
+}
+
+unsigned int DynamicResolution::ScaledSize(unsigned int size) const
+{
+    unsigned int scaled = (unsigned int)(size * scale + 0.5f);
+    return scaled > 0 ? scaled : 1;
+}
+
+void DynamicResolution::SetTargetFrameTime(double targetFrameMs)
+{
+    this->targetFrameMs = targetFrameMs;
+}
+
+void DynamicResolution::Reset()
+{
+    scale = maxScale;
+    averageFrameMs = -1.0;
+    framesSinceChange = 0;
+}
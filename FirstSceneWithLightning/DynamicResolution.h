@@ -0,0 +1,51 @@
+#pragma once
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <GL/glew.h>
+
+// Measures how long the GPU spends on a frame with GL_TIME_ELAPSED queries.
+// Results are read a few frames late from a ring of queries so the CPU never waits for the GPU.
+class GpuFrameTimer
+{
+public:
+    GpuFrameTimer();
+
+    void Begin();
+    void End();
+    // returns true and the duration of the oldest finished frame if there is one that wasn't reported yet
+    bool Poll(double &milliseconds);
+
+private:
+    static const unsigned int QUERY_COUNT = 4;
+    unsigned int queries[QUERY_COUNT];
+    unsigned int issued;  // number of queries ended so far
+    unsigned int polled;  // number of queries whose result was read
+    bool running;
+};
+
+// Picks the render scale of the 3D scene so that the GPU frame time stays close to the target.
+// The cost of a frame is roughly proportional to the pixel count, i.e. to scale squared.
+class DynamicResolution
+{
+public:
+    DynamicResolution(double targetFrameMs = 1000.0 / 60.0, float minScale = 0.5f, float maxScale = 1.0f);
+
+    // feeds one measured GPU frame time, returns true if the scale has changed
+    bool Update(double frameMs);
+    float GetScale() const;
+    // internal render size for the given output size
+    unsigned int ScaledSize(unsigned int size) const;
+
+    void SetTargetFrameTime(double targetFrameMs);
+    // drops history and goes back to full resolution, e.g. when the feature is switched off
+    void Reset();
+
+private:
+    double targetFrameMs;
+    float minScale, maxScale;
+    float scale;
+    double averageFrameMs;
+    unsigned int framesSinceChange;
+};
+#endif
@@ -0,0 +1,305 @@
+#include "FrameCapture.h"
+#include "GpuResources.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+#include <csignal>
+#include <cstring>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_WRITE_MODE "wb"
+#else
+#define PIPE_WRITE_MODE "w" // POSIX pipes have no text mode, "b" isn't accepted
+#endif
+
+FrameCapture::FrameCapture(unsigned int queuedFrames)
+    : queuedFrames(queuedFrames ? queuedFrames : 1), isRecording(false), kind(IMAGE_SEQUENCE), stream(nullptr), isStreamFailed(false),
+      frameDigits(0), isZeroPadded(false), width(0), height(0),
+      oldest(0), pendingCount(0), frame(0), droppedCount(0), isSizeReported(false), writtenCount(0), isStopping(false)
+{
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        pixelBuffers[i] = 0;
+        fences[i] = 0;
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    // the GL objects are gone with the context by now, only the writer is left to finish
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        jobAvailable.notify_one();
+        writer.join();
+    }
+    if (stream)
+        kind == RAW_PIPE ? pclose(stream) : fclose(stream);
+}
+
+bool FrameCapture::Start(const string &output, unsigned int width, unsigned int height)
+{
+    if (isRecording)
+        Stop();
+    if (width == 0 || height == 0)
+        return false;
+    this->output = output;
+    this->width = width;
+    this->height = height;
+    if (!output.empty() && output[0] == '|') {
+        kind = RAW_PIPE;
+        string command = output.substr(1);
+        const string size[2] = { std::to_string(width), std::to_string(height) };
+        const string names[2] = { "{width}", "{height}" };
+        for (unsigned int i = 0; i < 2; i++)
+            for (size_t at = command.find(names[i]); at != string::npos; at = command.find(names[i], at))
+                command.replace(at, names[i].size(), size[i]);
+#ifndef _WIN32
+        // a command that exits early would kill the program with SIGPIPE, fwrite fails with EPIPE instead
+        signal(SIGPIPE, SIG_IGN);
+#endif
+        stream = popen(command.c_str(), PIPE_WRITE_MODE);
+    } else if (output.size() >= 4 && output.substr(output.size() - 4) == ".raw") {
+        kind = RAW_FILE;
+        stream = fopen(output.c_str(), "wb");
+    } else {
+        kind = IMAGE_SEQUENCE;
+        if (!parsePattern(output)) {
+            LOG(LOG_ERROR) << "ERROR::FRAME_CAPTURE::START:: " << output << " needs exactly one frame number (%d, %u, %0Nd or %Nd)"
+                << ", a .raw file or a |command";
+            return false;
+        }
+    }
+    isStreamFailed = false;
+    if (kind != IMAGE_SEQUENCE && !stream) {
+        LOG(LOG_ERROR) << "ERROR::FRAME_CAPTURE::START:: Couldn't open " << output;
+        return false;
+    }
+
+    size_t frameBytes = (size_t)width * height * 4;
+    glGenBuffers(RING_SIZE, pixelBuffers);
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+        GpuResourceRegistry::Get().Add(GPU_BUFFER, pixelBuffers[i], frameBytes, "frame capture");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frames.assign(queuedFrames, vector<unsigned char>(frameBytes));
+    freeFrames.clear();
+    for (unsigned int i = 0; i < queuedFrames; i++)
+        freeFrames.push_back(i);
+    jobs.clear();
+    oldest = pendingCount = frame = droppedCount = writtenCount = 0;
+    isSizeReported = false;
+    isStopping = false;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+    isRecording = true;
+    return true;
+}
+
+void FrameCapture::Stop()
+{
+    if (!isRecording)
+        return;
+    while (pendingCount > 0)
+        retireOldest();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    jobAvailable.notify_one();
+    writer.join();
+    if (stream)
+        kind == RAW_PIPE ? pclose(stream) : fclose(stream);
+    stream = nullptr;
+    glDeleteBuffers(RING_SIZE, pixelBuffers);
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, pixelBuffers[i]);
+        pixelBuffers[i] = 0;
+    }
+    frames.clear();
+    isRecording = false;
+}
+
+bool FrameCapture::IsRecording() const
+{
+    return isRecording;
+}
+
+void FrameCapture::Capture(unsigned int width, unsigned int height)
+{
+    if (!isRecording)
+        return;
+    // whatever the GPU has finished by now goes to the writer, without waiting
+    while (pendingCount > 0 && glClientWaitSync(fences[oldest], 0, 0) != GL_TIMEOUT_EXPIRED)
+        retireOldest();
+    if (width != this->width || height != this->height) {
+        if (!isSizeReported)
+            LOG(LOG_ERROR) << "ERROR::FRAME_CAPTURE::CAPTURE:: Window is " << width << "x" << height << " now, frames of the "
+                << this->width << "x" << this->height << " recording are skipped";
+        isSizeReported = true;
+        droppedCount++;
+        return;
+    }
+    // only waits when the GPU is RING_SIZE frames behind
+    if (pendingCount == RING_SIZE)
+        retireOldest();
+
+    unsigned int slot = (oldest + pendingCount) % RING_SIZE;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    // into the buffer, returns right away
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pendingCount++;
+}
+
+unsigned int FrameCapture::GetWrittenCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return writtenCount;
+}
+
+unsigned int FrameCapture::GetDroppedCount() const
+{
+    return droppedCount;
+}
+
+void FrameCapture::retireOldest()
+{
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fences[oldest], waitFlags, 1000000) == GL_TIMEOUT_EXPIRED)
+        waitFlags = 0;
+    glDeleteSync(fences[oldest]);
+    fences[oldest] = 0;
+
+    int buffer = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeFrames.empty()) {
+            buffer = freeFrames.back();
+            freeFrames.pop_back();
+        }
+    }
+    if (buffer < 0) {
+        // the writer is behind, dropping the frame keeps the memory bounded
+        droppedCount++;
+    } else {
+        size_t frameBytes = frames[buffer].size();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[oldest]);
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+        if (pixels) {
+            memcpy(&frames[buffer][0], pixels, frameBytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pixels) {
+            EncodeJob job;
+            job.buffer = buffer;
+            job.frame = frame++;
+            jobs.push_back(job);
+        } else {
+            freeFrames.push_back(buffer);
+            droppedCount++;
+        }
+    }
+    jobAvailable.notify_one();
+    oldest = (oldest + 1) % RING_SIZE;
+    pendingCount--;
+}
+
+void FrameCapture::writerLoop()
+{
+    while (true)
+    {
+        EncodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // the queued frames are written before stopping
+            jobAvailable.wait(lock, [this] { return isStopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+        bool isWritten = write(frames[job.buffer], job.frame);
+        std::lock_guard<std::mutex> lock(mutex);
+        freeFrames.push_back(job.buffer);
+        writtenCount += isWritten;
+    }
+}
+
+bool FrameCapture::write(const vector<unsigned char> &pixels, unsigned int frame)
+{
+    // GL rows go from the bottom up, the files from the top down
+    size_t rowBytes = (size_t)width * 4;
+    vector<unsigned char> flipped(pixels.size());
+    for (unsigned int y = 0; y < height; y++)
+        memcpy(&flipped[(height - 1 - y) * rowBytes], &pixels[y * rowBytes], rowBytes);
+
+    if (kind != IMAGE_SEQUENCE) {
+        if (isStreamFailed)
+            return false;
+        if (fwrite(&flipped[0], 1, flipped.size(), stream) == flipped.size())
+            return true;
+        // a full disk or a command that exited, the following frames would fail the same way
+        LOG(LOG_ERROR) << "ERROR::FRAME_CAPTURE::WRITE:: Couldn't write frame " << frame << " to " << output << ", no more frames are written";
+        isStreamFailed = true;
+        return false;
+    }
+    char number[32];
+    snprintf(number, sizeof(number), isZeroPadded ? "%0*u" : "%*u", frameDigits, frame);
+    string name = namePrefix + number + nameSuffix;
+    string extension = name.size() >= 4 ? name.substr(name.size() - 4) : string();
+    int type = extension == ".bmp" || extension == ".BMP" ? SOIL_SAVE_TYPE_BMP : SOIL_SAVE_TYPE_TGA;
+    if (!SOIL_save_image(name.c_str(), type, width, height, 4, &flipped[0])) {
+        LOG(LOG_ERROR) << "ERROR::FRAME_CAPTURE::WRITE:: Couldn't write " << name;
+        return false;
+    }
+    return true;
+}
+
+bool FrameCapture::parsePattern(const string &pattern)
+{
+    string text[2];
+    unsigned int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%') {
+            text[conversions ? 1 : 0] += pattern[i];
+            continue;
+        }
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+            text[conversions ? 1 : 0] += '%';
+            i++;
+            continue;
+        }
+        // %, an optional 0, the width, d or u
+        size_t end = i + 1;
+        bool isZero = end < pattern.size() && pattern[end] == '0';
+        if (isZero)
+            end++;
+        int digits = 0;
+        for (; end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9' && digits < 100; end++)
+            digits = digits * 10 + (pattern[end] - '0');
+        if (end >= pattern.size() || (pattern[end] != 'd' && pattern[end] != 'u') || digits >= 20 || ++conversions > 1)
+            return false;
+        frameDigits = digits;
+        isZeroPadded = isZero;
+        i = end;
+    }
+    namePrefix = text[0];
+    nameSuffix = text[1];
+    return conversions == 1;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Records the frames drawn into the default framebuffer without stalling on glReadPixels.
+// Every frame is read into the next of a ring of pixel pack buffers and fenced; a buffer is mapped only once its
+// fence has passed (or when the ring is full), a few frames later, and the pixels are copied into one of a fixed
+// number of frame buffers that a writer thread turns into files. If the writer falls behind every frame buffer is
+// taken and frames are dropped instead of growing memory: the recording costs RING_SIZE + queuedFrames frames at most.
+// The output is
+//   name_%05d.tga (or .bmp)   a picture per frame, the frame number goes where the one %d, %u, %0Nd or %Nd is;
+//                             %% is a percent sign, any other % is rejected by Start()
+//   name.raw                  all frames one after another, RGBA, top row first
+//   |command                  the same raw frames piped into the command's standard input, {width} and {height}
+//                             in it are replaced, e.g. "|ffmpeg -f rawvideo -pix_fmt rgba -s {width}x{height} -i - out.mp4"
+class FrameCapture
+{
+public:
+    static const unsigned int RING_SIZE = 3;
+
+    explicit FrameCapture(unsigned int queuedFrames = 8);
+    ~FrameCapture();
+
+    // starts recording frames of width x height, false if the output can't be opened or the file name pattern is wrong
+    bool Start(const string &output, unsigned int width, unsigned int height);
+    // reads back the rest of the frames, waits until the writer is done with them and closes the output. Needs the GL context
+    void Stop();
+    bool IsRecording() const;
+    // queues a readback of the default framebuffer, after the frame is drawn and before the buffers are swapped.
+    // Frames of another size than the recording's are skipped
+    void Capture(unsigned int width, unsigned int height);
+
+    unsigned int GetWrittenCount();
+    unsigned int GetDroppedCount() const;
+
+private:
+    enum OUTPUT_KIND { IMAGE_SEQUENCE, RAW_FILE, RAW_PIPE };
+    // a filled frame buffer waiting for the writer
+    struct EncodeJob {
+        unsigned int buffer;
+        unsigned int frame;
+    };
+
+    unsigned int queuedFrames;
+    bool isRecording;
+    string output;
+    OUTPUT_KIND kind;
+    FILE *stream; // RAW_FILE and RAW_PIPE
+    bool isStreamFailed; // a write to it failed, it isn't written anymore
+    // IMAGE_SEQUENCE: the file name around the frame number, which is padded to frameDigits with zeros or spaces
+    string namePrefix, nameSuffix;
+    int frameDigits;
+    bool isZeroPadded;
+    unsigned int width, height;
+
+    unsigned int pixelBuffers[RING_SIZE];
+    GLsync fences[RING_SIZE];
+    unsigned int oldest, pendingCount; // readbacks in flight, in ring order from oldest
+    unsigned int frame, droppedCount;
+    bool isSizeReported;
+
+    vector<vector<unsigned char> > frames;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    vector<unsigned int> freeFrames;
+    deque<EncodeJob> jobs;
+    unsigned int writtenCount;
+    bool isStopping;
+
+    // maps the oldest readback, copies it to a free frame buffer and hands it to the writer
+    void retireOldest();
+    void writerLoop();
+    // splits an image sequence name at its frame number conversion, false unless there is exactly one
+    bool parsePattern(const string &pattern);
+    bool write(const vector<unsigned char> &pixels, unsigned int frame);
+};
+#endif
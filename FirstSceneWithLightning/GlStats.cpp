@@ -0,0 +1,33 @@
+#include "GlStats.h"
+
+unsigned long long GlStats::counters[GL_STAT_COUNT] = {};
+unsigned long long GlStats::lastFrame[GL_STAT_COUNT] = {};
+unsigned int GlStats::currentProgram = 0;
+
+void GlStats::EndFrame()
+{
+    for (unsigned int i = 0; i < GL_STAT_COUNT; i++)
+    {
+        lastFrame[i] = counters[i];
+        counters[i] = 0;
+    }
+}
+
+unsigned long long GlStats::Get(GL_STAT stat)
+{
+    return lastFrame[stat];
+}
+
+const char *GlStats::GetName(GL_STAT stat)
+{
+    switch (stat) {
+    case GL_STAT_DRAW_CALLS: return "draw calls";
+    case GL_STAT_TRIANGLES: return "triangles";
+    case GL_STAT_PROGRAM_SWITCHES: return "program switches";
+    case GL_STAT_TEXTURE_BINDS: return "texture binds";
+    case GL_STAT_UNIFORM_UPLOADS: return "uniform uploads";
+    case GL_STAT_BUFFER_BYTES: return "buffer bytes";
+    case GL_STAT_TEXTURE_BYTES: return "texture bytes";
+    default: return "unknown";
+    }
+}
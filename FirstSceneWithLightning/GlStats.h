@@ -0,0 +1,120 @@
+#pragma once
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+enum GL_STAT {
+    GL_STAT_DRAW_CALLS,
+    GL_STAT_TRIANGLES,
+    GL_STAT_PROGRAM_SWITCHES,
+    GL_STAT_TEXTURE_BINDS,
+    GL_STAT_UNIFORM_UPLOADS,
+    GL_STAT_BUFFER_BYTES,  // glBufferData/glBufferStorage/glBufferSubData and writes into mapped buffers
+    GL_STAT_TEXTURE_BYTES, // texels given to glTexImage/glTexSubImage
+    GL_STAT_COUNT
+};
+
+// Counts what the frame asks of GL. The hot calls (draws, program and texture binds, uniforms, buffer uploads)
+// go through the wrappers below, which call GL and add to plain counters: GL is only called from the render
+// thread, so there are no atomics or locks and the counting costs a few additions per call.
+class GlStats
+{
+public:
+    static void Count(GL_STAT stat, unsigned long long amount = 1)
+    {
+        counters[stat] += amount;
+    }
+    // the counters of the frame that just ended become the ones Get returns, counting starts from zero again
+    static void EndFrame();
+    // of the last finished frame
+    static unsigned long long Get(GL_STAT stat);
+    static const char *GetName(GL_STAT stat);
+
+    static void DrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        glDrawArrays(mode, first, count);
+        countDraw(mode, count);
+    }
+    static void DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+    {
+        glDrawElements(mode, count, type, indices);
+        countDraw(mode, count);
+    }
+    static void UseProgram(unsigned int program)
+    {
+        glUseProgram(program);
+        if (program != currentProgram) {
+            counters[GL_STAT_PROGRAM_SWITCHES]++;
+            currentProgram = program;
+        }
+    }
+    static void BindTexture(GLenum target, unsigned int texture)
+    {
+        glBindTexture(target, texture);
+        counters[GL_STAT_TEXTURE_BINDS]++;
+    }
+    static void BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+    {
+        glBufferData(target, size, data, usage);
+        if (data)
+            counters[GL_STAT_BUFFER_BYTES] += size;
+    }
+    static void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+    {
+        glBufferSubData(target, offset, size, data);
+        counters[GL_STAT_BUFFER_BYTES] += size;
+    }
+    static void BufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+    {
+        glBufferStorage(target, size, data, flags);
+        if (data)
+            counters[GL_STAT_BUFFER_BYTES] += size;
+    }
+    // writtenBytes are what was written into the mapping, they count if the contents survived it
+    static GLboolean UnmapBuffer(GLenum target, GLsizeiptr writtenBytes)
+    {
+        GLboolean isIntact = glUnmapBuffer(target);
+        if (isIntact)
+            counters[GL_STAT_BUFFER_BYTES] += writtenBytes;
+        return isIntact;
+    }
+    // the texture uploads take the size of data in bytes, which depends on the format
+    static void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format,
+                           GLenum type, const void *data, size_t bytes)
+    {
+        glTexImage2D(target, level, internalFormat, width, height, 0, format, type, data);
+        if (data)
+            counters[GL_STAT_TEXTURE_BYTES] += bytes;
+    }
+    static void TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+                           GLenum format, GLenum type, const void *data, size_t bytes)
+    {
+        glTexImage3D(target, level, internalFormat, width, height, depth, 0, format, type, data);
+        if (data)
+            counters[GL_STAT_TEXTURE_BYTES] += bytes;
+    }
+    static void TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+                              GLenum format, GLenum type, const void *data, size_t bytes)
+    {
+        glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, data);
+        counters[GL_STAT_TEXTURE_BYTES] += bytes;
+    }
+
+private:
+    static unsigned long long counters[GL_STAT_COUNT];
+    static unsigned long long lastFrame[GL_STAT_COUNT];
+    static unsigned int currentProgram;
+
+    static void countDraw(GLenum mode, GLsizei count)
+    {
+        counters[GL_STAT_DRAW_CALLS]++;
+        if (mode == GL_TRIANGLES)
+            counters[GL_STAT_TRIANGLES] += count / 3;
+        else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2)
+            counters[GL_STAT_TRIANGLES] += count - 2;
+    }
+};
+#endif
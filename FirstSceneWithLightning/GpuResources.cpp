@@ -0,0 +1,156 @@
+#include "GpuResources.h"
+#include "Log.h"
+
+#include <vector>
+
+GpuResourceRegistry &GpuResourceRegistry::Get()
+{
+    static GpuResourceRegistry registry;
+    return registry;
+}
+
+GpuResourceRegistry::GpuResourceRegistry()
+    : totalBytes(0), budget(0), isOverBudget(false)
+{
+    for (unsigned int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+    {
+        counts[i] = 0;
+        bytes[i] = peakBytes[i] = 0;
+    }
+}
+
+void GpuResourceRegistry::Add(GPU_RESOURCE_KIND kind, unsigned int id, size_t bytes, const string &owner)
+{
+    if (id == 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    Resource &resource = resources[make_pair((int)kind, id)];
+    if (!resource.owner.empty()) {
+        // GL handed out the id again, so whoever had it deleted it without telling
+        LOG(LOG_ERROR) << "ERROR::GPU_RESOURCES::ADD:: " << GetKindName(kind) << " " << id << " of " << resource.owner
+            << " was deleted without being unregistered";
+        counts[kind]--;
+        changeBytes(kind, resource.bytes, 0);
+    }
+    resource.bytes = bytes;
+    resource.owner = owner;
+    counts[kind]++;
+    changeBytes(kind, 0, bytes);
+}
+
+void GpuResourceRegistry::SetBytes(GPU_RESOURCE_KIND kind, unsigned int id, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    map<pair<int, unsigned int>, Resource>::iterator resource = resources.find(make_pair((int)kind, id));
+    if (resource == resources.end())
+        return;
+    changeBytes(kind, resource->second.bytes, bytes);
+    resource->second.bytes = bytes;
+}
+
+void GpuResourceRegistry::SetOwner(GPU_RESOURCE_KIND kind, unsigned int id, const string &owner)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    map<pair<int, unsigned int>, Resource>::iterator resource = resources.find(make_pair((int)kind, id));
+    if (resource != resources.end())
+        resource->second.owner = owner;
+}
+
+void GpuResourceRegistry::Remove(GPU_RESOURCE_KIND kind, unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    map<pair<int, unsigned int>, Resource>::iterator resource = resources.find(make_pair((int)kind, id));
+    if (resource == resources.end())
+        return;
+    counts[kind]--;
+    changeBytes(kind, resource->second.bytes, 0);
+    resources.erase(resource);
+}
+
+unsigned int GpuResourceRegistry::GetCount(GPU_RESOURCE_KIND kind)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counts[kind];
+}
+
+size_t GpuResourceRegistry::GetBytes(GPU_RESOURCE_KIND kind)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes[kind];
+}
+
+size_t GpuResourceRegistry::GetPeakBytes(GPU_RESOURCE_KIND kind)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return peakBytes[kind];
+}
+
+size_t GpuResourceRegistry::GetTotalBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
+
+void GpuResourceRegistry::SetBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    isOverBudget = false;
+}
+
+void GpuResourceRegistry::LogSummary()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    LOG(LOG_INFO) << "GPU memory: " << (totalBytes >> 20) << " MB" << (budget ? " of " + std::to_string(budget >> 20) + " MB budget" : "");
+    for (unsigned int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+        if (peakBytes[i] > 0 || counts[i] > 0)
+            LOG(LOG_INFO) << "  " << GetKindName((GPU_RESOURCE_KIND)i) << ": " << counts[i] << ", " << (bytes[i] >> 10)
+                << " KB, at most " << (peakBytes[i] >> 10) << " KB";
+}
+
+unsigned int GpuResourceRegistry::ReportLeaks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (resources.empty())
+        return 0;
+    // owner -> count and memory of its objects per kind
+    map<string, vector<pair<unsigned int, size_t> > > owners;
+    for (map<pair<int, unsigned int>, Resource>::iterator resource = resources.begin(); resource != resources.end(); ++resource)
+    {
+        vector<pair<unsigned int, size_t> > &kinds = owners[resource->second.owner];
+        kinds.resize(GPU_RESOURCE_KIND_COUNT, make_pair(0u, (size_t)0));
+        kinds[resource->first.first].first++;
+        kinds[resource->first.first].second += resource->second.bytes;
+    }
+    LOG(LOG_ERROR) << "ERROR::GPU_RESOURCES::LEAK:: " << resources.size() << " GL objects (" << (totalBytes >> 10)
+        << " KB) were never deleted";
+    for (map<string, vector<pair<unsigned int, size_t> > >::iterator owner = owners.begin(); owner != owners.end(); ++owner)
+        for (unsigned int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+            if (owner->second[i].first > 0)
+                LOG(LOG_ERROR) << "  " << owner->first << ": " << owner->second[i].first << " " << GetKindName((GPU_RESOURCE_KIND)i)
+                    << ", " << (owner->second[i].second >> 10) << " KB";
+    return resources.size();
+}
+
+const char *GpuResourceRegistry::GetKindName(GPU_RESOURCE_KIND kind)
+{
+    static const char *names[GPU_RESOURCE_KIND_COUNT] = { "buffers", "textures", "vertex arrays", "framebuffers", "renderbuffers", "programs" };
+    return names[kind];
+}
+
+size_t GpuResourceRegistry::TextureBytes(unsigned int width, unsigned int height, unsigned int layers, unsigned int bytesPerTexel, bool isMipmapped)
+{
+    size_t level0 = (size_t)width * height * layers * bytesPerTexel;
+    return isMipmapped ? level0 + level0 / 3 : level0;
+}
+
+void GpuResourceRegistry::changeBytes(GPU_RESOURCE_KIND kind, size_t removed, size_t added)
+{
+    bytes[kind] += added - removed;
+    totalBytes += added - removed;
+    if (bytes[kind] > peakBytes[kind])
+        peakBytes[kind] = bytes[kind];
+    if (budget && totalBytes > budget && !isOverBudget)
+        LOG(LOG_WARNING) << "GPU memory went over the budget: " << (totalBytes >> 20) << " of " << (budget >> 20) << " MB";
+    isOverBudget = budget && totalBytes > budget;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+using namespace std;
+
+enum GPU_RESOURCE_KIND { GPU_BUFFER, GPU_TEXTURE, GPU_VERTEX_ARRAY, GPU_FRAMEBUFFER, GPU_RENDERBUFFER, GPU_PROGRAM, GPU_RESOURCE_KIND_COUNT };
+
+// Every GL object the renderer creates, with an estimate of its video memory and the asset or subsystem owning it.
+// The code that creates an object registers it right after glGen* and unregisters it next to glDelete*, so the
+// registry knows what is alive per kind, the most there ever was (high-water mark) and, at shutdown, what was never
+// deleted. Sizes are estimates from the requested storage (mips, layers and formats included, driver padding not).
+class GpuResourceRegistry
+{
+public:
+    static GpuResourceRegistry &Get();
+
+    void Add(GPU_RESOURCE_KIND kind, unsigned int id, size_t bytes, const string &owner);
+    // the storage of the object was given or changed (glBufferData, mips streamed in or dropped)
+    void SetBytes(GPU_RESOURCE_KIND kind, unsigned int id, size_t bytes);
+    // the object turned out to belong to a more specific asset than its creator knew (a mesh of a model file)
+    void SetOwner(GPU_RESOURCE_KIND kind, unsigned int id, const string &owner);
+    void Remove(GPU_RESOURCE_KIND kind, unsigned int id);
+
+    unsigned int GetCount(GPU_RESOURCE_KIND kind);
+    size_t GetBytes(GPU_RESOURCE_KIND kind);
+    size_t GetPeakBytes(GPU_RESOURCE_KIND kind);
+    size_t GetTotalBytes();
+    // a warning is logged whenever the total goes over the budget, 0 for no budget
+    void SetBudget(size_t bytes);
+
+    // count, memory and high-water mark of every kind
+    void LogSummary();
+    // logs every object that is still registered, grouped by owner, and returns how many there are.
+    // Call it after everything has been released, right before the GL context goes away
+    unsigned int ReportLeaks();
+
+    static const char *GetKindName(GPU_RESOURCE_KIND kind);
+    // memory of a texture with all its layers (6 for a cube map), a full mip chain adds a third
+    static size_t TextureBytes(unsigned int width, unsigned int height, unsigned int layers, unsigned int bytesPerTexel, bool isMipmapped);
+
+private:
+    struct Resource {
+        size_t bytes;
+        string owner;
+    };
+
+    std::mutex mutex; // objects are created on the render thread, the summary may be asked for from anywhere
+    map<pair<int, unsigned int>, Resource> resources;
+    unsigned int counts[GPU_RESOURCE_KIND_COUNT];
+    size_t bytes[GPU_RESOURCE_KIND_COUNT];
+    size_t peakBytes[GPU_RESOURCE_KIND_COUNT];
+    size_t totalBytes;
+    size_t budget;
+    bool isOverBudget;
+
+    GpuResourceRegistry();
+    void changeBytes(GPU_RESOURCE_KIND kind, size_t removed, size_t added);
+};
+#endif
@@ -0,0 +1,154 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static double secondsNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Logger &Logger::Get()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : startTime(secondsNow()), isRunning(false), droppedCount(0), output(nullptr)
+{
+}
+
+Logger::~Logger()
+{
+    Stop();
+}
+
+bool Logger::Start(const string &path)
+{
+    Stop();
+    output = path.empty() ? stdout : fopen(path.c_str(), "w");
+    if (!output) {
+        output = nullptr;
+        std::cout << "ERROR::LOG::START:: Couldn't open " << path << std::endl;
+        return false;
+    }
+    isRunning = true;
+    writer = std::thread(&Logger::writerLoop, this);
+    return true;
+}
+
+void Logger::Stop()
+{
+    if (!isRunning)
+        return;
+    isRunning = false;
+    writer.join();
+    if (output && output != stdout)
+        fclose(output);
+    output = nullptr;
+    if (droppedCount > 0)
+        std::cout << "ERROR::LOG::STOP:: " << droppedCount << " lines were dropped, the log queue of their thread was full" << std::endl;
+}
+
+void Logger::Write(const LogRecord &record)
+{
+    if (!isRunning) {
+        // nobody drains the queues, the line goes out right away
+        std::cout << record.text << std::endl;
+        return;
+    }
+    if (!threadQueue().records.Push(record))
+        droppedCount++;
+}
+
+unsigned int Logger::GetDroppedCount() const
+{
+    return droppedCount;
+}
+
+double Logger::GetTime() const
+{
+    return secondsNow() - startTime;
+}
+
+Logger::ThreadQueue &Logger::threadQueue()
+{
+    // queues outlive their threads, the writer may still be draining one
+    thread_local ThreadQueue *queue = nullptr;
+    if (!queue) {
+        std::lock_guard<std::mutex> lock(queuesMutex);
+        queues.push_back(unique_ptr<ThreadQueue>(new ThreadQueue()));
+        queue = queues.back().get();
+    }
+    return *queue;
+}
+
+void Logger::writerLoop()
+{
+    vector<LogRecord> batch;
+    while (isRunning)
+    {
+        if (!drain(batch))
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // lines queued before Stop()
+    while (drain(batch))
+        ;
+}
+
+bool Logger::drain(vector<LogRecord> &batch)
+{
+    batch.clear();
+    {
+        std::lock_guard<std::mutex> lock(queuesMutex);
+        LogRecord record;
+        for (unsigned int i = 0; i < queues.size(); i++)
+            while (queues[i]->records.Pop(record))
+                batch.push_back(record);
+    }
+    if (batch.empty())
+        return false;
+    stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) { return a.time < b.time; });
+    for (unsigned int i = 0; i < batch.size(); i++)
+        print(batch[i]);
+    fflush(output);
+    return true;
+}
+
+void Logger::print(const LogRecord &record)
+{
+    static const char *levels[] = { "debug", "info", "warning", "error" };
+    fprintf(output, "[%9.3f %-7s] %s\n", record.time, levels[record.level], record.text);
+}
+
+LogLine::LogLine(LOG_LEVEL level)
+    : buffer(record.text, LogRecord::TEXT_SIZE), stream(&buffer)
+{
+    record.time = Logger::Get().GetTime();
+    record.level = level;
+}
+
+LogLine::~LogLine()
+{
+    record.text[buffer.GetLength()] = '\0';
+    Logger::Get().Write(record);
+}
+
+LogLine::TextBuffer::TextBuffer(char *text, size_t size)
+{
+    // the last char is kept for the terminating zero
+    setp(text, text + size - 1);
+}
+
+size_t LogLine::TextBuffer::GetLength() const
+{
+    return pptr() - pbase();
+}
+
+LogLine::TextBuffer::int_type LogLine::TextBuffer::overflow(int_type character)
+{
+    // the line is full, the rest is dropped
+    return traits_type::not_eof(character);
+}
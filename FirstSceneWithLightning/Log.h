@@ -0,0 +1,115 @@
+#pragma once
+#ifndef LOG_H
+#define LOG_H
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+enum LOG_LEVEL { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR };
+
+// lines below this level are compiled out, arguments and all
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_INFO
+#else
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+#endif
+
+// LOG(LOG_ERROR) << "ERROR::SCENE::PARSE_FAILED: " << path;
+// The line is formatted into a fixed buffer on the calling thread and handed to the Logger, no endl needed
+#define LOG(level) ((level) < LOG_MIN_LEVEL) ? (void)0 : LogVoidify() & LogLine(level)
+
+struct LogRecord {
+    static const unsigned int TEXT_SIZE = 240; // longer lines are cut
+    double time; // seconds since the logger was created
+    LOG_LEVEL level;
+    char text[TEXT_SIZE];
+};
+
+// Writes log lines on a background thread. Every thread that logs gets its own lock-free queue the first time it
+// does, so logging costs a formatted copy and never waits on a lock, a flush or the console; the writer thread
+// drains the queues every few milliseconds to the console or a file. Lines of a thread keep their order, lines of
+// different threads are ordered by their timestamps within a drain. A full queue drops its thread's lines (they
+// are counted) instead of blocking. Before Start() and after Stop() lines are written right away.
+class Logger
+{
+public:
+    static Logger &Get();
+
+    // starts the writer thread, lines go to the file at path or to the console if it is empty
+    bool Start(const string &path = string());
+    // writes whatever is queued and stops the writer thread
+    void Stop();
+    void Write(const LogRecord &record);
+    unsigned int GetDroppedCount() const;
+    double GetTime() const;
+
+private:
+    static const size_t QUEUE_SIZE = 512;
+    struct ThreadQueue {
+        SpscQueue<LogRecord, QUEUE_SIZE> records;
+    };
+
+    double startTime;
+    std::mutex queuesMutex; // only taken when a thread logs for the first time and by the writer
+    vector<unique_ptr<ThreadQueue> > queues;
+    std::atomic<bool> isRunning;
+    std::atomic<unsigned int> droppedCount;
+    FILE *output;
+    std::thread writer;
+
+    Logger();
+    ~Logger();
+    ThreadQueue &threadQueue();
+    void writerLoop();
+    // writes every queued record, false if there were none
+    bool drain(vector<LogRecord> &batch);
+    void print(const LogRecord &record);
+};
+
+// one LOG() line being formatted
+class LogLine
+{
+public:
+    explicit LogLine(LOG_LEVEL level);
+    ~LogLine();
+
+    template <typename T>
+    LogLine &operator<<(const T &value)
+    {
+        stream << value;
+        return *this;
+    }
+
+private:
+    // writes into record.text and silently cuts what doesn't fit
+    class TextBuffer : public std::streambuf
+    {
+    public:
+        TextBuffer(char *text, size_t size);
+        size_t GetLength() const;
+    protected:
+        int_type overflow(int_type character);
+    };
+
+    LogRecord record;
+    TextBuffer buffer;
+    std::ostream stream;
+};
+
+// turns LOG()'s stream expression into void for the ?: of the macro
+struct LogVoidify {
+    void operator&(const LogLine &) {}
+};
+#endif
@@ -0,0 +1,204 @@
+#include "MaterialTable.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+// component of the material's ivec4 in the Materials block. The separate normal, specular and height maps
+// are left to the software renderer, the shaders read their packed copy
+static int textureRole(const string &type)
+{
+    if (type == "texture_diffuse")
+        return 0;
+    if (type == "texture_packed")
+        return 1;
+    return -1;
+}
+
+// LOG takes it by reference
+const unsigned int MaterialTable::MAX_MATERIALS;
+
+MaterialTable::MaterialTable() : isBuilt(false), isStreamed(false), nextMaterial(0), uniformBuffer(0), boundArray(0)
+{
+}
+
+bool MaterialTable::BuildStep(const SceneDescription &scene, TextureStreamer *streamer)
+{
+    if (isBuilt)
+        return true;
+    if (nextMaterial == 0) {
+        isStreamed = streamer != nullptr;
+        layers.assign(MAX_MATERIALS, glm::ivec4(-1));
+        materialArrays.assign(scene.materials.size(), -1);
+        if (scene.materials.size() > MAX_MATERIALS)
+            LOG(LOG_ERROR) << "ERROR::MATERIAL_TABLE::BUILD:: Only the first " << MAX_MATERIALS << " materials get textures";
+    }
+
+    unsigned int m = nextMaterial;
+    if (m < scene.materials.size() && m < MAX_MATERIALS) {
+        nextMaterial++;
+        const SceneMaterial &material = scene.materials[m];
+        unsigned int width = 0, height = 0;
+        vector<int> roles;
+        vector<string> paths;
+        vector<vector<unsigned char> > texels;
+        for (unsigned int t = 0; t < material.textures.size(); t++)
+        {
+            int role = textureRole(material.textures[t].type);
+            if (role < 0)
+                continue;
+            int imageWidth, imageHeight, components;
+            unsigned char *data = SOIL_load_image(material.textures[t].path.c_str(), &imageWidth, &imageHeight, &components, SOIL_LOAD_RGBA);
+            if (!data) {
+                LOG(LOG_ERROR) << "ERROR::MATERIAL_TABLE::BUILD:: Texture failed to load at path: " << material.textures[t].path;
+                continue;
+            }
+            vector<unsigned char> image(data, data + imageWidth * imageHeight * 4);
+            SOIL_free_image_data(data);
+            if (paths.empty()) {
+                width = imageWidth;
+                height = imageHeight;
+            } else if ((unsigned int)imageWidth != width || (unsigned int)imageHeight != height) {
+                vector<unsigned char> scaled;
+                resizeImage(image, imageWidth, imageHeight, 4, width, height, scaled);
+                image.swap(scaled);
+            }
+            roles.push_back(role);
+            paths.push_back(material.textures[t].path);
+            texels.push_back(vector<unsigned char>());
+            texels.back().swap(image);
+        }
+        if (paths.empty())
+            return false;
+
+        unsigned int array = 0;
+        while (array < arrayLayers.size() && (arrayLayers[array].width != width || arrayLayers[array].height != height ||
+                                              arrayLayers[array].paths.size() + paths.size() > MAX_LAYERS))
+            array++;
+        if (array == arrayLayers.size()) {
+            arrayLayers.push_back(ArrayLayers());
+            arrayLayers[array].width = width;
+            arrayLayers[array].height = height;
+        }
+        ArrayLayers &target = arrayLayers[array];
+        for (unsigned int t = 0; t < paths.size(); t++)
+        {
+            layers[m][roles[t]] = target.paths.size();
+            target.paths.push_back(paths[t]);
+            target.texels.push_back(vector<unsigned char>());
+            target.texels.back().swap(texels[t]);
+        }
+        materialArrays[m] = array;
+        return false;
+    }
+
+    // every material is decoded, upload the arrays
+    for (unsigned int i = 0; i < arrayLayers.size(); i++)
+    {
+        const ArrayLayers &source = arrayLayers[i];
+        if (streamer) {
+            arrays.push_back(streamer->AddArray(source.paths, source.texels, source.width, source.height));
+            continue;
+        }
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, source.width, source.height, source.paths.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        for (unsigned int layer = 0; layer < source.texels.size(); layer++)
+            GlStats::TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, source.width, source.height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                   source.texels[layer].data(), source.texels[layer].size());
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        GpuResourceRegistry::Get().Add(GPU_TEXTURE, texture, GpuResourceRegistry::TextureBytes(source.width, source.height, source.paths.size(), 4, true),
+                                       "material table");
+        arrays.push_back(texture);
+    }
+    arrayLayers.clear();
+
+    // std140 pads array elements to 16 bytes anyway, z and w of the ivec4 are unused
+    glGenBuffers(1, &uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    GlStats::BufferData(GL_UNIFORM_BUFFER, layers.size() * sizeof(glm::ivec4), layers.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, uniformBuffer);
+    GpuResourceRegistry::Get().Add(GPU_BUFFER, uniformBuffer, layers.size() * sizeof(glm::ivec4), "material table");
+    isBuilt = true;
+    return true;
+}
+
+void MaterialTable::Build(const SceneDescription &scene, TextureStreamer *streamer)
+{
+    while (!BuildStep(scene, streamer))
+        ;
+}
+
+void MaterialTable::SetupShader(Shader &shader)
+{
+    shader.Use();
+    shader.setInt("materialTextures", TEXTURE_UNIT);
+    GLuint block = glGetUniformBlockIndex(shader.ID, "Materials");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.ID, block, UNIFORM_BINDING);
+}
+
+void MaterialTable::ResetBindings()
+{
+    boundArray = 0;
+}
+
+void MaterialTable::Use(int material)
+{
+    if (material < 0 || material >= (int)materialArrays.size() || materialArrays[material] < 0)
+        return;
+    unsigned int array = arrays[materialArrays[material]];
+    if (array == boundArray)
+        return;
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    GlStats::BindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glActiveTexture(GL_TEXTURE0);
+    boundArray = array;
+}
+
+unsigned int MaterialTable::GetArrayTexture(int material) const
+{
+    if (material < 0 || material >= (int)materialArrays.size() || materialArrays[material] < 0)
+        return 0;
+    return arrays[materialArrays[material]];
+}
+
+unsigned int MaterialTable::GetArrayCount() const
+{
+    return arrays.size();
+}
+
+bool MaterialTable::IsBuilt() const
+{
+    return isBuilt;
+}
+
+void MaterialTable::Clear()
+{
+    // streamed arrays belong to the streamer
+    if (!isStreamed && !arrays.empty()) {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+            GpuResourceRegistry::Get().Remove(GPU_TEXTURE, arrays[i]);
+        glDeleteTextures(arrays.size(), arrays.data());
+    }
+    if (uniformBuffer) {
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, uniformBuffer);
+        glDeleteBuffers(1, &uniformBuffer);
+    }
+    arrays.clear();
+    materialArrays.clear();
+    arrayLayers.clear();
+    layers.clear();
+    nextMaterial = 0;
+    uniformBuffer = 0;
+    boundArray = 0;
+    isBuilt = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <GL/glew.h>
+
+#include "SceneDescription.h"
+#include "Shader.h"
+#include "TextureStreaming.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Textures of the scene materials packed into RGBA GL_TEXTURE_2D_ARRAYs: the diffuse and packed (TexturePacking.h)
+// textures of a material go to one array, materials of the same texture size share it. The layer of each texture
+// lives in the Materials uniform block, so a draw only passes materialIndex with its DrawConstants and binds the
+// array when it changes, instead of a texture and a sampler uniform per map. Shaders sample with sampleMaterial()
+// (Shaders/Common/materials.glsl).
+class MaterialTable
+{
+public:
+    static const unsigned int MAX_MATERIALS = 64; // size of the materialLayers array in materials.glsl
+    static const unsigned int MAX_LAYERS = 256;   // GL 3.3 guarantees at least this many
+    static const unsigned int TEXTURE_UNIT = 1;
+    static const unsigned int UNIFORM_BINDING = 0;
+
+    MaterialTable();
+
+    // decodes the textures of the next material of the scene, after the last one creates the arrays, streamed by
+    // streamer if it isn't null, and returns true. Textures of a material that differ in size from its first one are
+    // scaled to it. Spread over frames so that no frame decodes the whole scene
+    bool BuildStep(const SceneDescription &scene, TextureStreamer *streamer);
+    // does the steps that are left
+    void Build(const SceneDescription &scene, TextureStreamer *streamer);
+    // points the shader's materialTextures sampler and Materials block at the table, once after creating it
+    static void SetupShader(Shader &shader);
+    // forget which array is bound, other code may have used the unit since the last draws
+    void ResetBindings();
+    // binds the material's array unless it is bound already
+    void Use(int material);
+    // 0 for a material without textures
+    unsigned int GetArrayTexture(int material) const;
+    unsigned int GetArrayCount() const;
+    bool IsBuilt() const;
+    void Clear();
+
+private:
+    // decoded layers of one array until the last material is done
+    struct ArrayLayers {
+        unsigned int width, height;
+        vector<string> paths;
+        vector<vector<unsigned char> > texels;
+    };
+
+    bool isBuilt;
+    bool isStreamed;
+    unsigned int nextMaterial;
+    vector<ArrayLayers> arrayLayers;
+    vector<glm::ivec4> layers; // per material, the layer of each role
+    vector<unsigned int> arrays;
+    vector<int> materialArrays; // index in arrays per scene material, -1 without textures
+    unsigned int uniformBuffer;
+    unsigned int boundArray;
+};
+#endif
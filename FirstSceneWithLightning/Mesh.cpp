@@ -1,14 +1,84 @@
 #include "Mesh.h"
+#include "Log.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+
+#include <cstring>
+#include <map>
 
 using namespace std;
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+// texture unit of a sampler name, in the order the names are first drawn with. Only the render thread draws
+static int samplerUnit(const string &name)
+{
+    static map<string, int> units;
+    map<string, int>::iterator unit = units.find(name);
+    if (unit == units.end())
+        unit = units.insert(make_pair(name, (int)units.size())).first;
+    return unit->second;
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool isCpuOnly, bool isCpuDataKept)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    this->isCpuOnly = isCpuOnly;
 
-    setupMesh();
+    setupMesh(isCpuDataKept || isCpuOnly);
+}
+
+Mesh::Mesh(unsigned int vertexCount, const function<void(unsigned int, Vertex &)> &vertex, unsigned int indexCount,
+           const function<void(unsigned int *)> &writeIndices, vector<Texture> textures, bool isCpuDataKept)
+{
+    this->textures = std::move(textures);
+    this->isCpuOnly = false;
+    this->vertexCount = vertexCount;
+    this->indexCount = indexCount;
+    workWithEBO = indexCount ? true : false;
+    setupSamplers();
+    createBuffers();
+
+    // a whole Vertex at a time, mapped memory is usually write-combined and must not be read back
+    Vertex *mappedVertices = (Vertex *)mapBuffer(GL_ARRAY_BUFFER, VBO, vertexCount * sizeof(Vertex));
+    glm::vec3 *mappedPositions = (glm::vec3 *)mapBuffer(GL_ARRAY_BUFFER, positionVBO, vertexCount * sizeof(glm::vec3));
+    if (isCpuDataKept)
+        vertices.resize(vertexCount);
+    boundsMin = glm::vec3(1e30f);
+    boundsMax = glm::vec3(-1e30f);
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        Vertex converted;
+        vertex(i, converted);
+        if (mappedVertices)
+            mappedVertices[i] = converted;
+        if (mappedPositions)
+            mappedPositions[i] = converted.Position;
+        if (isCpuDataKept)
+            vertices[i] = converted;
+        boundsMin = glm::min(boundsMin, converted.Position);
+        boundsMax = glm::max(boundsMax, converted.Position);
+    }
+    if (mappedVertices)
+        unmapBuffer(GL_ARRAY_BUFFER, VBO, vertexCount * sizeof(Vertex));
+    if (mappedPositions)
+        unmapBuffer(GL_ARRAY_BUFFER, positionVBO, vertexCount * sizeof(glm::vec3));
+
+    if (workWithEBO) {
+        glBindVertexArray(VAO);
+        unsigned int *mappedIndices = (unsigned int *)mapBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO, indexCount * sizeof(unsigned int));
+        if (isCpuDataKept) {
+            indices.resize(indexCount);
+            writeIndices(&indices[0]);
+            if (mappedIndices)
+                memcpy(mappedIndices, &indices[0], indexCount * sizeof(unsigned int));
+        } else if (mappedIndices) {
+            writeIndices(mappedIndices);
+        }
+        if (mappedIndices)
+            unmapBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO, indexCount * sizeof(unsigned int));
+        glBindVertexArray(0);
+    }
 }
 
 Mesh::Mesh(const Mesh &mesh)
@@ -16,21 +86,145 @@ Mesh::Mesh(const Mesh &mesh)
     this->vertices = mesh.vertices;
     this->indices = mesh.indices;
     this->textures = mesh.textures;
+    this->isCpuOnly = mesh.isCpuOnly;
 
-    setupMesh();
+    if (isCpuOnly || vertices.size() == mesh.vertexCount) {
+        setupMesh(true);
+        return;
+    }
+    // the CPU copy was dropped, copy the buffers instead
+    vertexCount = mesh.vertexCount;
+    indexCount = mesh.indexCount;
+    boundsMin = mesh.boundsMin;
+    boundsMax = mesh.boundsMax;
+    workWithEBO = mesh.workWithEBO;
+    setupSamplers();
+    createBuffers();
+    copyBuffer(mesh.VBO, VBO, vertexCount * sizeof(Vertex));
+    copyBuffer(mesh.positionVBO, positionVBO, vertexCount * sizeof(glm::vec3));
+    if (workWithEBO)
+        copyBuffer(mesh.EBO, EBO, indexCount * sizeof(unsigned int));
+}
+
+Mesh::Mesh(Mesh &&mesh) noexcept
+    : vertices(std::move(mesh.vertices)), indices(std::move(mesh.indices)), textures(std::move(mesh.textures)),
+      vertexCount(mesh.vertexCount), indexCount(mesh.indexCount), boundsMin(mesh.boundsMin), boundsMax(mesh.boundsMax),
+      VAO(mesh.VAO), depthVAO(mesh.depthVAO), isCpuOnly(mesh.isCpuOnly), VBO(mesh.VBO), EBO(mesh.EBO),
+      positionVBO(mesh.positionVBO), workWithEBO(mesh.workWithEBO), samplerNames(std::move(mesh.samplerNames)),
+      samplerProgram(mesh.samplerProgram), samplerUnits(std::move(mesh.samplerUnits))
+{
+    mesh.VAO = mesh.depthVAO = mesh.VBO = mesh.EBO = mesh.positionVBO = 0;
+    mesh.vertexCount = mesh.indexCount = 0;
+}
+
+Mesh::~Mesh()
+{
+    deleteBuffers();
+}
+
+void Mesh::SetOwner(const string &owner)
+{
+    GpuResourceRegistry &registry = GpuResourceRegistry::Get();
+    registry.SetOwner(GPU_VERTEX_ARRAY, VAO, owner);
+    registry.SetOwner(GPU_VERTEX_ARRAY, depthVAO, owner);
+    registry.SetOwner(GPU_BUFFER, VBO, owner);
+    registry.SetOwner(GPU_BUFFER, EBO, owner);
+    registry.SetOwner(GPU_BUFFER, positionVBO, owner);
 }
 
 void Mesh::Draw(Shader shader)
 {
+    // the names don't change, the sampler uniforms are set only for another program. Every mesh gives a name
+    // the same unit, so the values left in the program fit the other meshes drawn with it too
+    if (shader.ID != samplerProgram) {
+        samplerProgram = shader.ID;
+        samplerUnits.resize(samplerNames.size());
+        for (unsigned int i = 0; i < samplerNames.size(); i++)
+        {
+            samplerUnits[i] = samplerUnit(samplerNames[i]);
+            glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), samplerUnits[i]);
+            GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
+        }
+    }
     // bind appropriate textures
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + samplerUnits[i]);
+        GlStats::BindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+
+    glBindVertexArray(VAO);
+    if (workWithEBO) {
+        GlStats::DrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    } else {
+        GlStats::DrawArrays(GL_TRIANGLES, 0, vertexCount);
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawDepth()
+{
+    glBindVertexArray(depthVAO);
+    if (workWithEBO) {
+        GlStats::DrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    } else {
+        GlStats::DrawArrays(GL_TRIANGLES, 0, vertexCount);
+    }
+    glBindVertexArray(0);
+}
+
+// initializes all the buffer objects/arrays
+void Mesh::setupMesh(bool isCpuDataKept)
+{
+    vertexCount = vertices.size();
+    indexCount = indices.size();
+    workWithEBO = indices.size() ? true : false;
+    boundsMin = glm::vec3(1e30f);
+    boundsMax = glm::vec3(-1e30f);
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[i].Position);
+        boundsMax = glm::max(boundsMax, vertices[i].Position);
+    }
+    setupSamplers();
+    if (isCpuOnly) {
+        VAO = depthVAO = VBO = EBO = positionVBO = 0;
+        return;
+    }
+    createBuffers();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    //C-like hacks here
+    allocateBuffer(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0]);
+    if (workWithEBO)
+        allocateBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0]);
+    glBindVertexArray(0);
+
+    // tightly packed copy of the positions, depth-only passes fetch 12 bytes per vertex instead of the whole Vertex
+    vector<glm::vec3> positions(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        positions[i] = vertices[i].Position;
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    allocateBuffer(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (!isCpuDataKept) {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+}
+
+void Mesh::setupSamplers()
+{
+    // retrieve texture number (the N in diffuse_textureN)
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
+    samplerNames.clear();
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
-        // retrieve texture number (the N in diffuse_textureN)
         string number;
         string name = textures[i].type;
         if (name == "texture_diffuse")
@@ -41,38 +235,23 @@ void Mesh::Draw(Shader shader)
             number = std::to_string(normalNr++); // transfer unsigned int to stream
         else if (name == "texture_height")
             number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        samplerNames.push_back(name + number);
     }
-
-    glBindVertexArray(VAO);
-    if (workWithEBO) {
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    } else {
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-    }
-    glBindVertexArray(0);
-    glActiveTexture(GL_TEXTURE0);
+    samplerProgram = 0;
 }
 
-// initializes all the buffer objects/arrays
-void Mesh::setupMesh()
+void Mesh::createBuffers()
 {
-    workWithEBO = indices.size() ? true : false;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
+    EBO = 0;
+    if (workWithEBO)
+        glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    //C-like hacks here
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    if (workWithEBO) {
-        glGenBuffers(1, &EBO);
+    if (workWithEBO)
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-    }
     // vertex Positions
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -89,4 +268,82 @@ void Mesh::setupMesh()
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
     glBindVertexArray(0);
-}
\ No newline at end of file
+
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+    glBindVertexArray(depthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    if (workWithEBO) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the storage comes right after, with these sizes
+    GpuResourceRegistry &registry = GpuResourceRegistry::Get();
+    registry.Add(GPU_VERTEX_ARRAY, VAO, 0, "mesh");
+    registry.Add(GPU_VERTEX_ARRAY, depthVAO, 0, "mesh");
+    registry.Add(GPU_BUFFER, VBO, vertexCount * sizeof(Vertex), "mesh");
+    registry.Add(GPU_BUFFER, EBO, indexCount * sizeof(unsigned int), "mesh");
+    registry.Add(GPU_BUFFER, positionVBO, vertexCount * sizeof(glm::vec3), "mesh");
+}
+
+void Mesh::deleteBuffers()
+{
+    if (isCpuOnly)
+        return;
+    unsigned int vertexArrays[] = { VAO, depthVAO }, buffers[] = { VBO, EBO, positionVBO };
+    for (unsigned int i = 0; i < 2; i++)
+        GpuResourceRegistry::Get().Remove(GPU_VERTEX_ARRAY, vertexArrays[i]);
+    for (unsigned int i = 0; i < 3; i++)
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, buffers[i]);
+    // zero names are skipped by GL, moved-from meshes have nothing to delete
+    glDeleteVertexArrays(2, vertexArrays);
+    glDeleteBuffers(3, buffers);
+    VAO = depthVAO = VBO = EBO = positionVBO = 0;
+}
+
+void Mesh::allocateBuffer(GLenum target, size_t bytes, const void *data)
+{
+    if (bytes == 0)
+        return;
+    if (GLEW_ARB_buffer_storage)
+        GlStats::BufferStorage(target, bytes, data, data ? 0 : GL_MAP_WRITE_BIT);
+    else
+        GlStats::BufferData(target, bytes, data, GL_STATIC_DRAW);
+}
+
+void *Mesh::mapBuffer(GLenum target, unsigned int buffer, size_t bytes)
+{
+    if (bytes == 0)
+        return nullptr;
+    glBindBuffer(target, buffer);
+    allocateBuffer(target, bytes, nullptr);
+    void *data = glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!data)
+        LOG(LOG_ERROR) << "ERROR::MESH::MAP:: Couldn't map a buffer of " << bytes << " bytes";
+    return data;
+}
+
+void Mesh::unmapBuffer(GLenum target, unsigned int buffer, size_t bytes)
+{
+    glBindBuffer(target, buffer);
+    // the driver may lose mapped memory (display mode changes), the data is gone then
+    if (GlStats::UnmapBuffer(target, bytes) == GL_FALSE)
+        LOG(LOG_ERROR) << "ERROR::MESH::UNMAP:: Buffer contents were lost while mapped";
+    if (target == GL_ARRAY_BUFFER)
+        glBindBuffer(target, 0);
+}
+
+void Mesh::copyBuffer(unsigned int source, unsigned int target, size_t bytes)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    allocateBuffer(GL_COPY_WRITE_BUFFER, bytes, nullptr);
+    if (bytes)
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -9,6 +9,7 @@
 
 #include "Shader.h"
 
+#include <functional>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -38,26 +39,61 @@ struct Texture {
 class Mesh {
 public:
     /*  Mesh Data  */
-    vector<Vertex> vertices;
+    vector<Vertex> vertices;      // empty once uploaded unless the CPU copy is kept
     vector<unsigned int> indices;
     vector<Texture> textures;
+    unsigned int vertexCount, indexCount;
+    glm::vec3 boundsMin, boundsMax; // local box of the positions, known even without the CPU copy
     unsigned int VAO;
+    unsigned int depthVAO; // positions only, for depth-only passes
+    bool isCpuOnly;        // no GL objects at all, the data is only read on the CPU (software renderer)
 
     /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // constructor, the vectors are moved in and dropped after the upload unless isCpuDataKept
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool isCpuOnly = false, bool isCpuDataKept = true);
+    // writes the data straight into mapped GL buffers without building vectors first: vertex fills vertex i,
+    // writeIndices fills indexCount indices. The vectors are only filled too if isCpuDataKept
+    Mesh(unsigned int vertexCount, const function<void(unsigned int, Vertex &)> &vertex, unsigned int indexCount,
+         const function<void(unsigned int *)> &writeIndices, vector<Texture> textures, bool isCpuDataKept = false);
+    // copies the GL buffers on the GPU if the CPU copy is gone
     Mesh(const Mesh &mesh);
+    // takes over the GL objects, nothing is uploaded again
+    Mesh(Mesh &&mesh) noexcept;
+    // deletes the GL objects, the context has to be alive
+    ~Mesh();
+    Mesh &operator=(const Mesh &) = delete;
+    // names the asset the GL objects belong to in the GpuResourceRegistry
+    void SetOwner(const string &owner);
     // render the mesh
     void Draw(Shader shader);
+    // render only the positions, no textures are bound (depth pre-pass, shadow maps)
+    void DrawDepth();
 
 private:
     /*  Render data  */
     unsigned int VBO, EBO;
+    unsigned int positionVBO;
     bool workWithEBO;
+    // sampler uniform of every texture ("texture_diffuse1", ...) and its texture unit. The units are set in the
+    // program once, when the mesh is first drawn with it
+    vector<string> samplerNames;
+    unsigned int samplerProgram;
+    vector<int> samplerUnits;
 
     /*  Functions    */
     // initializes all the buffer objects/arrays
-    void setupMesh();
+    void setupMesh(bool isCpuDataKept);
+    void setupSamplers();
+    // the VAOs and buffers without storage yet
+    void createBuffers();
+    void deleteBuffers();
+    // gives the bound buffer its storage, immutable where buffer storage is supported
+    static void allocateBuffer(GLenum target, size_t bytes, const void *data);
+    // allocates the buffer and maps it for writing, nullptr on failure
+    static void *mapBuffer(GLenum target, unsigned int buffer, size_t bytes);
+    // bytes were written into the mapping, for GlStats
+    static void unmapBuffer(GLenum target, unsigned int buffer, size_t bytes);
+    static void copyBuffer(unsigned int source, unsigned int target, size_t bytes);
 };
 #endif
 
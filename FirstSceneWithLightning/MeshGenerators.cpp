@@ -1,6 +1,7 @@
 #include "MeshGenerators.h"
+#include "TangentSpace.h"
 
-Mesh createCubeMesh(std::vector<Texture> textures) {
+Mesh createCubeMesh(std::vector<Texture> textures, bool isCpuOnly) {
     std::vector<Vertex> verticies;
     Vertex temp;
     temp.Position = glm::vec3(-0.5, 0.5, 0.5); // Front Top Left
@@ -57,14 +58,35 @@ Mesh createCubeMesh(std::vector<Texture> textures) {
         temp.Position = glm::vec3(vertices[i * 8 + 0], vertices[i * 8 + 1], vertices[i * 8 + 2]); // Front Top Left
         temp.Normal = glm::vec3(vertices[i * 8 + 3], vertices[i * 8 + 4], vertices[i * 8 + 5]);
         temp.TexCoords = glm::vec2(vertices[i * 8 + 6], vertices[i * 8 + 7]);
-        temp.Tangent = glm::vec3(); // 
-        temp.Bitangent = glm::vec3(); //
         verticies.push_back(temp);
     }
-    return Mesh(verticies, std::vector<unsigned int>(), textures);
+    GenerateTangents(verticies, std::vector<unsigned int>());
+    return Mesh(verticies, std::vector<unsigned int>(), textures, isCpuOnly);
 }
 
-Mesh createQuadMesh(std::vector<Texture> textures)
+void calculateTriangleTangents(const glm::vec3 &pos1, const glm::vec3 &pos2, const glm::vec3 &pos3,
+                               const glm::vec2 &uv1, const glm::vec2 &uv2, const glm::vec2 &uv3,
+                               glm::vec3 &tangent, glm::vec3 &bitangent)
+{
+    glm::vec3 edge1 = pos2 - pos1;
+    glm::vec3 edge2 = pos3 - pos1;
+    glm::vec2 deltaUV1 = uv2 - uv1;
+    glm::vec2 deltaUV2 = uv3 - uv1;
+
+    GLfloat f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+    tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+    tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+    tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+    tangent = glm::normalize(tangent);
+
+    bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+    bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+    bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+    bitangent = glm::normalize(bitangent);
+}
+
+Mesh createQuadMesh(std::vector<Texture> textures, bool isCpuOnly)
 {
     glm::vec3 pos1(-1.0f, 1.0f, 0.0f);
     glm::vec3 pos2(-1.0f, -1.0f, 0.0f);
@@ -78,69 +100,19 @@ Mesh createQuadMesh(std::vector<Texture> textures)
     // normal vector
     glm::vec3 nm(0.0f, 0.0f, 1.0f);
 
-    // calculate tangent/bitangent vectors of both triangles
-    glm::vec3 tangent1, bitangent1;
-    glm::vec3 tangent2, bitangent2;
-    // triangle 1
-    // ----------
-    glm::vec3 edge1 = pos2 - pos1;
-    glm::vec3 edge2 = pos3 - pos1;
-    glm::vec2 deltaUV1 = uv2 - uv1;
-    glm::vec2 deltaUV2 = uv3 - uv1;
-
-    GLfloat f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-    tangent1.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-    tangent1.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-    tangent1.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-    tangent1 = glm::normalize(tangent1);
-
-    bitangent1.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-    bitangent1.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-    bitangent1.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-    bitangent1 = glm::normalize(bitangent1);
-
-    // triangle 2
-    // ----------
-    edge1 = pos3 - pos1;
-    edge2 = pos4 - pos1;
-    deltaUV1 = uv3 - uv1;
-    deltaUV2 = uv4 - uv1;
-
-    f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-    tangent2.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-    tangent2.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-    tangent2.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-    tangent2 = glm::normalize(tangent2);
-
-
-    bitangent2.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-    bitangent2.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-    bitangent2.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-    bitangent2 = glm::normalize(bitangent2);
-
-    float vertices[] = {
-        // positions            // normal         // texcoords  // tangent                          // bitangent
-        pos1.x, pos1.y, pos1.z, nm.x, nm.y, nm.z, uv1.x, uv1.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-        pos2.x, pos2.y, pos2.z, nm.x, nm.y, nm.z, uv2.x, uv2.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-        pos3.x, pos3.y, pos3.z, nm.x, nm.y, nm.z, uv3.x, uv3.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-
-        pos1.x, pos1.y, pos1.z, nm.x, nm.y, nm.z, uv1.x, uv1.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z,
-        pos3.x, pos3.y, pos3.z, nm.x, nm.y, nm.z, uv3.x, uv3.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z,
-        pos4.x, pos4.y, pos4.z, nm.x, nm.y, nm.z, uv4.x, uv4.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z
-    };
+    glm::vec3 positions[] = { pos1, pos2, pos3, pos1, pos3, pos4 };
+    glm::vec2 uvs[] = { uv1, uv2, uv3, uv1, uv3, uv4 };
 
     std::vector<Vertex> verticies;
     for (int i = 0; i < 6; i++) {
         Vertex temp;
-        temp.Position = glm::vec3(vertices[i * 14 + 0], vertices[i * 14 + 1], vertices[i * 14 + 2]); // Front Top Left
-        temp.Normal = glm::vec3(vertices[i * 14 + 3], vertices[i * 14 + 4], vertices[i * 14 + 5]);
-        temp.TexCoords = glm::vec2(vertices[i * 14 + 6], vertices[i * 14 + 7]);
-        temp.Tangent = glm::vec3(vertices[i * 14 + 8], vertices[i * 14 + 9], vertices[i * 14 + 10]); // 
-        temp.Bitangent = glm::vec3(vertices[i * 14 + 11], vertices[i * 14 + 12], vertices[i * 14 + 13]); //
+        temp.Position = positions[i];
+        temp.Normal = nm;
+        temp.TexCoords = uvs[i];
         verticies.push_back(temp);
     }
+    // tangent/bitangent vectors of both triangles
+    GenerateTangents(verticies, std::vector<unsigned int>());
 
-    return Mesh(verticies, std::vector<unsigned int>(), textures);
+    return Mesh(verticies, std::vector<unsigned int>(), textures, isCpuOnly);
 }
\ No newline at end of file
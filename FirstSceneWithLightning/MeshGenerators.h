@@ -1,9 +1,14 @@
 #pragma once
 #include "Mesh.h"
 
-#include "GL/freeglut.h"
 #include <glm/glm.hpp>
 #include <iostream>
 
-Mesh createCubeMesh(std::vector<Texture> textures);
-Mesh createQuadMesh(std::vector<Texture> textures);
\ No newline at end of file
+// isCpuOnly meshes have no GL objects, see Mesh
+Mesh createCubeMesh(std::vector<Texture> textures, bool isCpuOnly = false);
+Mesh createQuadMesh(std::vector<Texture> textures, bool isCpuOnly = false);
+// tangent and bitangent of one triangle from its positions and texture coordinates, both normalized;
+// whole meshes go through GenerateTangents
+void calculateTriangleTangents(const glm::vec3 &pos1, const glm::vec3 &pos2, const glm::vec3 &pos3,
+                               const glm::vec2 &uv1, const glm::vec2 &uv2, const glm::vec2 &uv3,
+                               glm::vec3 &tangent, glm::vec3 &bitangent);
\ No newline at end of file
@@ -1,10 +1,27 @@
 #include "Model.h"
+#include "Log.h"
+#include "GpuResources.h"
+#include "TangentSpace.h"
 
-Model::Model(string const &path, bool gamma) : gammaCorrection(gamma)
+#include <cstring>
+
+Model::Model(string const &path, bool gamma, bool isCpuOnly, TextureStreamer *textureStreamer, bool isCpuDataKept, ThreadPool *pool)
+    : gammaCorrection(gamma), isCpuOnly(isCpuOnly), isCpuDataKept(isCpuDataKept), textureStreamer(textureStreamer), pool(pool)
 {
     loadModel(path);
 }
 
+Model::~Model()
+{
+    if (isCpuOnly || textureStreamer)
+        return;
+    for (unsigned int i = 0; i < textures_loaded.size(); i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_TEXTURE, textures_loaded[i].id);
+        glDeleteTextures(1, &textures_loaded[i].id);
+    }
+}
+
 // draws the model, and thus all its meshes
 void Model::Draw(Shader shader)
 {
@@ -12,98 +29,166 @@ void Model::Draw(Shader shader)
         meshes[i].Draw(shader);
 }
 
+void Model::Draw(Shader shader, const SceneGraph &graph, const vector<NodeId> &graphNodes, DrawConstantRing &constants, int material)
+{
+    for (unsigned int i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].meshes.empty())
+            continue;
+        constants.Bind(graph.GetWorldMatrix(graphNodes[i]), material);
+        for (unsigned int j = 0; j < nodes[i].meshes.size(); j++)
+            meshes[nodes[i].meshes[j]].Draw(shader);
+    }
+}
+
+void Model::DrawDepth(const SceneGraph &graph, const vector<NodeId> &graphNodes, DrawConstantRing &constants)
+{
+    for (unsigned int i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].meshes.empty())
+            continue;
+        constants.Bind(graph.GetWorldMatrix(graphNodes[i]), -1);
+        for (unsigned int j = 0; j < nodes[i].meshes.size(); j++)
+            meshes[nodes[i].meshes[j]].DrawDepth();
+    }
+}
+
+vector<NodeId> Model::AddToSceneGraph(SceneGraph &graph, NodeId parent) const
+{
+    vector<NodeId> graphNodes(nodes.size());
+    // nodes are stored parents first, so every parent already has its graph node
+    for (unsigned int i = 0; i < nodes.size(); i++)
+    {
+        NodeId graphParent = nodes[i].parent < 0 ? parent : graphNodes[nodes[i].parent];
+        graphNodes[i] = graph.AddNode(graphParent, nodes[i].transform);
+    }
+    return graphNodes;
+}
+
 // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 void Model::loadModel(string const &path)
 {
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
-        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        LOG(LOG_ERROR) << "ERROR::ASSIMP:: " << importer.GetErrorString();
         return;
     }
     // retrieve the directory path of the filepath
     directory = path.substr(0, path.find_last_of('/'));
 
     // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, -1);
 }
 
 // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode *node, const aiScene *scene)
+void Model::processNode(aiNode *node, const aiScene *scene, int parent)
 {
+    // keep the node and its transform, assimp matrices are row-major while glm ones are column-major
+    ModelNode modelNode;
+    modelNode.name = node->mName.C_Str();
+    const aiMatrix4x4 &m = node->mTransformation;
+    modelNode.transform = glm::mat4(
+        m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4);
+    modelNode.parent = parent;
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        modelNode.meshes.push_back(meshes.size());
         meshes.push_back(processMesh(mesh, scene));
+        meshes.back().SetOwner(directory + '/' + mesh->mName.C_Str());
     }
+    int index = nodes.size();
+    nodes.push_back(modelNode);
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, index);
     }
 
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+// converts vertex i of the assimp mesh
+static void convertVertex(const aiMesh *mesh, unsigned int i, Vertex &vertex)
 {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-
-    // Walk through each of the mesh's vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+    // positions
+    vector.x = mesh->mVertices[i].x;
+    vector.y = mesh->mVertices[i].y;
+    vector.z = mesh->mVertices[i].z;
+    vertex.Position = vector;
+    // normals, only points and lines have none after aiProcess_GenSmoothNormals
+    if (mesh->mNormals)
     {
-        Vertex vertex;
-        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        // normals
         vector.x = mesh->mNormals[i].x;
         vector.y = mesh->mNormals[i].y;
         vector.z = mesh->mNormals[i].z;
         vertex.Normal = vector;
-        // texture coordinates
-        if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-        {
-            glm::vec2 vec;
-            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-        }
-        else
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-        // tangent
+    }
+    else
+        vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+    // texture coordinates
+    if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+    {
+        glm::vec2 vec;
+        // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+        // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+        vec.x = mesh->mTextureCoords[0][i].x;
+        vec.y = mesh->mTextureCoords[0][i].y;
+        vertex.TexCoords = vec;
+    }
+    else
+        vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+    // tangent and bitangent if the file has them, GenerateTangents fills them in otherwise
+    if (mesh->mTangents && mesh->mBitangents)
+    {
         vector.x = mesh->mTangents[i].x;
         vector.y = mesh->mTangents[i].y;
         vector.z = mesh->mTangents[i].z;
         vertex.Tangent = vector;
-        // bitangent
         vector.x = mesh->mBitangents[i].x;
         vector.y = mesh->mBitangents[i].y;
         vector.z = mesh->mBitangents[i].z;
         vertex.Bitangent = vector;
-        vertices.push_back(vertex);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    else
     {
-        aiFace face = mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        vertex.Tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+        vertex.Bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
     }
+}
+
+// the importer's arrays as they are for GenerateTangents, missing normals and texture coordinates read as zeros
+static TangentSource tangentSource(const aiMesh *mesh)
+{
+    static_assert(sizeof(aiVector3D) == sizeof(glm::vec3), "aiVector3D is read as glm::vec3");
+    static const glm::vec3 zero(0.f);
+    TangentSource source;
+    source.vertexCount = mesh->mNumVertices;
+    source.positions = mesh->mVertices;
+    source.positionStride = sizeof(aiVector3D);
+    source.normals = mesh->mNormals ? (const void *)mesh->mNormals : &zero;
+    source.normalStride = mesh->mNormals ? sizeof(aiVector3D) : 0;
+    // x and y of the first texture coordinate set
+    source.texCoords = mesh->mTextureCoords[0] ? (const void *)mesh->mTextureCoords[0] : &zero;
+    source.texCoordStride = mesh->mTextureCoords[0] ? sizeof(aiVector3D) : 0;
+    return source;
+}
+
+Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+{
+    // data to fill
+    vector<Texture> textures;
+
     // process materials
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
     // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -126,8 +211,47 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
     std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    // walk through each of the mesh's faces (a face is a mesh its triangle) to retrieve the corresponding vertex indices
+    unsigned int indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+    std::function<void(unsigned int *)> writeIndices = [mesh](unsigned int *indices) {
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+                *indices++ = mesh->mFaces[i].mIndices[j];
+    };
+    std::function<void(unsigned int, Vertex &)> vertex = [mesh](unsigned int i, Vertex &target) { convertVertex(mesh, i, target); };
+    bool hasTangents = mesh->mTangents && mesh->mBitangents;
+    // points and lines of a mixed mesh would be read as triangles
+    bool isTriangleMesh = (mesh->mPrimitiveTypes & ~aiPrimitiveType_TRIANGLE) == 0;
+    if (!isCpuOnly && (hasTangents || !isTriangleMesh))
+        return Mesh(mesh->mNumVertices, vertex, indexCount, writeIndices, textures, isCpuDataKept);
+
+    vector<unsigned int> indices(indexCount);
+    if (indexCount)
+        writeIndices(&indices[0]);
+    if (!isCpuOnly) {
+        // the tangents go to side arrays, the vertices are still written straight into the mapped buffer
+        vector<glm::vec3> tangents, bitangents;
+        GenerateTangents(tangentSource(mesh), indices, tangents, bitangents, pool);
+        std::function<void(unsigned int, Vertex &)> vertexWithTangents = [mesh, &tangents, &bitangents](unsigned int i, Vertex &target) {
+            convertVertex(mesh, i, target);
+            target.Tangent = tangents[i];
+            target.Bitangent = bitangents[i];
+        };
+        std::function<void(unsigned int *)> copyIndices = [&indices](unsigned int *target) {
+            memcpy(target, indices.data(), indices.size() * sizeof(unsigned int));
+        };
+        return Mesh(mesh->mNumVertices, vertexWithTangents, indexCount, copyIndices, textures, isCpuDataKept);
+    }
+
+    // the software renderer reads the vectors, and the tangents are generated on them
+    vector<Vertex> vertices(mesh->mNumVertices);
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        vertex(i, vertices[i]);
+    if (!hasTangents && isTriangleMesh)
+        GenerateTangents(vertices, indices, pool);
+    return Mesh(std::move(vertices), std::move(indices), textures, true, true);
 }
 
 // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -153,7 +277,13 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
         if (!skip)
         {   // if texture hasn't been loaded already, load it
             Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
+            // the software renderer loads its own copy through the path
+            if (isCpuOnly)
+                texture.id = 0;
+            else if (textureStreamer)
+                texture.id = textureStreamer->Load(this->directory + '/' + str.C_Str());
+            else
+                texture.id = TextureFromFile(str.C_Str(), this->directory);
             texture.type = typeName;
             texture.path = str.C_Str();
             textures.push_back(texture);
@@ -193,11 +323,13 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         SOIL_free_image_data(data);
+        GpuResourceRegistry::Get().Add(GPU_TEXTURE, textureID, GpuResourceRegistry::TextureBytes(width, height, 1, nrComponents, true), filename);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG(LOG_ERROR) << "Texture failed to load at path: " << path;
         SOIL_free_image_data(data);
+        GpuResourceRegistry::Get().Add(GPU_TEXTURE, textureID, 0, filename);
     }
 
     return textureID;
@@ -210,6 +342,7 @@ unsigned int loadCubemap(vector<std::string> &faces, const string &directory, bo
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
+    size_t bytes = 0;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
         unsigned char *data = SOIL_load_image((directory + "/" +faces[i]).c_str(), &width, &height, &nrChannels, 0);
@@ -227,10 +360,11 @@ unsigned int loadCubemap(vector<std::string> &faces, const string &directory, bo
                 0, format, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
             );
             SOIL_free_image_data(data);
+            bytes += GpuResourceRegistry::TextureBytes(width, height, 1, nrChannels, false);
         }
         else
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+            LOG(LOG_ERROR) << "Cubemap texture failed to load at path: " << faces[i];
             SOIL_free_image_data(data);
         }
     }
@@ -239,6 +373,7 @@ unsigned int loadCubemap(vector<std::string> &faces, const string &directory, bo
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, textureID, bytes, directory);
 
     return textureID;
 }
\ No newline at end of file
@@ -6,13 +6,17 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <soil.h>
+#include <SOIL.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "DrawConstants.h"
 #include "Shader.h"
+#include "SceneGraph.h"
+#include "TextureStreaming.h"
+#include "ThreadPool.h"
 
 #include <string>
 #include <fstream>
@@ -23,24 +27,52 @@
 
 using namespace std;
 
+// tangents are generated by GenerateTangents after the import, it is faster than aiProcess_CalcTangentSpace
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals;
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 unsigned int loadCubemap(vector<std::string> &faces, const string &directory, bool gamma = false);
 
+// A node of the model file's hierarchy, its meshes are drawn with the node's accumulated transform
+struct ModelNode {
+    string name;
+    glm::mat4 transform; // relative to the parent node
+    int parent;          // index in Model::nodes, -1 for the root; always smaller than the node's own index
+    vector<unsigned int> meshes;
+};
+
 class Model
 {
 public:
     /*  Model Data */
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh> meshes;
+    vector<ModelNode> nodes;
     string directory;
     bool gammaCorrection;
+    bool isCpuOnly; // meshes without GL objects and textures that are not loaded, for the software renderer
+    bool isCpuDataKept; // GL meshes keep their vertices and indices in RAM too, for CPU work like occlusion culling
+    TextureStreamer *textureStreamer; // loads the textures when set, TextureFromFile otherwise
+    ThreadPool *pool; // generates the tangents of big meshes when set, only while loading
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false);
+    Model(string const &path, bool gamma = false, bool isCpuOnly = false, TextureStreamer *textureStreamer = nullptr, bool isCpuDataKept = false,
+          ThreadPool *pool = nullptr);
+    // deletes the textures loaded with TextureFromFile, streamed ones belong to the streamer
+    ~Model();
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
 
     // draws the model, and thus all its meshes
     void Draw(Shader shader);
+    // draws each node's meshes with the node's world matrix from the graph and the material in DrawConstants
+    void Draw(Shader shader, const SceneGraph &graph, const vector<NodeId> &graphNodes, DrawConstantRing &constants, int material);
+    // same with positions only, for depth-only passes
+    void DrawDepth(const SceneGraph &graph, const vector<NodeId> &graphNodes, DrawConstantRing &constants);
+
+    // adds the node hierarchy under parent, returns the graph node of every model node (same order as nodes)
+    vector<NodeId> AddToSceneGraph(SceneGraph &graph, NodeId parent) const;
 
 private:
     /*  Functions   */
@@ -48,8 +80,10 @@ private:
     void loadModel(string const &path);
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene);
+    void processNode(aiNode *node, const aiScene *scene, int parent);
 
+    // GL meshes are converted straight into mapped buffers, tangents missing from the file are generated into
+    // side arrays first; CPU-only meshes go through vectors and GenerateTangents
     Mesh processMesh(aiMesh *mesh, const aiScene *scene);
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -0,0 +1,140 @@
+#include "MultiView.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Log.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// LOG takes it by reference
+const unsigned int MultiViewTarget::MAX_VIEWS;
+
+MultiViewTarget::MultiViewTarget()
+    : FBO(0), readFBO(0), colorTexture(0), depthTexture(0), width(0), height(0), viewCount(0),
+      locationProgram(0), viewProjectionsLocation(-1), viewPositionsLocation(-1), viewCountLocation(-1)
+{
+}
+
+void MultiViewTarget::Resize(unsigned int width, unsigned int height, unsigned int viewCount)
+{
+    if (viewCount > MAX_VIEWS) {
+        LOG(LOG_ERROR) << "ERROR::MULTI_VIEW::RESIZE:: " << viewCount << " views requested, drawing the first " << MAX_VIEWS;
+        viewCount = MAX_VIEWS;
+    }
+    if (FBO && width == this->width && height == this->height && viewCount == this->viewCount)
+        return;
+    Clear();
+    this->width = width;
+    this->height = height;
+    this->viewCount = viewCount;
+
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, colorTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, viewCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, width, height, viewCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, colorTexture, GpuResourceRegistry::TextureBytes(width, height, viewCount, 4, false), "multi-view target");
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, depthTexture, GpuResourceRegistry::TextureBytes(width, height, viewCount, 4, false), "multi-view target");
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    // layered attachments, gl_Layer in the geometry shader picks the view
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG(LOG_ERROR) << "ERROR::MULTI_VIEW::FRAMEBUFFER:: Layered framebuffer is not complete!";
+    // blits read a single layer, attached in Present()
+    glGenFramebuffers(1, &readFBO);
+    GpuResourceRegistry::Get().Add(GPU_FRAMEBUFFER, FBO, 0, "multi-view target");
+    GpuResourceRegistry::Get().Add(GPU_FRAMEBUFFER, readFBO, 0, "multi-view target");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void MultiViewTarget::Begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    // clears all layers of a layered framebuffer
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void MultiViewTarget::SetViews(Shader &shader, const vector<View> &views)
+{
+    // the names don't change, look the locations up again only for another program
+    if (shader.ID != locationProgram) {
+        locationProgram = shader.ID;
+        viewProjectionsLocation = glGetUniformLocation(shader.ID, "viewProjections");
+        viewPositionsLocation = glGetUniformLocation(shader.ID, "viewPositions");
+        viewCountLocation = glGetUniformLocation(shader.ID, "viewCount");
+    }
+    unsigned int count = views.size() < viewCount ? views.size() : viewCount;
+    glm::mat4 viewProjections[MAX_VIEWS];
+    glm::vec3 viewPositions[MAX_VIEWS];
+    for (unsigned int i = 0; i < count; i++)
+    {
+        viewProjections[i] = views[i].projection * views[i].view;
+        viewPositions[i] = views[i].position;
+    }
+    // whole arrays in one call each
+    if (count) {
+        glUniformMatrix4fv(viewProjectionsLocation, count, GL_FALSE, glm::value_ptr(viewProjections[0]));
+        glUniform3fv(viewPositionsLocation, count, glm::value_ptr(viewPositions[0]));
+    }
+    glUniform1i(viewCountLocation, count);
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS, count ? 3 : 1);
+}
+
+void MultiViewTarget::Present(unsigned int outputWidth, unsigned int outputHeight) const
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    for (unsigned int i = 0; i < viewCount; i++)
+    {
+        // edges at i * outputWidth / viewCount, so the columns cover the whole width whatever it is
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, i);
+        glBlitFramebuffer(0, 0, width, height, i * outputWidth / viewCount, 0, (i + 1) * outputWidth / viewCount, outputHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void MultiViewTarget::Clear()
+{
+    GpuResourceRegistry::Get().Remove(GPU_FRAMEBUFFER, FBO);
+    GpuResourceRegistry::Get().Remove(GPU_FRAMEBUFFER, readFBO);
+    GpuResourceRegistry::Get().Remove(GPU_TEXTURE, colorTexture);
+    GpuResourceRegistry::Get().Remove(GPU_TEXTURE, depthTexture);
+    if (FBO)
+        glDeleteFramebuffers(1, &FBO);
+    if (readFBO)
+        glDeleteFramebuffers(1, &readFBO);
+    if (colorTexture)
+        glDeleteTextures(1, &colorTexture);
+    if (depthTexture)
+        glDeleteTextures(1, &depthTexture);
+    FBO = readFBO = colorTexture = depthTexture = 0;
+    width = height = viewCount = 0;
+}
+
+void MultiViewTarget::AddStereoViews(vector<View> &views, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up,
+                                     const glm::mat4 &projection, float eyeSeparation)
+{
+    glm::vec3 right = glm::normalize(glm::cross(front, up));
+    for (int eye = -1; eye <= 1; eye += 2)
+    {
+        View view;
+        view.position = position + right * (eye * eyeSeparation * 0.5f);
+        // parallel eyes, the eyes converge at infinity
+        view.view = glm::lookAt(view.position, view.position + front, up);
+        view.projection = projection;
+        views.push_back(view);
+    }
+}
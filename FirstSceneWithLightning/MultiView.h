@@ -0,0 +1,54 @@
+#pragma once
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+#include <vector>
+using namespace std;
+
+// A camera of a multi-view frame
+struct View {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 position;
+};
+
+// Several views of the scene drawn in a single pass into the layers of an array framebuffer. The geometry shader
+// of the multi-view program (Shaders/MultiView) sends every triangle to each layer with that view's matrix, the way
+// PointShadowMap draws its 6 faces, so an object is culled, bound and drawn once no matter how many views there are.
+// Present() copies the layers side by side to the screen.
+class MultiViewTarget
+{
+public:
+    static const unsigned int MAX_VIEWS = 4; // size of the view arrays in the multi-view shaders
+
+    MultiViewTarget();
+
+    // (re)creates the layers when the view size or count changes
+    void Resize(unsigned int width, unsigned int height, unsigned int viewCount);
+    // binds the layered framebuffer, sets the viewport and clears every layer
+    void Begin();
+    // sets viewProjections, viewPositions and viewCount, the shader has to be in use
+    void SetViews(Shader &shader, const vector<View> &views);
+    // copies the layers into the default framebuffer side by side, the columns split the output width evenly
+    void Present(unsigned int outputWidth, unsigned int outputHeight) const;
+    // deletes the framebuffers and textures, has to be called while the GL context is still alive
+    void Clear();
+
+    // left and right eye of a camera, eyeSeparation apart along its right vector
+    static void AddStereoViews(vector<View> &views, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up,
+                               const glm::mat4 &projection, float eyeSeparation);
+
+private:
+    unsigned int FBO, readFBO;
+    unsigned int colorTexture, depthTexture; // GL_TEXTURE_2D_ARRAYs, one layer per view
+    unsigned int width, height, viewCount;
+    // uniform locations in the last program SetViews was called with
+    unsigned int locationProgram;
+    GLint viewProjectionsLocation, viewPositionsLocation, viewCountLocation;
+};
+#endif
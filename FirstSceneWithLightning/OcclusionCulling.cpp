@@ -0,0 +1,270 @@
+#include "OcclusionCulling.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+OcclusionCuller::OcclusionCuller(ThreadPool &pool, unsigned int width, unsigned int height)
+    : pool(pool), width((width + 3) & ~3u), height(height), viewProjection(1.f),
+      testedCount(0), occludedCount(0), outsideCount(0)
+{
+    unsigned int levelWidth = this->width, levelHeight = this->height;
+    while (true)
+    {
+        levels.push_back(vector<float>(levelWidth * levelHeight, 1.f));
+        levelWidths.push_back(levelWidth);
+        levelHeights.push_back(levelHeight);
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = max(1u, (levelWidth + 1) / 2);
+        levelHeight = max(1u, (levelHeight + 1) / 2);
+    }
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4 &viewProjection)
+{
+    this->viewProjection = viewProjection;
+    triangles.clear();
+    testedCount = occludedCount = outsideCount = 0;
+}
+
+void OcclusionCuller::AddOccluder(const glm::mat4 &model, const vector<Vertex> &vertices, const vector<unsigned int> &indices)
+{
+    glm::mat4 transform = viewProjection * model;
+    vector<glm::vec4> clip(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        clip[i] = transform * glm::vec4(vertices[i].Position, 1.f);
+    if (indices.empty()) {
+        for (unsigned int i = 0; i + 2 < clip.size(); i += 3)
+            addClipTriangle(clip[i], clip[i + 1], clip[i + 2]);
+    } else {
+        for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+            addClipTriangle(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]);
+    }
+}
+
+void OcclusionCuller::Rasterize()
+{
+    unsigned int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    pool.ParallelFor(bandCount, 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int band = begin; band < end; band++)
+            rasterizeBand(band);
+    });
+    buildPyramid();
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+    testedCount++;
+    glm::vec4 corners[8];
+    unsigned int behindCount = 0, nearCount = 0;
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        corners[i] = viewProjection * glm::vec4(corner, 1.f);
+        behindCount += corners[i].w <= 0.f;
+        nearCount += corners[i].z < -corners[i].w;
+    }
+    if (behindCount == 8) {
+        outsideCount++;
+        return false;
+    }
+    // the box reaches past the near plane towards the camera, it is always drawn
+    if (nearCount > 0)
+        return true;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        const glm::vec4 &clip = corners[i];
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+        minZ = min(minZ, clip.z / clip.w);
+    }
+    if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height || minZ > 1.f) {
+        outsideCount++;
+        return false;
+    }
+    int x0 = max(0, (int)minX), x1 = min((int)width - 1, (int)maxX);
+    int y0 = max(0, (int)minY), y1 = min((int)height - 1, (int)maxY);
+    // smallest level where the box covers at most 2x2 texels
+    unsigned int level = 0;
+    while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+    const vector<float> &depths = levels[level];
+    unsigned int levelWidth = levelWidths[level];
+    for (int y = y0 >> level; y <= (y1 >> level); y++)
+        for (int x = x0 >> level; x <= (x1 >> level); x++)
+            if (minZ <= depths[y * levelWidth + x])
+                return true;
+    occludedCount++;
+    return false;
+}
+
+unsigned int OcclusionCuller::GetOccluderTriangleCount() const
+{
+    return triangles.size();
+}
+
+unsigned int OcclusionCuller::GetTestedCount() const
+{
+    return testedCount;
+}
+
+unsigned int OcclusionCuller::GetOccludedCount() const
+{
+    return occludedCount;
+}
+
+unsigned int OcclusionCuller::GetOutsideCount() const
+{
+    return outsideCount;
+}
+
+void OcclusionCuller::addClipTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+{
+    // clipping against the near plane (z = -w) only, the rest of the frustum is handled by the screen bounds
+    const glm::vec4 *input[3] = { &a, &b, &c };
+    glm::vec4 polygon[4];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &current = *input[i];
+        const glm::vec4 &next = *input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.f)
+            polygon[count++] = current;
+        if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+            polygon[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+    }
+    for (unsigned int i = 2; i < count; i++)
+        addScreenTriangle(polygon[0], polygon[i - 1], polygon[i]);
+}
+
+void OcclusionCuller::addScreenTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+{
+    const glm::vec4 *corners[3] = { &a, &b, &c };
+    ScreenTriangle triangle;
+    float minY = 1e30f, maxY = -1e30f;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &corner = *corners[i];
+        triangle.x[i] = (corner.x / corner.w * 0.5f + 0.5f) * width;
+        triangle.y[i] = (corner.y / corner.w * 0.5f + 0.5f) * height;
+        triangle.z[i] = corner.z / corner.w;
+        minY = min(minY, triangle.y[i]);
+        maxY = max(maxY, triangle.y[i]);
+    }
+    if (maxY < 0.f || minY >= height)
+        return;
+    triangle.minRow = max(0, (int)std::floor(minY));
+    triangle.maxRow = min((int)height - 1, (int)std::ceil(maxY));
+    triangles.push_back(triangle);
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int band)
+{
+    int rowBegin = band * BAND_HEIGHT;
+    int rowEnd = min((int)height, rowBegin + (int)BAND_HEIGHT);
+    float *depth = &levels[0][0];
+    std::fill(depth + rowBegin * width, depth + rowEnd * width, 1.f);
+
+    for (unsigned int t = 0; t < triangles.size(); t++)
+    {
+        const ScreenTriangle &triangle = triangles[t];
+        if (triangle.maxRow < rowBegin || triangle.minRow >= rowEnd)
+            continue;
+        float x0 = triangle.x[0], y0 = triangle.y[0], z0 = triangle.z[0];
+        float x1 = triangle.x[1], y1 = triangle.y[1], z1 = triangle.z[1];
+        float x2 = triangle.x[2], y2 = triangle.y[2], z2 = triangle.z[2];
+        float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+        if (std::fabs(area) < 1e-6f)
+            continue;
+        // occluders count from both sides, turn clockwise triangles around
+        if (area < 0.f) {
+            std::swap(x1, x2);
+            std::swap(y1, y2);
+            std::swap(z1, z2);
+            area = -area;
+        }
+        // edge functions (b - a) x (p - a) of the edges opposite to each vertex, all >= 0 inside
+        float edgeX[3] = { x1, x2, x0 }, edgeY[3] = { y1, y2, y0 };
+        float stepX[3] = { -(y2 - y1), -(y0 - y2), -(y1 - y0) };
+        float stepY[3] = { x2 - x1, x0 - x2, x1 - x0 };
+        float depthStepX = ((z1 - z0) * (y2 - y0) - (z2 - z0) * (y1 - y0)) / area;
+        float depthStepY = ((z2 - z0) * (x1 - x0) - (z1 - z0) * (x2 - x0)) / area;
+
+        int columnBegin = max(0, (int)std::floor(min(x0, min(x1, x2)))) & ~3;
+        int columnEnd = min((int)width - 1, (int)std::ceil(max(x0, max(x1, x2))));
+        int triangleRowBegin = max(rowBegin, triangle.minRow);
+        int triangleRowEnd = min(rowEnd - 1, triangle.maxRow);
+        for (int row = triangleRowBegin; row <= triangleRowEnd; row++)
+        {
+            float py = row + 0.5f;
+            float px = columnBegin + 0.5f;
+            float edge[3];
+            for (unsigned int e = 0; e < 3; e++)
+                edge[e] = stepY[e] * (py - edgeY[e]) + stepX[e] * (px - edgeX[e]);
+            float rowDepth = z0 + depthStepX * (px - x0) + depthStepY * (py - y0);
+            float *rowPixels = depth + row * width;
+#if USE_SSE
+            const __m128 lanes = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edge0 = _mm_add_ps(_mm_set1_ps(edge[0]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[0])));
+            __m128 edge1 = _mm_add_ps(_mm_set1_ps(edge[1]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[1])));
+            __m128 edge2 = _mm_add_ps(_mm_set1_ps(edge[2]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[2])));
+            __m128 pixelDepth = _mm_add_ps(_mm_set1_ps(rowDepth), _mm_mul_ps(lanes, _mm_set1_ps(depthStepX)));
+            const __m128 edgeStep0 = _mm_set1_ps(stepX[0] * 4.f);
+            const __m128 edgeStep1 = _mm_set1_ps(stepX[1] * 4.f);
+            const __m128 edgeStep2 = _mm_set1_ps(stepX[2] * 4.f);
+            const __m128 depthStep = _mm_set1_ps(depthStepX * 4.f);
+            for (int x = columnBegin; x <= columnEnd; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 old = _mm_loadu_ps(rowPixels + x);
+                    __m128 nearest = _mm_min_ps(old, pixelDepth);
+                    _mm_storeu_ps(rowPixels + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+                edge0 = _mm_add_ps(edge0, edgeStep0);
+                edge1 = _mm_add_ps(edge1, edgeStep1);
+                edge2 = _mm_add_ps(edge2, edgeStep2);
+                pixelDepth = _mm_add_ps(pixelDepth, depthStep);
+            }
+#else
+            for (int x = columnBegin; x <= columnEnd; x++)
+            {
+                if (edge[0] >= 0.f && edge[1] >= 0.f && edge[2] >= 0.f)
+                    rowPixels[x] = min(rowPixels[x], rowDepth);
+                for (unsigned int e = 0; e < 3; e++)
+                    edge[e] += stepX[e];
+                rowDepth += depthStepX;
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (unsigned int level = 1; level < levels.size(); level++)
+    {
+        const vector<float> &source = levels[level - 1];
+        vector<float> &target = levels[level];
+        unsigned int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+        for (unsigned int y = 0; y < levelHeights[level]; y++)
+        {
+            unsigned int sy0 = y * 2, sy1 = min(y * 2 + 1, sourceHeight - 1);
+            for (unsigned int x = 0; x < levelWidths[level]; x++)
+            {
+                unsigned int sx0 = x * 2, sx1 = min(x * 2 + 1, sourceWidth - 1);
+                target[y * levelWidths[level] + x] = max(max(source[sy0 * sourceWidth + sx0], source[sy0 * sourceWidth + sx1]),
+                                                         max(source[sy1 * sourceWidth + sx0], source[sy1 * sourceWidth + sx1]));
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <vector>
+using namespace std;
+
+// Software occlusion culling, entirely on the CPU so it saves draw calls even on a software GL.
+// A few big occluders are rasterized into a small depth buffer: every worker thread fills a band of rows,
+// 4 pixels at a time with SSE. A pyramid of the farthest depths is built over it, and a bounding box is hidden
+// when its nearest point is behind every texel it covers on the level where it covers at most 2x2 texels.
+// Depths are NDC z, -1 at the near plane and 1 at the far one.
+class OcclusionCuller
+{
+public:
+    // width is rounded up to a multiple of 4
+    OcclusionCuller(ThreadPool &pool, unsigned int width = 256, unsigned int height = 128);
+
+    // forgets the occluders and the counters of the previous frame
+    void BeginFrame(const glm::mat4 &viewProjection);
+    // triangles of a mesh (consecutive vertices if there are no indices) placed with the model matrix
+    void AddOccluder(const glm::mat4 &model, const vector<Vertex> &vertices, const vector<unsigned int> &indices);
+    // draws the occluders and builds the pyramid, call between the last AddOccluder and the first IsVisible
+    void Rasterize();
+    // false if the world-space box is outside the view or hidden behind the occluders
+    bool IsVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+    unsigned int GetOccluderTriangleCount() const;
+    unsigned int GetTestedCount() const;
+    unsigned int GetOccludedCount() const;
+    unsigned int GetOutsideCount() const;
+
+private:
+    static const unsigned int BAND_HEIGHT = 8;
+
+    // screen-space triangle after near plane clipping, x and y in pixels
+    struct ScreenTriangle {
+        float x[3], y[3], z[3];
+        int minRow, maxRow;
+    };
+
+    ThreadPool &pool;
+    unsigned int width, height;
+    glm::mat4 viewProjection;
+    vector<ScreenTriangle> triangles;
+    // level 0 is the depth buffer, every next level holds the farthest depth of 2x2 texels of the previous one
+    vector<vector<float> > levels;
+    vector<unsigned int> levelWidths, levelHeights;
+
+    unsigned int testedCount;
+    unsigned int occludedCount;
+    unsigned int outsideCount;
+
+    void addClipTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    void addScreenTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    void rasterizeBand(unsigned int band);
+    void buildPyramid();
+};
+#endif
@@ -0,0 +1,79 @@
+#include "PassStatistics.h"
+
+unsigned int PassStatistics::AddPass(const string &name)
+{
+    PassQueries pass;
+    pass.name = name;
+    glGenQueries(QUERY_RING, pass.queries);
+    for (unsigned int i = 0; i < QUERY_RING; i++)
+        pass.isPending[i] = false;
+    pass.writeIndex = 0;
+    pass.readIndex = 0;
+    pass.samples = 0;
+    passes.push_back(pass);
+    return passes.size() - 1;
+}
+
+void PassStatistics::Begin(unsigned int pass)
+{
+    PassQueries &queries = passes[pass];
+    // every query of the ring is still in flight, skip this measurement rather than wait for the GPU
+    if (runningPass >= 0 || queries.isPending[queries.writeIndex])
+        return;
+    glBeginQuery(GL_SAMPLES_PASSED, queries.queries[queries.writeIndex]);
+    runningPass = pass;
+}
+
+void PassStatistics::End()
+{
+    if (runningPass < 0)
+        return;
+    PassQueries &queries = passes[runningPass];
+    glEndQuery(GL_SAMPLES_PASSED);
+    queries.isPending[queries.writeIndex] = true;
+    queries.writeIndex = (queries.writeIndex + 1) % QUERY_RING;
+    runningPass = -1;
+}
+
+void PassStatistics::Poll()
+{
+    for (unsigned int i = 0; i < passes.size(); i++)
+    {
+        PassQueries &queries = passes[i];
+        while (queries.isPending[queries.readIndex])
+        {
+            GLint isAvailable = 0;
+            glGetQueryObjectiv(queries.queries[queries.readIndex], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+            if (!isAvailable)
+                break;
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(queries.queries[queries.readIndex], GL_QUERY_RESULT, &samples);
+            queries.samples = samples;
+            queries.isPending[queries.readIndex] = false;
+            queries.readIndex = (queries.readIndex + 1) % QUERY_RING;
+        }
+    }
+}
+
+unsigned int PassStatistics::GetPassCount() const
+{
+    return passes.size();
+}
+
+const string &PassStatistics::GetName(unsigned int pass) const
+{
+    return passes[pass].name;
+}
+
+unsigned long long PassStatistics::GetSamples(unsigned int pass) const
+{
+    return passes[pass].samples;
+}
+
+void PassStatistics::Clear()
+{
+    for (unsigned int i = 0; i < passes.size(); i++)
+        glDeleteQueries(QUERY_RING, passes[i].queries);
+    passes.clear();
+    runningPass = -1;
+}
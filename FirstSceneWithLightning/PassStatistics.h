@@ -0,0 +1,45 @@
+#pragma once
+#ifndef PASS_STATISTICS_H
+#define PASS_STATISTICS_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Counts the samples that pass the depth test in each render pass (GL_SAMPLES_PASSED), that is how many
+// fragments the pass really shaded. Results are read a few frames late without stalling, like GpuFrameTimer.
+class PassStatistics
+{
+public:
+    // returns the id to give to Begin()
+    unsigned int AddPass(const string &name);
+    // one pass at a time, a pass begun twice in a frame only counts the first time
+    void Begin(unsigned int pass);
+    void End();
+    // picks up the results that are ready
+    void Poll();
+
+    unsigned int GetPassCount() const;
+    const string &GetName(unsigned int pass) const;
+    // samples of the newest finished measurement
+    unsigned long long GetSamples(unsigned int pass) const;
+    // deletes the queries, has to be called while the GL context is still alive
+    void Clear();
+
+private:
+    static const unsigned int QUERY_RING = 4;
+
+    struct PassQueries {
+        string name;
+        unsigned int queries[QUERY_RING];
+        bool isPending[QUERY_RING];
+        unsigned int writeIndex;
+        unsigned int readIndex;
+        unsigned long long samples;
+    };
+    vector<PassQueries> passes;
+    int runningPass = -1;
+};
+#endif
@@ -0,0 +1,294 @@
+#include "PostProcessing.h"
+#include "Log.h"
+#include "GlStats.h"
+
+#include <cmath>
+
+PostProcessChain::PostProcessChain(RenderTargetPool &pool, unsigned int quadVAO)
+    : pool(pool), quadVAO(quadVAO), outputWidth(0), outputHeight(0), useCompute(false)
+{
+}
+
+void PostProcessChain::AddEffect(const string &name, const vector<PostPass> &passes, bool enabled)
+{
+    PostEffect effect;
+    effect.name = name;
+    effect.passes = passes;
+    effect.enabled = enabled;
+    effects.push_back(effect);
+}
+
+void PostProcessChain::AddFusion(const vector<string> &effectNames, const PostPass &pass)
+{
+    PostFusion fusion;
+    fusion.effects = effectNames;
+    fusion.pass = pass;
+    fusions.push_back(fusion);
+}
+
+void PostProcessChain::SetComputePasses(const string &name, const vector<PostPass> &passes)
+{
+    int index = findEffect(name);
+    if (index >= 0)
+        effects[index].computePasses = passes;
+}
+
+void PostProcessChain::SetUpscalePass(const PostPass &pass)
+{
+    upscalePass = pass;
+}
+
+void PostProcessChain::SetUseCompute(bool useCompute)
+{
+    this->useCompute = useCompute;
+}
+
+bool PostProcessChain::IsUsingCompute() const
+{
+    return useCompute;
+}
+
+void PostProcessChain::SetEnabled(const string &name, bool enabled)
+{
+    int index = findEffect(name);
+    if (index >= 0)
+        effects[index].enabled = enabled;
+}
+
+bool PostProcessChain::IsEnabled(const string &name) const
+{
+    int index = findEffect(name);
+    return index >= 0 && effects[index].enabled;
+}
+
+bool PostProcessChain::IsActive() const
+{
+    for (unsigned int i = 0; i < effects.size(); i++)
+        if (effects[i].enabled)
+            return true;
+    return false;
+}
+
+bool PostProcessChain::NeedsSceneTarget(unsigned int width, unsigned int height, unsigned int outputWidth, unsigned int outputHeight) const
+{
+    bool isScaled = width != outputWidth || height != outputHeight;
+    return IsActive() || (isScaled && upscalePass.shader);
+}
+
+void PostProcessChain::AddPasses(RenderGraph &graph, RenderResource scene, unsigned int width, unsigned int height, RenderResource output,
+                                 unsigned int outputWidth, unsigned int outputHeight)
+{
+    this->outputWidth = outputWidth;
+    this->outputHeight = outputHeight;
+    vector<PostPass> passes = collectPasses();
+    if (passes.empty())
+        passes.push_back(upscalePass);
+    RenderResource current = scene;
+    for (unsigned int i = 0; i < passes.size(); i++)
+    {
+        const PostPass &pass = passes[i];
+        // the graph gives a transient the target of the one released two passes ago, so they ping-pong.
+        // compute passes can't store into the default framebuffer, the last one goes through a transient too
+        RenderResource destination = output;
+        if (i + 1 < passes.size() || pass.tileWidth > 0)
+            destination = graph.CreateTarget("post " + to_string(i), width, height, false);
+        graph.AddPass("post effect " + to_string(i), { current }, { destination }, [this, &graph, pass, current, destination]() {
+            runPass(pass, graph.GetTarget(current), graph.GetTarget(destination));
+        });
+        current = destination;
+    }
+    if (current != output) {
+        graph.AddPass("post blit", { current }, { output }, [this, &graph, current]() {
+            blitToScreen(graph.GetTarget(current));
+        });
+    }
+}
+
+void PostProcessChain::Benchmark(unsigned int width, unsigned int height, int frames)
+{
+    bool wasUsingCompute = useCompute;
+    RenderTarget *source = pool.Acquire(width, height, true);
+    RenderTarget *output = pool.Acquire(width, height, false);
+    // the content doesn't matter for timing, but give the passes something defined to read
+    glBindFramebuffer(GL_FRAMEBUFFER, source->FBO);
+    glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    unsigned int query;
+    glGenQueries(1, &query);
+    for (int mode = 0; mode < 2; mode++)
+    {
+        useCompute = mode == 1;
+        if (useCompute && !isComputeSupported())
+            break;
+        vector<PostPass> passes = collectPasses();
+        // warm up so shader compilation and target allocation don't end up in the measurement
+        run(passes, source, output);
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int i = 0; i < frames; i++)
+            run(passes, source, output);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 elapsed;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        LOG(LOG_INFO) << "PostEffect benchmark " << width << "x" << height << " "
+            << (useCompute ? "compute" : "fragment") << ": "
+            << passes.size() << " passes, " << elapsed / 1e6 / frames << " ms/frame";
+    }
+    glDeleteQueries(1, &query);
+    pool.Release(source);
+    pool.Release(output);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    useCompute = wasUsingCompute;
+}
+
+void PostProcessChain::run(const vector<PostPass> &passes, RenderTarget *source, RenderTarget *output)
+{
+    RenderTarget *current = source;
+    for (unsigned int i = 0; i < passes.size(); i++)
+    {
+        bool isCompute = passes[i].tileWidth > 0;
+        bool isLast = i + 1 == passes.size();
+        // ping-pong: the pool hands back the target released two passes ago.
+        // compute passes can't store into the default framebuffer, the last one goes through a temporary target
+        RenderTarget *destination = output;
+        if (!isLast || (!output && isCompute))
+            destination = pool.Acquire(source->width, source->height, false);
+        runPass(passes[i], current, destination);
+        if (current != source)
+            pool.Release(current);
+        current = destination;
+    }
+    if (current != source && current != output)
+    {
+        blitToScreen(current);
+        pool.Release(current);
+    }
+}
+
+void PostProcessChain::runPass(const PostPass &pass, RenderTarget *source, RenderTarget *destination)
+{
+    unsigned int targetWidth = source->width, targetHeight = source->height;
+    glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+    glBindVertexArray(quadVAO);
+    glActiveTexture(GL_TEXTURE0);
+    pass.shader->Use();
+    pass.shader->setInt("screenTexture", 0);
+    if (pass.setup)
+        pass.setup(*pass.shader);
+    GlStats::BindTexture(GL_TEXTURE_2D, source->colorTexture);
+    if (pass.tileWidth > 0)
+    {
+        glBindImageTexture(0, destination->colorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        glDispatchCompute((targetWidth + pass.tileWidth - 1) / pass.tileWidth, (targetHeight + pass.tileHeight - 1) / pass.tileHeight, 1);
+        // make the stores visible to whoever reads the image next: another pass or the blit
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    }
+    else
+    {
+        // a pass drawing to the screen also does the upscale, the linear filter of the source stretches it
+        glBindFramebuffer(GL_FRAMEBUFFER, destination ? destination->FBO : 0);
+        if (destination)
+            glViewport(0, 0, targetWidth, targetHeight);
+        else
+            glViewport(0, 0, outputWidth, outputHeight);
+        GlStats::DrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, outputWidth, outputHeight);
+    glBindVertexArray(0);
+}
+
+void PostProcessChain::blitToScreen(RenderTarget *source)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source->FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, source->width, source->height, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT,
+        source->width == outputWidth && source->height == outputHeight ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+vector<PostPass> PostProcessChain::collectPasses() const
+{
+    vector<const PostEffect*> enabled;
+    for (unsigned int i = 0; i < effects.size(); i++)
+        if (effects[i].enabled)
+            enabled.push_back(&effects[i]);
+
+    vector<PostPass> passes;
+    unsigned int i = 0;
+    while (i < enabled.size())
+    {
+        if (useCompute && !enabled[i]->computePasses.empty())
+        {
+            passes.insert(passes.end(), enabled[i]->computePasses.begin(), enabled[i]->computePasses.end());
+            i++;
+            continue;
+        }
+        // look for a fusion that covers the run of effects starting here
+        const PostFusion *fused = nullptr;
+        for (unsigned int f = 0; f < fusions.size() && !fused; f++)
+        {
+            const vector<string> &names = fusions[f].effects;
+            if (i + names.size() > enabled.size())
+                continue;
+            bool matches = true;
+            for (unsigned int j = 0; j < names.size() && matches; j++)
+                matches = enabled[i + j]->name == names[j] && !(useCompute && !enabled[i + j]->computePasses.empty());
+            if (matches)
+                fused = &fusions[f];
+        }
+        if (fused)
+        {
+            passes.push_back(fused->pass);
+            i += fused->effects.size();
+        }
+        else
+        {
+            passes.insert(passes.end(), enabled[i]->passes.begin(), enabled[i]->passes.end());
+            i++;
+        }
+    }
+    return passes;
+}
+
+int PostProcessChain::findEffect(const string &name) const
+{
+    for (unsigned int i = 0; i < effects.size(); i++)
+        if (effects[i].name == name)
+            return i;
+    return -1;
+}
+
+bool isComputeSupported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store);
+}
+
+vector<float> getGaussianBlurWeights(int radius)
+{
+    // keep in sync with MAX_RADIUS in the blur shaders
+    const int maxRadius = 32;
+    if (radius > maxRadius)
+        radius = maxRadius;
+    if (radius < 0)
+        radius = 0;
+    float sigma = radius > 1 ? radius / 2.0f : 1.0f;
+    vector<float> weights(radius + 1);
+    float sum = 0.0f;
+    for (int i = 0; i <= radius; i++)
+    {
+        weights[i] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+        sum += i == 0 ? weights[i] : 2.0f * weights[i];
+    }
+    for (int i = 0; i <= radius; i++)
+        weights[i] /= sum;
+    return weights;
+}
+
+void setGaussianBlurUniforms(Shader &shader, int radius)
+{
+    vector<float> weights = getGaussianBlurWeights(radius);
+    shader.setInt("radius", (int)weights.size() - 1);
+    shader.setFloatArray("weights", &weights[0], (int)weights.size());
+}
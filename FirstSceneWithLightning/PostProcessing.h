@@ -0,0 +1,103 @@
+#pragma once
+#ifndef POST_PROCESSING_H
+#define POST_PROCESSING_H
+
+#include <GL/glew.h>
+
+#include "RenderGraph.h"
+#include "RenderTarget.h"
+#include "Shader.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// One full-screen step: reads the previous image through the "screenTexture" sampler and writes the next one.
+// Fragment passes draw a quad into the next target, compute passes store into image unit 0 in tiles of tileWidth x tileHeight.
+struct PostPass {
+    Shader *shader;
+    function<void(Shader &)> setup; // sets pass-specific uniforms, may be empty
+    unsigned int tileWidth = 0;     // work group size of a compute pass, 0 for fragment passes
+    unsigned int tileHeight = 0;
+};
+
+struct PostEffect {
+    string name;
+    vector<PostPass> passes;
+    vector<PostPass> computePasses; // optional compute-shader implementation of the same effect
+    bool enabled;
+};
+
+// A single pass that does the job of several effects at once, used when all of them are on and go one after another
+struct PostFusion {
+    vector<string> effects;
+    PostPass pass;
+};
+
+// Ordered list of 2D effects applied to the rendered scene.
+// When no effect is enabled the scene is drawn straight into the default framebuffer and no screen pass is done at all.
+class PostProcessChain
+{
+public:
+    PostProcessChain(RenderTargetPool &pool, unsigned int quadVAO);
+
+    // effects run in the order they were added
+    void AddEffect(const string &name, const vector<PostPass> &passes, bool enabled = false);
+    void AddFusion(const vector<string> &effects, const PostPass &pass);
+    void SetComputePasses(const string &name, const vector<PostPass> &passes);
+
+    // switches effects that have a compute implementation between fragment and compute passes
+    void SetUseCompute(bool useCompute);
+    bool IsUsingCompute() const;
+
+    void SetEnabled(const string &name, bool enabled);
+    bool IsEnabled(const string &name) const;
+    // true if at least one effect is on, i.e. the scene has to go through an offscreen target
+    bool IsActive() const;
+
+    // pass that only copies the scene to the screen, used when the scene is rendered at a lower resolution and no effect is on
+    void SetUpscalePass(const PostPass &pass);
+
+    // whether a scene rendered at width x height has to go through an offscreen target: some effect is on
+    // or the scene is scaled to the output size. Otherwise it is drawn straight into the default framebuffer.
+    bool NeedsSceneTarget(unsigned int width, unsigned int height, unsigned int outputWidth, unsigned int outputHeight) const;
+    // adds the enabled effects to the graph as one pass each, reading the scene target of width x height. The images
+    // in between are transients of the graph of the scene's size, the last pass writes output (the default framebuffer)
+    // and stretches the image to the output size
+    void AddPasses(RenderGraph &graph, RenderResource scene, unsigned int width, unsigned int height, RenderResource output,
+                   unsigned int outputWidth, unsigned int outputHeight);
+
+    // times the enabled effects at the given resolution through both the fragment and the compute path and prints the results
+    void Benchmark(unsigned int width, unsigned int height, int frames);
+
+private:
+    RenderTargetPool &pool;
+    unsigned int quadVAO;
+    vector<PostEffect> effects;
+    vector<PostFusion> fusions;
+    PostPass upscalePass;
+
+    unsigned int outputWidth, outputHeight;
+    bool useCompute;
+
+    // flattens enabled effects into the list of passes to draw, replacing fusable runs with their fused pass
+    vector<PostPass> collectPasses() const;
+    // runs the passes from source into output, the default framebuffer of outputWidth x outputHeight if output is null.
+    // Source is not released
+    void run(const vector<PostPass> &passes, RenderTarget *source, RenderTarget *output);
+    // one pass from source into destination of the same size, or into the default framebuffer if destination is null
+    void runPass(const PostPass &pass, RenderTarget *source, RenderTarget *destination);
+    // copies the result of a compute pass to the default framebuffer
+    void blitToScreen(RenderTarget *source);
+    int findEffect(const string &name) const;
+};
+
+// whether the context can run compute passes at all (GL 4.3 or ARB_compute_shader with image load/store)
+bool isComputeSupported();
+// normalized weights of a one-dimensional gaussian kernel, the center first; radius is clamped to what the shaders take
+vector<float> getGaussianBlurWeights(int radius);
+// sets "radius" and the normalized "weights" of a one-dimensional gaussian kernel, as used by the separable blur passes
+void setGaussianBlurUniforms(Shader &shader, int radius);
+
+#endif
@@ -0,0 +1,223 @@
+#include "RenderGraph.h"
+#include "Log.h"
+
+#include <algorithm>
+
+RenderGraph::RenderGraph(RenderTargetPool &pool)
+    : pool(pool), executedPassCount(0), culledPassCount(0), peakTransientBytes(0), totalTransientBytes(0)
+{
+}
+
+RenderResource RenderGraph::CreateTarget(const string &name, unsigned int width, unsigned int height, bool withDepth)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isTransient = true;
+    resource.isTarget = true;
+    resource.isOutput = false;
+    resource.width = width;
+    resource.height = height;
+    resource.withDepth = withDepth;
+    resource.target = nullptr;
+    resources.push_back(resource);
+    return resources.size() - 1;
+}
+
+RenderResource RenderGraph::ImportTarget(const string &name, RenderTarget *target)
+{
+    RenderResource resource = ImportResource(name);
+    resources[resource].isTarget = true;
+    resources[resource].isOutput = true;
+    resources[resource].target = target;
+    return resource;
+}
+
+RenderResource RenderGraph::ImportResource(const string &name)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isTransient = false;
+    resource.isTarget = false;
+    resource.isOutput = false;
+    resource.width = resource.height = 0;
+    resource.withDepth = false;
+    resource.target = nullptr;
+    resources.push_back(resource);
+    return resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const string &name, const vector<RenderResource> &reads, const vector<RenderResource> &writes,
+                          const function<void()> &execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.reads = reads;
+    pass.writes = writes;
+    pass.execute = execute;
+    for (unsigned int i = 0; i < writes.size(); i++)
+        resources[writes[i]].writers.push_back(passes.size());
+    passes.push_back(pass);
+}
+
+RenderTarget *RenderGraph::GetTarget(RenderResource resource) const
+{
+    return resources[resource].target;
+}
+
+unsigned int RenderGraph::GetFramebuffer(RenderResource resource) const
+{
+    return resources[resource].target ? resources[resource].target->FBO : 0;
+}
+
+void RenderGraph::Execute()
+{
+    // everything that leads to an output is needed, the rest is culled
+    vector<bool> isNeeded(passes.size(), false);
+    vector<unsigned int> stack;
+    for (unsigned int p = 0; p < passes.size(); p++)
+        for (unsigned int w = 0; w < passes[p].writes.size(); w++)
+            if (resources[passes[p].writes[w]].isOutput && !isNeeded[p]) {
+                isNeeded[p] = true;
+                stack.push_back(p);
+            }
+    while (!stack.empty())
+    {
+        vector<unsigned int> before = dependencies(stack.back());
+        stack.pop_back();
+        for (unsigned int i = 0; i < before.size(); i++)
+            if (!isNeeded[before[i]]) {
+                isNeeded[before[i]] = true;
+                stack.push_back(before[i]);
+            }
+    }
+    vector<unsigned int> sorted;
+    if (!order(isNeeded, sorted))
+        LOG(LOG_ERROR) << "ERROR::RENDER_GRAPH::EXECUTE:: Passes depend on each other in a cycle, running them as added";
+
+    // lifetimes of the transients, in positions of sorted
+    const unsigned int NOT_USED = ~0u;
+    vector<unsigned int> first(resources.size(), NOT_USED), last(resources.size(), 0);
+    for (unsigned int i = 0; i < sorted.size(); i++)
+    {
+        const Pass &pass = passes[sorted[i]];
+        for (unsigned int k = 0; k < pass.reads.size() + pass.writes.size(); k++)
+        {
+            RenderResource resource = k < pass.reads.size() ? pass.reads[k] : pass.writes[k - pass.reads.size()];
+            first[resource] = min(first[resource], i);
+            last[resource] = max(last[resource], i);
+        }
+    }
+
+    size_t aliveBytes = 0;
+    peakTransientBytes = totalTransientBytes = 0;
+    for (unsigned int i = 0; i < sorted.size(); i++)
+    {
+        for (unsigned int r = 0; r < resources.size(); r++)
+            if (resources[r].isTransient && first[r] == i) {
+                resources[r].target = pool.Acquire(resources[r].width, resources[r].height, resources[r].withDepth);
+                aliveBytes += targetBytes(resources[r]);
+                totalTransientBytes += targetBytes(resources[r]);
+            }
+        peakTransientBytes = max(peakTransientBytes, aliveBytes);
+        passes[sorted[i]].execute();
+        // released targets go to the next transient of the same size
+        for (unsigned int r = 0; r < resources.size(); r++)
+            if (resources[r].isTransient && first[r] != NOT_USED && last[r] == i) {
+                pool.Release(resources[r].target);
+                resources[r].target = nullptr;
+                aliveBytes -= targetBytes(resources[r]);
+            }
+    }
+    executedPassCount = sorted.size();
+    culledPassCount = passes.size() - sorted.size();
+    passes.clear();
+    resources.clear();
+}
+
+unsigned int RenderGraph::GetExecutedPassCount() const
+{
+    return executedPassCount;
+}
+
+unsigned int RenderGraph::GetCulledPassCount() const
+{
+    return culledPassCount;
+}
+
+size_t RenderGraph::GetPeakTransientBytes() const
+{
+    return peakTransientBytes;
+}
+
+size_t RenderGraph::GetTotalTransientBytes() const
+{
+    return totalTransientBytes;
+}
+
+vector<unsigned int> RenderGraph::dependencies(unsigned int pass) const
+{
+    vector<unsigned int> before;
+    // a read sees every write of the resource
+    for (unsigned int i = 0; i < passes[pass].reads.size(); i++)
+    {
+        const vector<unsigned int> &writers = resources[passes[pass].reads[i]].writers;
+        for (unsigned int w = 0; w < writers.size(); w++)
+            if (writers[w] != pass)
+                before.push_back(writers[w]);
+    }
+    // writes of the same resource keep the order they were added in
+    for (unsigned int i = 0; i < passes[pass].writes.size(); i++)
+    {
+        const vector<unsigned int> &writers = resources[passes[pass].writes[i]].writers;
+        for (unsigned int w = 0; w < writers.size() && writers[w] < pass; w++)
+            before.push_back(writers[w]);
+    }
+    return before;
+}
+
+bool RenderGraph::order(const vector<bool> &isNeeded, vector<unsigned int> &sorted) const
+{
+    // Kahn's algorithm, the earliest added of the ready passes goes first
+    vector<vector<unsigned int> > after(passes.size());
+    vector<unsigned int> waitingFor(passes.size(), 0);
+    for (unsigned int p = 0; p < passes.size(); p++)
+    {
+        if (!isNeeded[p])
+            continue;
+        vector<unsigned int> before = dependencies(p);
+        sort(before.begin(), before.end());
+        before.erase(unique(before.begin(), before.end()), before.end());
+        for (unsigned int i = 0; i < before.size(); i++)
+            after[before[i]].push_back(p);
+        waitingFor[p] = before.size();
+    }
+    vector<unsigned int> ready;
+    for (unsigned int p = 0; p < passes.size(); p++)
+        if (isNeeded[p] && waitingFor[p] == 0)
+            ready.push_back(p);
+    sorted.clear();
+    while (!ready.empty())
+    {
+        vector<unsigned int>::iterator next = min_element(ready.begin(), ready.end());
+        unsigned int pass = *next;
+        ready.erase(next);
+        sorted.push_back(pass);
+        for (unsigned int i = 0; i < after[pass].size(); i++)
+            if (--waitingFor[after[pass][i]] == 0)
+                ready.push_back(after[pass][i]);
+    }
+    unsigned int neededCount = count(isNeeded.begin(), isNeeded.end(), true);
+    if (sorted.size() == neededCount)
+        return true;
+    sorted.clear();
+    for (unsigned int p = 0; p < passes.size(); p++)
+        if (isNeeded[p])
+            sorted.push_back(p);
+    return false;
+}
+
+size_t RenderGraph::targetBytes(const Resource &resource)
+{
+    // RGBA8 color and a 24/8 depth-stencil buffer
+    return (size_t)resource.width * resource.height * (resource.withDepth ? 8 : 4);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <GL/glew.h>
+
+#include "RenderTarget.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef unsigned int RenderResource;
+
+// A frame described as passes that declare which resources they read and write.
+// Execute() orders the passes so that every reader comes after all writers of what it reads (and writers of the
+// same resource stay in the order they were added), drops passes whose results never reach an output and takes
+// transient targets from the pool only for the span of passes that use them: a transient is acquired right before
+// its first pass and released after its last one, so transients whose lifetimes don't overlap share one target.
+// The graph is described again every frame, Execute() forgets the passes and resources after running them.
+class RenderGraph
+{
+public:
+    RenderGraph(RenderTargetPool &pool);
+
+    // a color target with an optional depth-stencil buffer that only lives during this frame's passes
+    RenderResource CreateTarget(const string &name, unsigned int width, unsigned int height, bool withDepth);
+    // a framebuffer owned by someone else, nullptr for the default one. Imported targets are outputs,
+    // the passes writing them and everything those passes read are never culled
+    RenderResource ImportTarget(const string &name, RenderTarget *target);
+    // GL state that isn't a framebuffer (shadow maps, light lists), it only orders and culls the passes
+    RenderResource ImportResource(const string &name);
+
+    void AddPass(const string &name, const vector<RenderResource> &reads, const vector<RenderResource> &writes,
+                 const function<void()> &execute);
+    // the pool target of a target resource while its passes run, nullptr for the default framebuffer
+    RenderTarget *GetTarget(RenderResource resource) const;
+    // FBO to bind for a target resource, 0 for the default framebuffer
+    unsigned int GetFramebuffer(RenderResource resource) const;
+
+    void Execute();
+
+    // of the last Execute()
+    unsigned int GetExecutedPassCount() const;
+    unsigned int GetCulledPassCount() const;
+    // memory of the transient targets alive at the same time at most, and of all of them without aliasing
+    size_t GetPeakTransientBytes() const;
+    size_t GetTotalTransientBytes() const;
+
+private:
+    struct Resource {
+        string name;
+        bool isTransient;
+        bool isTarget;
+        bool isOutput;
+        unsigned int width, height;
+        bool withDepth;
+        RenderTarget *target;
+        vector<unsigned int> writers; // passes, in the order they were added
+    };
+    struct Pass {
+        string name;
+        vector<RenderResource> reads, writes;
+        function<void()> execute;
+    };
+
+    RenderTargetPool &pool;
+    vector<Resource> resources;
+    vector<Pass> passes;
+    unsigned int executedPassCount, culledPassCount;
+    size_t peakTransientBytes, totalTransientBytes;
+
+    // passes that have to run before the pass
+    vector<unsigned int> dependencies(unsigned int pass) const;
+    // the needed passes, dependencies first; false and declaration order if the passes depend on each other in a cycle
+    bool order(const vector<bool> &isNeeded, vector<unsigned int> &sorted) const;
+    static size_t targetBytes(const Resource &resource);
+};
+#endif
@@ -0,0 +1,112 @@
+#include "RenderTarget.h"
+#include "GpuResources.h"
+#include "Log.h"
+
+
+RenderTarget *RenderTargetPool::Acquire(unsigned int width, unsigned int height, bool withDepth)
+{
+    for (unsigned int i = 0; i < targets.size(); i++)
+    {
+        RenderTarget *target = targets[i];
+        if (!target->inUse && target->width == width && target->height == height && (target->depthRBO != 0) == withDepth)
+        {
+            target->inUse = true;
+            target->lastUsedFrame = frame;
+            return target;
+        }
+    }
+    RenderTarget *target = createTarget(width, height, withDepth);
+    target->inUse = true;
+    target->lastUsedFrame = frame;
+    targets.push_back(target);
+    return target;
+}
+
+void RenderTargetPool::Release(RenderTarget *target)
+{
+    if (target)
+        target->inUse = false;
+}
+
+void RenderTargetPool::Trim()
+{
+    vector<RenderTarget*> kept;
+    for (unsigned int i = 0; i < targets.size(); i++)
+    {
+        if (targets[i]->inUse)
+            kept.push_back(targets[i]);
+        else
+            deleteTarget(targets[i]);
+    }
+    targets.swap(kept);
+}
+
+void RenderTargetPool::EndFrame(unsigned int maxIdleFrames)
+{
+    frame++;
+    vector<RenderTarget*> kept;
+    for (unsigned int i = 0; i < targets.size(); i++)
+    {
+        if (targets[i]->inUse || frame - targets[i]->lastUsedFrame <= maxIdleFrames)
+            kept.push_back(targets[i]);
+        else
+            deleteTarget(targets[i]);
+    }
+    targets.swap(kept);
+}
+
+void RenderTargetPool::Clear()
+{
+    for (unsigned int i = 0; i < targets.size(); i++)
+        deleteTarget(targets[i]);
+    targets.clear();
+}
+
+RenderTarget *RenderTargetPool::createTarget(unsigned int width, unsigned int height, bool withDepth)
+{
+    RenderTarget *target = new RenderTarget();
+    target->width = width;
+    target->height = height;
+    target->depthRBO = 0;
+
+    glGenFramebuffers(1, &target->FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->FBO);
+    // create a color attachment texture
+    glGenTextures(1, &target->colorTexture);
+    glBindTexture(GL_TEXTURE_2D, target->colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // RGBA8 so compute passes can bind it as an image
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // post effects sample neighbours of edge texels, don't let them wrap around to the other side
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->colorTexture, 0);
+    GpuResourceRegistry::Get().Add(GPU_FRAMEBUFFER, target->FBO, 0, "render target pool");
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, target->colorTexture, GpuResourceRegistry::TextureBytes(width, height, 1, 4, false), "render target pool");
+    if (withDepth)
+    {
+        // use a single renderbuffer object for both a depth AND stencil buffer (we won't be sampling these)
+        glGenRenderbuffers(1, &target->depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, target->depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->depthRBO);
+        GpuResourceRegistry::Get().Add(GPU_RENDERBUFFER, target->depthRBO, (size_t)width * height * 4, "render target pool");
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG(LOG_ERROR) << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!";
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return target;
+}
+
+void RenderTargetPool::deleteTarget(RenderTarget *target)
+{
+    GpuResourceRegistry::Get().Remove(GPU_FRAMEBUFFER, target->FBO);
+    GpuResourceRegistry::Get().Remove(GPU_TEXTURE, target->colorTexture);
+    glDeleteFramebuffers(1, &target->FBO);
+    glDeleteTextures(1, &target->colorTexture);
+    if (target->depthRBO) {
+        GpuResourceRegistry::Get().Remove(GPU_RENDERBUFFER, target->depthRBO);
+        glDeleteRenderbuffers(1, &target->depthRBO);
+    }
+    delete target;
+}
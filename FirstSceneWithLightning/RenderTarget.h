@@ -0,0 +1,45 @@
+#pragma once
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+#include <vector>
+using namespace std;
+
+// An offscreen framebuffer with a color texture and an optional depth-stencil renderbuffer
+struct RenderTarget {
+    unsigned int FBO;
+    unsigned int colorTexture;
+    unsigned int depthRBO; // 0 if the target has no depth-stencil attachment
+    unsigned int width;
+    unsigned int height;
+    bool inUse;
+    unsigned int lastUsedFrame;
+};
+
+// Keeps offscreen render targets alive between frames, so passes that need a temporary target
+// get a recycled one instead of creating a new framebuffer every frame.
+class RenderTargetPool
+{
+public:
+    // returns a free target of exactly the requested size, creating a new one if there is none
+    RenderTarget *Acquire(unsigned int width, unsigned int height, bool withDepth);
+    // gives the target back to the pool, it may be handed out again on the next Acquire
+    void Release(RenderTarget *target);
+    // deletes every target that is not in use right now (e.g. targets of an old window size)
+    void Trim();
+    // advances the frame counter and deletes targets nobody asked for during the last maxIdleFrames frames,
+    // so a render resolution that keeps changing doesn't pile up targets of every size it went through
+    void EndFrame(unsigned int maxIdleFrames);
+    // deletes every target, has to be called while the GL context is still alive
+    void Clear();
+
+private:
+    vector<RenderTarget*> targets;
+    unsigned int frame = 0;
+
+    RenderTarget *createTarget(unsigned int width, unsigned int height, bool withDepth);
+    void deleteTarget(RenderTarget *target);
+};
+#endif
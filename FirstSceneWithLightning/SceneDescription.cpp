@@ -0,0 +1,482 @@
+#include "SceneDescription.h"
+#include "TexturePacking.h"
+#include "Log.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+const unsigned int SCENE_BINARY_MAGIC = 0x424E4353; // "SCNB"
+const unsigned int SCENE_BINARY_VERSION = 5;
+
+static unsigned long long hashText(const string &text)
+{
+    // FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned int i = 0; i < text.size(); i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool readFile(const string &path, string &text)
+{
+    ifstream file(path.c_str(), ios::in | ios::binary);
+    if (!file)
+        return false;
+    stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+static bool parseShading(const string &name, SCENE_SHADING &shading)
+{
+    if (name == "parallax")
+        shading = PARALLAX_SHADING;
+    else if (name == "normal")
+        shading = NORMAL_SHADING;
+    else if (name == "reflection")
+        shading = REFLECTION_SHADING;
+    else if (name == "lamp")
+        shading = LAMP_SHADING;
+    else
+        return false;
+    return true;
+}
+
+static bool parseKind(const string &name, SCENE_OBJECT_KIND &kind)
+{
+    if (name == "empty")
+        kind = EMPTY_OBJECT;
+    else if (name == "quad")
+        kind = QUAD_OBJECT;
+    else if (name == "cube")
+        kind = CUBE_OBJECT;
+    else if (name == "model")
+        kind = MODEL_OBJECT;
+    else
+        return false;
+    return true;
+}
+
+static int findMaterial(const SceneDescription &scene, const string &name)
+{
+    for (unsigned int i = 0; i < scene.materials.size(); i++)
+        if (scene.materials[i].name == name)
+            return i;
+    return -1;
+}
+
+static int findObject(const SceneDescription &scene, const string &name)
+{
+    for (unsigned int i = 0; i < scene.objects.size(); i++)
+        if (scene.objects[i].name == name)
+            return i;
+    return -1;
+}
+
+// the whole token is a number
+static bool isNumber(const string &token)
+{
+    char *end = nullptr;
+    strtof(token.c_str(), &end);
+    return !token.empty() && *end == '\0';
+}
+
+// object <name> <empty|quad|cube|model <path>> [material] [parent <name>] [position x y z] [rotation x y z] [scale x y z | scale s] [follow_light] [dynamic] [occluder]
+static bool parseObject(istringstream &line, SceneDescription &scene, string &error)
+{
+    SceneObject object;
+    string kind;
+    if (!(line >> object.name >> kind) || !parseKind(kind, object.kind)) {
+        error = "expected object name and kind";
+        return false;
+    }
+    if (object.kind == MODEL_OBJECT && !(line >> object.modelPath)) {
+        error = "expected model path";
+        return false;
+    }
+    object.material = -1;
+    if (object.kind != EMPTY_OBJECT) {
+        string material;
+        line >> material;
+        object.material = findMaterial(scene, material);
+        if (object.material < 0) {
+            error = "unknown material '" + material + "'";
+            return false;
+        }
+    }
+    object.parent = -1;
+    object.position = glm::vec3(0.f);
+    object.rotation = glm::vec3(0.f);
+    object.scale = glm::vec3(1.f);
+    object.isFollowingLight = false;
+    object.isDynamic = false;
+    object.isOccluder = false;
+    string key;
+    while (line >> key)
+    {
+        if (key == "parent") {
+            string parent;
+            line >> parent;
+            // parents have to be declared first, that is what keeps the scene graph order parent before child
+            object.parent = findObject(scene, parent);
+            if (object.parent < 0) {
+                error = "unknown parent '" + parent + "'";
+                return false;
+            }
+        } else if (key == "position") {
+            line >> object.position.x >> object.position.y >> object.position.z;
+        } else if (key == "rotation") {
+            line >> object.rotation.x >> object.rotation.y >> object.rotation.z;
+        } else if (key == "scale") {
+            // scale x y z, or scale s when no number follows s
+            if (line >> object.scale.x && !line.eof()) {
+                streampos next = line.tellg();
+                string token;
+                if (line >> token && isNumber(token)) {
+                    object.scale.y = strtof(token.c_str(), nullptr);
+                    if (!(line >> object.scale.z)) {
+                        error = "'scale' takes x y z or a single s";
+                        return false;
+                    }
+                } else {
+                    line.clear();
+                    line.seekg(next);
+                    object.scale = glm::vec3(object.scale.x);
+                }
+            } else {
+                object.scale = glm::vec3(object.scale.x);
+            }
+        } else if (key == "follow_light") {
+            object.isFollowingLight = true;
+        } else if (key == "dynamic") {
+            object.isDynamic = true;
+        } else if (key == "occluder") {
+            object.isOccluder = true;
+        } else {
+            error = "unknown object property '" + key + "'";
+            return false;
+        }
+        if (line.fail()) {
+            error = "bad value of '" + key + "'";
+            return false;
+        }
+    }
+    scene.objects.push_back(object);
+    return true;
+}
+
+// light x y z [radius r] [color r g b] [spot dx dy dz outerAngle innerAngle]
+static bool parseLight(istringstream &line, SceneDescription &scene, string &error)
+{
+    SceneLight light;
+    if (!(line >> light.position.x >> light.position.y >> light.position.z)) {
+        error = "expected light position";
+        return false;
+    }
+    string key;
+    while (line >> key)
+    {
+        if (key == "radius") {
+            line >> light.radius;
+        } else if (key == "color") {
+            line >> light.color.r >> light.color.g >> light.color.b;
+        } else if (key == "spot") {
+            line >> light.spotDirection.x >> light.spotDirection.y >> light.spotDirection.z >> light.spotOuterAngle >> light.spotInnerAngle;
+        } else {
+            error = "unknown light property '" + key + "'";
+            return false;
+        }
+        if (line.fail()) {
+            error = "bad value of '" + key + "'";
+            return false;
+        }
+    }
+    scene.lights.push_back(light);
+    return true;
+}
+
+bool ParseSceneText(const string &path, SceneDescription &scene)
+{
+    string text;
+    if (!readFile(path, text)) {
+        LOG(LOG_ERROR) << "ERROR::SCENE::FILE_NOT_SUCCESFULLY_READ: " << path;
+        return false;
+    }
+    scene = SceneDescription();
+    istringstream stream(text);
+    string lineText;
+    unsigned int lineNumber = 0;
+    while (getline(stream, lineText))
+    {
+        lineNumber++;
+        istringstream line(lineText);
+        string command;
+        if (!(line >> command) || command[0] == '#')
+            continue;
+        string error;
+        if (command == "camera") {
+            if (!(line >> scene.cameraPosition.x >> scene.cameraPosition.y >> scene.cameraPosition.z))
+                error = "expected camera position";
+        } else if (command == "skybox") {
+            string face;
+            line >> scene.skyboxDirectory;
+            while (line >> face)
+                scene.skyboxFaces.push_back(face);
+            if (scene.skyboxFaces.size() != 6)
+                error = "skybox needs a directory and 6 faces";
+        } else if (command == "material") {
+            SceneMaterial material;
+            string shading;
+            if (!(line >> material.name >> shading) || !parseShading(shading, material.shading))
+                error = "expected material name and shading (parallax, normal, reflection or lamp)";
+            else
+                scene.materials.push_back(material);
+        } else if (command == "texture") {
+            SceneMaterialTexture texture;
+            if (scene.materials.empty())
+                error = "texture outside of a material";
+            else if (!(line >> texture.type >> texture.path))
+                error = "expected texture type and path";
+            else
+                scene.materials.back().textures.push_back(texture);
+        } else if (command == "light") {
+            parseLight(line, scene, error);
+        } else if (command == "object") {
+            parseObject(line, scene, error);
+        } else {
+            error = "unknown command '" + command + "'";
+        }
+        if (!error.empty()) {
+            LOG(LOG_ERROR) << "ERROR::SCENE::PARSE_FAILED: " << path << ":" << lineNumber << ": " << error;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writeUInt(ofstream &file, unsigned int value)
+{
+    file.write((const char*)&value, sizeof(value));
+}
+
+static void writeString(ofstream &file, const string &value)
+{
+    writeUInt(file, value.size());
+    file.write(value.data(), value.size());
+}
+
+static void writeVec3(ofstream &file, const glm::vec3 &value)
+{
+    file.write((const char*)&value.x, 3 * sizeof(float));
+}
+
+bool SaveSceneBinary(const string &path, const SceneDescription &scene, unsigned long long sourceHash)
+{
+    ofstream file(path.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!file)
+        return false;
+    writeUInt(file, SCENE_BINARY_MAGIC);
+    writeUInt(file, SCENE_BINARY_VERSION);
+    file.write((const char*)&sourceHash, sizeof(sourceHash));
+    writeVec3(file, scene.cameraPosition);
+    writeString(file, scene.skyboxDirectory);
+    writeUInt(file, scene.skyboxFaces.size());
+    for (unsigned int i = 0; i < scene.skyboxFaces.size(); i++)
+        writeString(file, scene.skyboxFaces[i]);
+    writeUInt(file, scene.materials.size());
+    for (unsigned int i = 0; i < scene.materials.size(); i++)
+    {
+        const SceneMaterial &material = scene.materials[i];
+        writeString(file, material.name);
+        writeUInt(file, material.shading);
+        writeUInt(file, material.textures.size());
+        for (unsigned int j = 0; j < material.textures.size(); j++)
+        {
+            writeString(file, material.textures[j].type);
+            writeString(file, material.textures[j].path);
+        }
+    }
+    writeUInt(file, scene.objects.size());
+    for (unsigned int i = 0; i < scene.objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        writeString(file, object.name);
+        writeUInt(file, object.kind);
+        writeString(file, object.modelPath);
+        writeUInt(file, (unsigned int)object.material);
+        writeUInt(file, (unsigned int)object.parent);
+        writeVec3(file, object.position);
+        writeVec3(file, object.rotation);
+        writeVec3(file, object.scale);
+        writeUInt(file, object.isFollowingLight);
+        writeUInt(file, object.isDynamic);
+        writeUInt(file, object.isOccluder);
+    }
+    writeUInt(file, scene.lights.size());
+    for (unsigned int i = 0; i < scene.lights.size(); i++)
+    {
+        const SceneLight &light = scene.lights[i];
+        writeVec3(file, light.position);
+        file.write((const char*)&light.radius, sizeof(float));
+        writeVec3(file, light.color);
+        writeVec3(file, light.spotDirection);
+        file.write((const char*)&light.spotOuterAngle, sizeof(float));
+        file.write((const char*)&light.spotInnerAngle, sizeof(float));
+    }
+    return file.good();
+}
+
+// reads from the compiled file, every read checks the remaining size so a truncated file can't run past the end
+class SceneBinaryReader
+{
+public:
+    SceneBinaryReader(const string &data) : data(data), offset(0), isGood(true) {}
+
+    bool Good() const { return isGood; }
+
+    void Read(void *value, unsigned int size)
+    {
+        if (!isGood || data.size() - offset < size) {
+            isGood = false;
+            return;
+        }
+        memcpy(value, data.data() + offset, size);
+        offset += size;
+    }
+
+    unsigned int ReadUInt()
+    {
+        unsigned int value = 0;
+        Read(&value, sizeof(value));
+        return value;
+    }
+
+    // counts and lengths can't be larger than what is left of the file
+    unsigned int ReadCount()
+    {
+        unsigned int count = ReadUInt();
+        if (count > data.size() - offset)
+            isGood = false;
+        return isGood ? count : 0;
+    }
+
+    string ReadString()
+    {
+        unsigned int size = ReadCount();
+        string value = data.substr(offset, size);
+        offset += size;
+        return value;
+    }
+
+    glm::vec3 ReadVec3()
+    {
+        glm::vec3 value(0.f);
+        Read(&value.x, 3 * sizeof(float));
+        return value;
+    }
+
+private:
+    const string &data;
+    size_t offset;
+    bool isGood;
+};
+
+bool LoadSceneBinary(const string &path, SceneDescription &scene, unsigned long long &sourceHash)
+{
+    string data;
+    if (!readFile(path, data))
+        return false;
+    SceneBinaryReader reader(data);
+    if (reader.ReadUInt() != SCENE_BINARY_MAGIC || reader.ReadUInt() != SCENE_BINARY_VERSION)
+        return false;
+    scene = SceneDescription();
+    reader.Read(&sourceHash, sizeof(sourceHash));
+    scene.cameraPosition = reader.ReadVec3();
+    scene.skyboxDirectory = reader.ReadString();
+    scene.skyboxFaces.resize(reader.ReadCount());
+    for (unsigned int i = 0; i < scene.skyboxFaces.size(); i++)
+        scene.skyboxFaces[i] = reader.ReadString();
+    scene.materials.resize(reader.ReadCount());
+    for (unsigned int i = 0; i < scene.materials.size(); i++)
+    {
+        SceneMaterial &material = scene.materials[i];
+        material.name = reader.ReadString();
+        unsigned int shading = reader.ReadUInt();
+        if (shading > LAMP_SHADING)
+            return false;
+        material.shading = (SCENE_SHADING)shading;
+        material.textures.resize(reader.ReadCount());
+        for (unsigned int j = 0; j < material.textures.size(); j++)
+        {
+            material.textures[j].type = reader.ReadString();
+            material.textures[j].path = reader.ReadString();
+        }
+    }
+    scene.objects.resize(reader.ReadCount());
+    for (unsigned int i = 0; i < scene.objects.size(); i++)
+    {
+        SceneObject &object = scene.objects[i];
+        object.name = reader.ReadString();
+        unsigned int kind = reader.ReadUInt();
+        if (kind > MODEL_OBJECT)
+            return false;
+        object.kind = (SCENE_OBJECT_KIND)kind;
+        object.modelPath = reader.ReadString();
+        object.material = (int)reader.ReadUInt();
+        object.parent = (int)reader.ReadUInt();
+        object.position = reader.ReadVec3();
+        object.rotation = reader.ReadVec3();
+        object.scale = reader.ReadVec3();
+        object.isFollowingLight = reader.ReadUInt() != 0;
+        object.isDynamic = reader.ReadUInt() != 0;
+        object.isOccluder = reader.ReadUInt() != 0;
+        // the same invariants the text parser enforces: only empty objects go without a material,
+        // parents come before their children
+        bool isMaterialValid = object.kind == EMPTY_OBJECT ? object.material == -1
+            : object.material >= 0 && object.material < (int)scene.materials.size();
+        if (!isMaterialValid || object.parent < -1 || object.parent >= (int)i)
+            return false;
+    }
+    scene.lights.resize(reader.ReadCount());
+    for (unsigned int i = 0; i < scene.lights.size(); i++)
+    {
+        SceneLight &light = scene.lights[i];
+        light.position = reader.ReadVec3();
+        reader.Read(&light.radius, sizeof(float));
+        light.color = reader.ReadVec3();
+        light.spotDirection = reader.ReadVec3();
+        reader.Read(&light.spotOuterAngle, sizeof(float));
+        reader.Read(&light.spotInnerAngle, sizeof(float));
+    }
+    return reader.Good();
+}
+
+bool LoadScene(const string &path, SceneDescription &scene)
+{
+    string compiledPath = path + "b";
+    string text;
+    unsigned long long sourceHash = 0;
+    if (!readFile(path, text)) {
+        // shipping only the compiled scene is fine
+        if (LoadSceneBinary(compiledPath, scene, sourceHash))
+            return true;
+        LOG(LOG_ERROR) << "ERROR::SCENE::FILE_NOT_SUCCESFULLY_READ: " << path;
+        return false;
+    }
+    unsigned long long textHash = hashText(text);
+    // a deleted packed texture is made again with the rest of the compiled scene
+    if (LoadSceneBinary(compiledPath, scene, sourceHash) && sourceHash == textHash && ArePackedTexturesPresent(scene))
+        return true;
+    if (!ParseSceneText(path, scene))
+        return false;
+    PackSceneTextures(scene);
+    if (!SaveSceneBinary(compiledPath, scene, textHash))
+        LOG(LOG_ERROR) << "ERROR::SCENE::COMPILED_FILE_NOT_WRITTEN: " << compiledPath;
+    return true;
+}
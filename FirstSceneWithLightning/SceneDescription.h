@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SCENE_DESCRIPTION_H
+#define SCENE_DESCRIPTION_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Which of the scene shaders draws an object
+enum SCENE_SHADING {
+    PARALLAX_SHADING,
+    NORMAL_SHADING,
+    REFLECTION_SHADING,
+    LAMP_SHADING
+};
+
+enum SCENE_OBJECT_KIND {
+    EMPTY_OBJECT,   // only groups its children
+    QUAD_OBJECT,
+    CUBE_OBJECT,
+    MODEL_OBJECT
+};
+
+struct SceneMaterialTexture {
+    string type;    // texture_diffuse, texture_normal, ..., texture_packed
+    string path;
+};
+
+struct SceneMaterial {
+    string name;
+    SCENE_SHADING shading;
+    vector<SceneMaterialTexture> textures;
+};
+
+struct SceneObject {
+    string name;
+    SCENE_OBJECT_KIND kind;
+    string modelPath;   // MODEL_OBJECT only
+    int material;       // index in SceneDescription::materials, -1 for EMPTY_OBJECT
+    int parent;         // index in SceneDescription::objects, -1 for the root; always smaller than the object's own index
+    glm::vec3 position;
+    glm::vec3 rotation; // euler angles in degrees
+    glm::vec3 scale;
+    bool isFollowingLight; // placed at the animated light position every frame, doesn't cast shadows
+    bool isDynamic;        // moved by code at runtime, its shadows are redrawn every frame instead of cached
+    bool isOccluder;       // big and solid, rasterized on the CPU to hide the objects behind it
+};
+
+struct SceneLight {
+    glm::vec3 position;
+    float radius = 20.f;
+    glm::vec3 color = glm::vec3(1.f);
+    glm::vec3 spotDirection = glm::vec3(0.f, -1.f, 0.f);
+    float spotOuterAngle = 0.f; // degrees, 0 for point lights
+    float spotInnerAngle = 0.f;
+};
+
+// Everything that makes up a scene, read from a .scene file instead of being hard-coded in main()
+struct SceneDescription {
+    glm::vec3 cameraPosition = glm::vec3(0.f, 0.f, 3.f);
+    string skyboxDirectory;
+    vector<string> skyboxFaces;
+    vector<SceneMaterial> materials;
+    vector<SceneObject> objects;
+    vector<SceneLight> lights;
+};
+
+// Reads the text form, reports the first bad line and returns false on errors
+bool ParseSceneText(const string &path, SceneDescription &scene);
+// Compiled binary form, sourceHash identifies the text it was compiled from
+bool SaveSceneBinary(const string &path, const SceneDescription &scene, unsigned long long sourceHash);
+bool LoadSceneBinary(const string &path, SceneDescription &scene, unsigned long long &sourceHash);
+
+// Loads path (a text .scene file) through its compiled copy at path + "b".
+// The text is only parsed when the compiled copy is missing or was made from a different text, the copy is rewritten then
+// and the materials' maps are packed (see TexturePacking.h).
+bool LoadScene(const string &path, SceneDescription &scene);
+#endif
@@ -0,0 +1,75 @@
+#include "SceneGraph.h"
+
+SceneGraph::SceneGraph() : firstDirty(NO_PARENT)
+{
+}
+
+NodeId SceneGraph::AddNode(NodeId parent, const glm::mat4 &localMatrix)
+{
+    NodeId node = parents.size();
+    parents.push_back(parent < node ? parent : NO_PARENT);
+    localMatrices.push_back(localMatrix);
+    worldMatrices.push_back(localMatrix);
+    dirty.push_back(1);
+    if (node < firstDirty)
+        firstDirty = node;
+    return node;
+}
+
+void SceneGraph::SetLocalMatrix(NodeId node, const glm::mat4 &localMatrix)
+{
+    localMatrices[node] = localMatrix;
+    dirty[node] = 1;
+    if (node < firstDirty)
+        firstDirty = node;
+}
+
+void SceneGraph::SetLocalTransform(NodeId node, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat4 localMatrix = glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(rotation);
+    localMatrix = glm::scale(localMatrix, scale);
+    SetLocalMatrix(node, localMatrix);
+}
+
+NodeId SceneGraph::GetParent(NodeId node) const
+{
+    return parents[node];
+}
+
+const glm::mat4 &SceneGraph::GetLocalMatrix(NodeId node) const
+{
+    return localMatrices[node];
+}
+
+const glm::mat4 &SceneGraph::GetWorldMatrix(NodeId node) const
+{
+    return worldMatrices[node];
+}
+
+unsigned int SceneGraph::Size() const
+{
+    return parents.size();
+}
+
+unsigned int SceneGraph::UpdateWorldTransforms()
+{
+    if (firstDirty == NO_PARENT)
+        return 0;
+    unsigned int updated = 0;
+    NodeId count = parents.size();
+    for (NodeId i = firstDirty; i < count; i++)
+    {
+        NodeId parent = parents[i];
+        // a parent before firstDirty can't have changed, its flag is already clear
+        if (dirty[i] || (parent != NO_PARENT && dirty[parent]))
+        {
+            worldMatrices[i] = parent == NO_PARENT ? localMatrices[i] : worldMatrices[parent] * localMatrices[i];
+            dirty[i] = 1;
+            updated++;
+        }
+    }
+    for (NodeId i = firstDirty; i < count; i++)
+        dirty[i] = 0;
+    firstDirty = NO_PARENT;
+    return updated;
+}
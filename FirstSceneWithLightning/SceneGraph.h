@@ -0,0 +1,50 @@
+#pragma once
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+using namespace std;
+
+typedef unsigned int NodeId;
+const NodeId NO_PARENT = 0xFFFFFFFF;
+
+// Parent/child transform hierarchy stored as parallel arrays (structure of arrays).
+// A node is always added after its parent, so parents[i] < i and world matrices can be
+// recomputed in one front-to-back pass over the arrays instead of a recursive tree walk.
+// World matrices are only recomputed for nodes whose local transform changed and their descendants,
+// a frame where nothing moved costs nothing.
+class SceneGraph
+{
+public:
+    SceneGraph();
+
+    NodeId AddNode(NodeId parent = NO_PARENT, const glm::mat4 &localMatrix = glm::mat4(1.f));
+
+    void SetLocalMatrix(NodeId node, const glm::mat4 &localMatrix);
+    // builds the local matrix from translation, rotation and scale, applied in scale-rotate-translate order
+    void SetLocalTransform(NodeId node, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+
+    NodeId GetParent(NodeId node) const;
+    const glm::mat4 &GetLocalMatrix(NodeId node) const;
+    // world matrix as of the last UpdateWorldTransforms()
+    const glm::mat4 &GetWorldMatrix(NodeId node) const;
+    unsigned int Size() const;
+
+    // recomputes world matrices of changed nodes and everything below them, returns how many were recomputed
+    unsigned int UpdateWorldTransforms();
+
+private:
+    vector<NodeId> parents;
+    vector<glm::mat4> localMatrices;
+    vector<glm::mat4> worldMatrices;
+    // 1 if the local matrix changed since the last update; during the update also set for recomputed nodes,
+    // which is how the change reaches the children further down the arrays
+    vector<unsigned char> dirty;
+    // nodes before this index are untouched since the last update, the pass starts here
+    NodeId firstDirty;
+};
+#endif
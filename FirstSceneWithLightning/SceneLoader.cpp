@@ -0,0 +1,411 @@
+#include "SceneLoader.h"
+#include "MeshGenerators.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+SceneLoader::SceneLoader(const SceneDescription &scene, SceneGraph &graph, bool isCpuOnly)
+    : scene(scene), graph(graph), isCpuOnly(isCpuOnly), textureStreamer(nullptr), threadPool(nullptr), lightPosition(0.f), isLightPositionSet(false),
+      staticCasterVersion(0), dynamicCasterCount(0)
+{
+    // graph nodes for everything right away, they are cheap and children need their parents' nodes
+    objects.resize(this->scene.objects.size());
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = this->scene.objects[i];
+        SceneObjectState &state = objects[i];
+        state.node = graph.AddNode(object.parent < 0 ? NO_PARENT : objects[object.parent].node);
+        graph.SetLocalTransform(state.node, object.position, glm::quat(glm::radians(object.rotation)), object.scale);
+        state.mesh = nullptr;
+        state.model = nullptr;
+        state.isReady = object.kind == EMPTY_OBJECT;
+        state.isVisible = true;
+        if (!state.isReady)
+            pending.push_back(i);
+    }
+    Prioritize(this->scene.cameraPosition);
+}
+
+SceneLoader::~SceneLoader()
+{
+    Clear();
+}
+
+void SceneLoader::Clear()
+{
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        delete objects[i].mesh;
+        delete objects[i].model;
+        objects[i].mesh = nullptr;
+        objects[i].model = nullptr;
+    }
+    if (!isCpuOnly) {
+        materialTable.Clear();
+        drawConstants.Clear();
+    }
+}
+
+void SceneLoader::SetTextureStreamer(TextureStreamer *streamer)
+{
+    textureStreamer = streamer;
+}
+
+void SceneLoader::SetThreadPool(ThreadPool *pool)
+{
+    threadPool = pool;
+}
+
+void SceneLoader::RequestTextureDetail(const glm::vec3 &viewPos, float focalPixels)
+{
+    if (!textureStreamer)
+        return;
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObjectState &state = objects[i];
+        glm::vec3 worldMin, worldMax;
+        if (!state.isReady || !state.isVisible || !worldBounds(state, worldMin, worldMax))
+            continue;
+        // the texture is assumed to span the object once, the bounding sphere gives its size on screen
+        float radius = glm::length(worldMax - worldMin) * 0.5f;
+        float distance = max(glm::length((worldMin + worldMax) * 0.5f - viewPos) - radius, 0.1f);
+        float screenSize = 2.f * radius * focalPixels / distance;
+        if (state.mesh) {
+            unsigned int array = materialTable.GetArrayTexture(scene.objects[i].material);
+            if (array)
+                textureStreamer->Request(array, screenSize);
+        } else if (state.model) {
+            for (unsigned int m = 0; m < state.model->meshes.size(); m++)
+                for (unsigned int t = 0; t < state.model->meshes[m].textures.size(); t++)
+                    textureStreamer->Request(state.model->meshes[m].textures[t].id, screenSize);
+        }
+    }
+}
+
+void SceneLoader::Prioritize(const glm::vec3 &viewPos)
+{
+    graph.UpdateWorldTransforms();
+    vector<pair<float, unsigned int> > order;
+    for (unsigned int i = 0; i < pending.size(); i++)
+    {
+        glm::vec3 position = glm::vec3(graph.GetWorldMatrix(objects[pending[i]].node)[3]);
+        order.push_back(make_pair(glm::length(position - viewPos), pending[i]));
+    }
+    // farthest first, ResolvePending takes from the back
+    sort(order.begin(), order.end());
+    reverse(order.begin(), order.end());
+    for (unsigned int i = 0; i < order.size(); i++)
+        pending[i] = order[i].second;
+}
+
+unsigned int SceneLoader::ResolvePending(double budgetMs)
+{
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    while (!pending.empty())
+    {
+        // the material textures come first, a material per step
+        if (!isCpuOnly && !materialTable.IsBuilt()) {
+            materialTable.BuildStep(scene, textureStreamer);
+        } else {
+            unsigned int object = pending.back();
+            pending.pop_back();
+            resolve(object);
+        }
+        if (std::chrono::duration<double, std::milli>(clock::now() - start).count() >= budgetMs)
+            break;
+    }
+    return pending.size();
+}
+
+void SceneLoader::ResolveAll()
+{
+    while (!pending.empty())
+    {
+        unsigned int object = pending.back();
+        pending.pop_back();
+        resolve(object);
+    }
+}
+
+unsigned int SceneLoader::PendingCount() const
+{
+    return pending.size();
+}
+
+void SceneLoader::SetLightPosition(const glm::vec3 &position)
+{
+    if (isLightPositionSet && position == lightPosition)
+        return;
+    lightPosition = position;
+    isLightPositionSet = true;
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        if (object.isFollowingLight)
+            graph.SetLocalTransform(objects[i].node, position, glm::quat(glm::radians(object.rotation)), object.scale);
+    }
+}
+
+void SceneLoader::CullOccluded(OcclusionCuller &culler, const glm::mat4 &viewProjection)
+{
+    culler.BeginFrame(viewProjection);
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObjectState &state = objects[i];
+        if (!state.isReady || !scene.objects[i].isOccluder)
+            continue;
+        if (state.mesh) {
+            culler.AddOccluder(graph.GetWorldMatrix(state.node), state.mesh->vertices, state.mesh->indices);
+        } else if (state.model) {
+            const vector<ModelNode> &nodes = state.model->nodes;
+            for (unsigned int n = 0; n < nodes.size(); n++)
+                for (unsigned int m = 0; m < nodes[n].meshes.size(); m++)
+                {
+                    const Mesh &mesh = state.model->meshes[nodes[n].meshes[m]];
+                    culler.AddOccluder(graph.GetWorldMatrix(state.modelNodes[n]), mesh.vertices, mesh.indices);
+                }
+        }
+    }
+    culler.Rasterize();
+
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        SceneObjectState &state = objects[i];
+        state.isVisible = true;
+        // an occluder would only test against itself
+        if (!state.isReady || state.boundsNodes.empty() || scene.objects[i].isOccluder)
+            continue;
+        glm::vec3 worldMin, worldMax;
+        worldBounds(state, worldMin, worldMax);
+        state.isVisible = culler.IsVisible(worldMin, worldMax);
+    }
+}
+
+void SceneLoader::ClearCulling()
+{
+    for (unsigned int i = 0; i < objects.size(); i++)
+        objects[i].isVisible = true;
+}
+
+void SceneLoader::Draw(SCENE_SHADING shading, Shader &shader)
+{
+    materialTable.ResetBindings();
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        if (!objects[i].isReady || !objects[i].isVisible || object.material < 0 || scene.materials[object.material].shading != shading)
+            continue;
+        drawObject(i, shader, false);
+    }
+}
+
+void SceneLoader::DrawDepth(SCENE_SHADING shading, Shader &shader)
+{
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        if (!objects[i].isReady || !objects[i].isVisible || object.material < 0 || scene.materials[object.material].shading != shading)
+            continue;
+        drawObject(i, shader, true);
+    }
+}
+
+void SceneLoader::DrawSoftware(SoftwareRenderer &renderer, bool isReflecting)
+{
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        const SceneObjectState &state = objects[i];
+        if (!state.isReady || !state.isVisible || object.material < 0)
+            continue;
+        SCENE_SHADING shading = scene.materials[object.material].shading;
+        if (state.mesh) {
+            SoftwareMaterial material = softwareMaterial(renderer, shading, state.mesh->textures, string(), isReflecting);
+            renderer.DrawMesh(*state.mesh, graph.GetWorldMatrix(state.node), material);
+        } else if (state.model) {
+            const Model &model = *state.model;
+            for (unsigned int n = 0; n < model.nodes.size(); n++)
+                for (unsigned int m = 0; m < model.nodes[n].meshes.size(); m++)
+                {
+                    const Mesh &mesh = model.meshes[model.nodes[n].meshes[m]];
+                    SoftwareMaterial material = softwareMaterial(renderer, shading, mesh.textures, model.directory, isReflecting);
+                    renderer.DrawMesh(mesh, graph.GetWorldMatrix(state.modelNodes[n]), material);
+                }
+        }
+    }
+}
+
+void SceneLoader::DrawShadowCasters(Shader &shader, bool dynamic)
+{
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        const SceneObject &object = scene.objects[i];
+        // the lamp sits right at the light, it would shadow everything
+        if (!objects[i].isReady || object.isFollowingLight || object.isDynamic != dynamic)
+            continue;
+        drawObject(i, shader, true);
+    }
+}
+
+bool SceneLoader::HasDynamicCasters() const
+{
+    return dynamicCasterCount > 0;
+}
+
+unsigned int SceneLoader::GetStaticCasterVersion() const
+{
+    return staticCasterVersion;
+}
+
+const SceneDescription &SceneLoader::GetDescription() const
+{
+    return scene;
+}
+
+const SceneObjectState &SceneLoader::GetObjectState(unsigned int object) const
+{
+    return objects[object];
+}
+
+void SceneLoader::resolve(unsigned int object)
+{
+    const SceneObject &description = scene.objects[object];
+    SceneObjectState &state = objects[object];
+    if (state.isReady)
+        return;
+    // GL meshes get their textures from the material table, the software renderer loads its own copies by path
+    // ResolvePending builds the table over several calls, ResolveAll finishes it here
+    if (!isCpuOnly && !materialTable.IsBuilt())
+        materialTable.Build(scene, textureStreamer);
+    vector<Texture> textures = isCpuOnly ? softwareTextures(scene.materials[description.material]) : vector<Texture>();
+    if (description.kind == QUAD_OBJECT) {
+        state.mesh = new Mesh(createQuadMesh(textures, isCpuOnly));
+    } else if (description.kind == CUBE_OBJECT) {
+        state.mesh = new Mesh(createCubeMesh(textures, isCpuOnly));
+    } else if (description.kind == MODEL_OBJECT) {
+        // models bring their own textures, only occluders keep their geometry in RAM for CullOccluded
+        state.model = new Model(description.modelPath, false, isCpuOnly, isCpuOnly ? nullptr : textureStreamer, description.isOccluder,
+                                threadPool);
+        state.modelNodes = state.model->AddToSceneGraph(graph, state.node);
+    }
+    if (state.mesh) {
+        state.mesh->SetOwner(description.name);
+        addBounds(state, state.node, vector<const Mesh *>(1, state.mesh));
+    } else if (state.model) {
+        for (unsigned int n = 0; n < state.model->nodes.size(); n++)
+        {
+            vector<const Mesh *> nodeMeshes;
+            for (unsigned int m = 0; m < state.model->nodes[n].meshes.size(); m++)
+                nodeMeshes.push_back(&state.model->meshes[state.model->nodes[n].meshes[m]]);
+            addBounds(state, state.modelNodes[n], nodeMeshes);
+        }
+    }
+    state.isReady = true;
+    if (description.isDynamic)
+        dynamicCasterCount++;
+    else if (!description.isFollowingLight)
+        staticCasterVersion++;
+}
+
+void SceneLoader::drawObject(unsigned int object, Shader &shader, bool isDepthOnly)
+{
+    SceneObjectState &state = objects[object];
+    // materials past the table have no textures in the shaders
+    int material = scene.objects[object].material < (int)MaterialTable::MAX_MATERIALS ? scene.objects[object].material : -1;
+    if (state.model) {
+        if (isDepthOnly)
+            state.model->DrawDepth(graph, state.modelNodes, drawConstants);
+        else
+            state.model->Draw(shader, graph, state.modelNodes, drawConstants, material);
+    } else if (state.mesh) {
+        drawConstants.Bind(graph.GetWorldMatrix(state.node), material);
+        if (isDepthOnly) {
+            state.mesh->DrawDepth();
+        } else {
+            materialTable.Use(material);
+            state.mesh->Draw(shader);
+        }
+    }
+}
+
+SoftwareMaterial SceneLoader::softwareMaterial(SoftwareRenderer &renderer, SCENE_SHADING shading, const vector<Texture> &textures,
+                                               const string &directory, bool isReflecting)
+{
+    SoftwareMaterial material;
+    material.diffuse = material.normal = material.specular = nullptr;
+    material.color = glm::vec3(1.f);
+    if (shading == REFLECTION_SHADING) {
+        material.shading = isReflecting ? SOFTWARE_REFLECTION : SOFTWARE_REFRACTION;
+        return material;
+    }
+    if (shading == LAMP_SHADING) {
+        material.shading = SOFTWARE_UNLIT;
+        return material;
+    }
+    // the relief of the parallax walls is left out, they are lit with their normal maps only
+    material.shading = SOFTWARE_NORMAL_MAPPED;
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        // scene material textures keep the full path, model ones are relative to the model file
+        string path = directory.empty() ? textures[i].path : directory + "/" + textures[i].path;
+        if (textures[i].type == "texture_diffuse" && !material.diffuse)
+            material.diffuse = renderer.LoadTexture(path);
+        else if (textures[i].type == "texture_normal" && !material.normal)
+            material.normal = renderer.LoadTexture(path);
+        else if (textures[i].type == "texture_specular" && !material.specular)
+            material.specular = renderer.LoadTexture(path);
+    }
+    return material;
+}
+
+void SceneLoader::addBounds(SceneObjectState &state, NodeId node, const vector<const Mesh *> &meshes)
+{
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    for (unsigned int m = 0; m < meshes.size(); m++)
+    {
+        boundsMin = glm::min(boundsMin, meshes[m]->boundsMin);
+        boundsMax = glm::max(boundsMax, meshes[m]->boundsMax);
+    }
+    if (boundsMin.x > boundsMax.x)
+        return;
+    state.boundsNodes.push_back(node);
+    state.boundsMin.push_back(boundsMin);
+    state.boundsMax.push_back(boundsMax);
+}
+
+vector<Texture> SceneLoader::softwareTextures(const SceneMaterial &material) const
+{
+    vector<Texture> textures;
+    for (unsigned int i = 0; i < material.textures.size(); i++)
+    {
+        Texture texture;
+        texture.id = 0;
+        texture.type = material.textures[i].type;
+        texture.path = material.textures[i].path;
+        textures.push_back(texture);
+    }
+    return textures;
+}
+
+bool SceneLoader::worldBounds(const SceneObjectState &state, glm::vec3 &worldMin, glm::vec3 &worldMax) const
+{
+    worldMin = glm::vec3(1e30f);
+    worldMax = glm::vec3(-1e30f);
+    for (unsigned int b = 0; b < state.boundsNodes.size(); b++)
+    {
+        const glm::mat4 &world = graph.GetWorldMatrix(state.boundsNodes[b]);
+        for (unsigned int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner((c & 1) ? state.boundsMax[b].x : state.boundsMin[b].x,
+                             (c & 2) ? state.boundsMax[b].y : state.boundsMin[b].y,
+                             (c & 4) ? state.boundsMax[b].z : state.boundsMin[b].z);
+            glm::vec3 worldCorner = glm::vec3(world * glm::vec4(corner, 1.f));
+            worldMin = glm::min(worldMin, worldCorner);
+            worldMax = glm::max(worldMax, worldCorner);
+        }
+    }
+    return !state.boundsNodes.empty();
+}
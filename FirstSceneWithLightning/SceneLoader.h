@@ -0,0 +1,116 @@
+#pragma once
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include "SceneDescription.h"
+#include "SceneGraph.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "Shader.h"
+#include "OcclusionCulling.h"
+#include "SoftwareRenderer.h"
+#include "TextureStreaming.h"
+#include "MaterialTable.h"
+#include "DrawConstants.h"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct SceneObjectState {
+    NodeId node;
+    Mesh *mesh;                 // quads and cubes
+    Model *model;               // MODEL_OBJECT
+    vector<NodeId> modelNodes;  // graph nodes of the model's own hierarchy
+    // local bounding boxes of the graph nodes that have meshes, the object's world box is the union of them
+    vector<NodeId> boundsNodes;
+    vector<glm::vec3> boundsMin, boundsMax;
+    bool isReady;
+    bool isVisible;             // false while the occlusion culler found it hidden
+};
+
+// Turns a scene description into graph nodes right away and into meshes, models and textures lazily.
+// Objects are loaded a few at a time in order of distance from a point (the camera), nearest first,
+// so the first frame comes up quickly and the rest of the scene appears over the next frames.
+// Not yet loaded objects are simply not drawn.
+class SceneLoader
+{
+public:
+    // a CPU-only loader creates no GL objects and can only draw with DrawSoftware, it needs no GL context
+    SceneLoader(const SceneDescription &scene, SceneGraph &graph, bool isCpuOnly = false);
+    ~SceneLoader();
+    // deletes the loaded meshes, models and the GL objects of the loader while the context is still alive,
+    // nothing is drawn afterwards
+    void Clear();
+
+    // material and model textures of objects resolved from now on go through the streamer instead of loading whole
+    void SetTextureStreamer(TextureStreamer *streamer);
+    // models resolved from now on generate the tangents of big meshes on the pool, it has to outlive the loading
+    void SetThreadPool(ThreadPool *pool);
+    // tells the streamer how many pixels across each visible object's textures cover, focalPixels is
+    // projection[1][1] * viewport height / 2 (the on-screen size of one unit at distance 1)
+    void RequestTextureDetail(const glm::vec3 &viewPos, float focalPixels);
+
+    // orders the objects that aren't loaded yet, nearest to viewPos first
+    void Prioritize(const glm::vec3 &viewPos);
+    // decodes the material textures a material at a time, then loads pending objects, until budgetMs is spent
+    // (at least one step per call), returns how many objects are still pending
+    unsigned int ResolvePending(double budgetMs);
+    // loads everything that is left
+    void ResolveAll();
+    unsigned int PendingCount() const;
+
+    // moves the follow_light objects, only touches the graph if the position changed
+    void SetLightPosition(const glm::vec3 &position);
+    // rasterizes the loaded occluders and tests every other object against them, Draw and DrawDepth
+    // skip the hidden ones until the next call. Shadow casters are always drawn, the light sees other things.
+    void CullOccluded(OcclusionCuller &culler, const glm::mat4 &viewProjection);
+    // makes every object drawable again
+    void ClearCulling();
+    // draws every loaded, visible object of this shading with its DrawConstants, the shader has to be in use
+    void Draw(SCENE_SHADING shading, Shader &shader);
+    // same with positions only and no textures, for depth-only passes
+    void DrawDepth(SCENE_SHADING shading, Shader &shader);
+    // draws every loaded, visible object with the software renderer, the bench reflects the skybox or refracts it
+    void DrawSoftware(SoftwareRenderer &renderer, bool isReflecting);
+    // draws the loaded shadow casters into a depth-only pass, either the static ones or the dynamic ones
+    void DrawShadowCasters(Shader &shader, bool dynamic);
+    bool HasDynamicCasters() const;
+    // changes whenever a static shadow caster appears, cached shadow maps are out of date then
+    unsigned int GetStaticCasterVersion() const;
+
+    const SceneDescription &GetDescription() const;
+    const SceneObjectState &GetObjectState(unsigned int object) const;
+
+private:
+    SceneDescription scene;
+    SceneGraph &graph;
+    bool isCpuOnly;
+    vector<SceneObjectState> objects;
+    // object indices waiting to be loaded, the next one is at the back
+    vector<unsigned int> pending;
+    // textures of the scene materials, built before the first object
+    MaterialTable materialTable;
+    // model matrices and materials of the draws
+    DrawConstantRing drawConstants;
+    TextureStreamer *textureStreamer;
+    ThreadPool *threadPool;
+    glm::vec3 lightPosition;
+    bool isLightPositionSet;
+    unsigned int staticCasterVersion;
+    unsigned int dynamicCasterCount;
+
+    void resolve(unsigned int object);
+    void drawObject(unsigned int object, Shader &shader, bool isDepthOnly);
+    SoftwareMaterial softwareMaterial(SoftwareRenderer &renderer, SCENE_SHADING shading, const vector<Texture> &textures,
+                                      const string &directory, bool isReflecting);
+    void addBounds(SceneObjectState &state, NodeId node, const vector<const Mesh *> &meshes);
+    // union of the object's boxes in world space, false if it has none
+    bool worldBounds(const SceneObjectState &state, glm::vec3 &worldMin, glm::vec3 &worldMax) const;
+    // paths of the material's textures for the software renderer, nothing is loaded
+    vector<Texture> softwareTextures(const SceneMaterial &material) const;
+};
+#endif
@@ -1,48 +1,19 @@
 #include "Shader.h"
+#include "Log.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+
+#include <set>
+#include <vector>
 // constructor generates the shader on the fly
 // ------------------------------------------------------------------------
 Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
 {
     // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::string geometryCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    std::ifstream gShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // if geometry shader path is present, also load a geometry shader
-        if (geometryPath != nullptr)
-        {
-            gShaderFile.open(geometryPath);
-            std::stringstream gShaderStream;
-            gShaderStream << gShaderFile.rdbuf();
-            gShaderFile.close();
-            geometryCode = gShaderStream.str();
-        }
-    }
-    catch (std::ifstream::failure e)
-    {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-    }
+    std::string vertexCode = LoadSource(vertexPath);
+    std::string fragmentCode = LoadSource(fragmentPath);
+    // if geometry shader path is present, also load a geometry shader
+    std::string geometryCode = geometryPath != nullptr ? LoadSource(geometryPath) : std::string();
     const char* vShaderCode = vertexCode.c_str();
     const char * fShaderCode = fragmentCode.c_str();
     // 2. compile shaders
@@ -75,6 +46,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
         glAttachShader(ID, geometry);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    GpuResourceRegistry::Get().Add(GPU_PROGRAM, ID, 0, vertexPath);
     // delete the shaders as they're linked into our program now and no longer necessery
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -82,72 +54,211 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
         glDeleteShader(geometry);
 
 }
+// constructor generates a compute shader program on the fly
+// ------------------------------------------------------------------------
+Shader::Shader(const char* computePath)
+{
+    std::string computeCode = LoadSource(computePath);
+    const char* cShaderCode = computeCode.c_str();
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    checkCompileErrors(ID, "PROGRAM");
+    GpuResourceRegistry::Get().Add(GPU_PROGRAM, ID, 0, computePath);
+    glDeleteShader(compute);
+}
+// reads the whole file, empty if it can't be read
+// ------------------------------------------------------------------------
+static bool readFile(const std::string &path, std::string &text)
+{
+    std::ifstream file;
+    // ensure ifstream objects can throw exceptions:
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try
+    {
+        file.open(path);
+        std::stringstream stream;
+        // read file's buffer contents into streams
+        stream << file.rdbuf();
+        file.close();
+        text = stream.str();
+        return true;
+    }
+    catch (std::ifstream::failure e)
+    {
+        LOG(LOG_ERROR) << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path;
+        return false;
+    }
+}
+// "Shaders/NormalMapping/../Common/x.glsl" to "Shaders/Common/x.glsl", so every file has one name
+// ------------------------------------------------------------------------
+static std::string normalizePath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    std::istringstream stream(path);
+    std::string part;
+    while (std::getline(stream, part, '/'))
+    {
+        if (part == ".." && !parts.empty() && parts.back() != "..")
+            parts.pop_back();
+        else if (part != "." && !part.empty())
+            parts.push_back(part);
+    }
+    std::string normalized = !path.empty() && path[0] == '/' ? "/" : "";
+    for (unsigned int i = 0; i < parts.size(); i++)
+        normalized += (i ? "/" : "") + parts[i];
+    return normalized;
+}
+// the file with every #include "path" line replaced by that file, paths are relative to the including file.
+// Like #pragma once, a file already in included is left out the second time
+// ------------------------------------------------------------------------
+static std::string loadWithIncludes(const std::string &path, std::set<std::string> &included)
+{
+    std::string text;
+    if (!readFile(path, text))
+        return std::string();
+    included.insert(path);
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream lines(text);
+    std::ostringstream source;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(lines, line))
+    {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            source << line << '\n';
+            continue;
+        }
+        size_t open = line.find('"', start), close = line.find('"', open + 1);
+        if (open == std::string::npos || close == std::string::npos) {
+            LOG(LOG_ERROR) << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << lineNumber;
+            source << '\n';
+            continue;
+        }
+        std::string includePath = normalizePath(directory + line.substr(open + 1, close - open - 1));
+        if (included.count(includePath)) {
+            source << '\n'; // keeps the line numbers
+            continue;
+        }
+        // the driver's messages keep the line numbers of each file
+        source << "#line 1\n" << loadWithIncludes(includePath, included) << "#line " << lineNumber + 1 << '\n';
+    }
+    return source.str();
+}
+// ------------------------------------------------------------------------
+std::string Shader::LoadSource(const char* path)
+{
+    std::set<std::string> included;
+    return loadWithIncludes(normalizePath(path), included);
+}
 // activate the shader
 // ------------------------------------------------------------------------
 void Shader::Use()
 {
-    glUseProgram(ID);
+    GlStats::UseProgram(ID);
+}
+// ------------------------------------------------------------------------
+void Shader::Delete()
+{
+    GpuResourceRegistry::Get().Remove(GPU_PROGRAM, ID);
+    glDeleteProgram(ID);
+    ID = 0;
 }
 // utility uniform functions
 // ------------------------------------------------------------------------
 void Shader::setBool(const std::string &name, bool value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform1i(glGetUniformLocation(this->ID, name.c_str()), (int)value);
 }
 // ------------------------------------------------------------------------
 void Shader::setInt(const std::string &name, int value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform1i(glGetUniformLocation(this->ID, name.c_str()), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setFloat(const std::string &name, float value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 }
+void Shader::setFloatArray(const std::string &name, const float *values, int count) const
+{
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
+    glUniform1fv(glGetUniformLocation(ID, name.c_str()), count, values);
+}
 // ------------------------------------------------------------------------
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
 }
 void Shader::setVec2(const std::string &name, float x, float y) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
 }
 void Shader::setVec3(const std::string &name, float x, float y, float z) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
 }
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w)
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
 {
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 
 
+// one log line per line of the driver's message, a log line holds LogRecord::TEXT_SIZE characters
+// ------------------------------------------------------------------------
+static void logInfoLog(const std::string &infoLog)
+{
+    std::istringstream lines(infoLog);
+    std::string line;
+    while (std::getline(lines, line))
+        if (!line.empty())
+            LOG(LOG_ERROR) << "  " << line;
+    LOG(LOG_ERROR) << " -- --------------------------------------------------- -- ";
+}
+
 // utility function for checking shader compilation/linking errors.
 // ------------------------------------------------------------------------
 void Shader::checkCompileErrors(GLuint shader, std::string type)
@@ -160,7 +271,8 @@ void Shader::checkCompileErrors(GLuint shader, std::string type)
         if (!success)
         {
             glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            LOG(LOG_ERROR) << "ERROR::SHADER_COMPILATION_ERROR of type: " << type;
+            logInfoLog(infoLog);
         }
     }
     else
@@ -169,7 +281,8 @@ void Shader::checkCompileErrors(GLuint shader, std::string type)
         if (!success)
         {
             glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            LOG(LOG_ERROR) << "ERROR::PROGRAM_LINKING_ERROR of type: " << type;
+            logInfoLog(infoLog);
         }
     }
 }
\ No newline at end of file
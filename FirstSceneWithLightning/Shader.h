@@ -1,7 +1,7 @@
 #ifndef SHADER_H
 #define SHADER_H
 
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include <glm/glm.hpp>
 
 #include <string>
@@ -16,9 +16,18 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    // constructor generates a compute shader program on the fly, needs GL 4.3 or ARB_compute_shader
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath);
+    // source code of a shader file with its #include "file" lines expanded, the constructors use it
+    // ------------------------------------------------------------------------
+    static std::string LoadSource(const char* path);
     // activate the shader
     // ------------------------------------------------------------------------
     void Use();
+    // deletes the program, copies of the object are left with a dead ID
+    // ------------------------------------------------------------------------
+    void Delete();
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const;
@@ -26,6 +35,8 @@ public:
     void setInt(const std::string &name, int value) const;
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const;
+    // a whole float array uniform in one call, count elements from its first one
+    void setFloatArray(const std::string &name, const float *values, int count) const;
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const;
     void setVec2(const std::string &name, float x, float y) const;
@@ -0,0 +1,30 @@
+// clustered lights, filled by ClusteredLighting every frame
+uniform samplerBuffer lightData;       // 3 texels per light: position and radius, color and spot inner cos, spot direction and outer cos
+uniform usamplerBuffer clusterRanges;  // offset and count in clusterLights per cluster
+uniform usamplerBuffer clusterLights;  // light indices
+uniform ivec3 clusterCount;
+uniform vec2 clusterScreenSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+uvec2 getClusterRange(float viewDepth) {
+    int slice = clamp(int(log(viewDepth) * clusterSliceScale + clusterSliceBias), 0, clusterCount.z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterScreenSize * vec2(clusterCount.xy)), ivec2(0), clusterCount.xy - 1);
+    return texelFetch(clusterRanges, tile.x + clusterCount.x * (tile.y + clusterCount.y * slice)).rg;
+}
+
+// color of the light reaching fragPos and the direction to it, black if the light doesn't reach
+vec3 getLight(int light, vec3 fragPos, out vec3 lightDir) {
+    vec4 positionRadius = texelFetch(lightData, light * 3);
+    vec4 colorInner = texelFetch(lightData, light * 3 + 1);
+    vec4 directionOuter = texelFetch(lightData, light * 3 + 2);
+    vec3 toLight = positionRadius.xyz - fragPos;
+    float distance2 = dot(toLight, toLight);
+    lightDir = toLight * inversesqrt(max(distance2, 1e-8));
+    // smooth falloff to exactly zero at the radius, the clusters are built for that radius
+    float window = clamp(1.0 - distance2 / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+    float attenuation = window * window;
+    if (directionOuter.w > -1.0)
+        attenuation *= smoothstep(directionOuter.w, colorInner.w, dot(-lightDir, directionOuter.xyz));
+    return colorInner.rgb * attenuation;
+}
@@ -0,0 +1,6 @@
+// per-draw constants, see DrawConstantRing
+layout(std140) uniform DrawConstants {
+    mat4 model;
+    mat3 normalMatrix; // transpose(inverse(mat3(model))), computed once per draw
+    int materialIndex;
+};
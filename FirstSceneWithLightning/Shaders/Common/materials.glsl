@@ -0,0 +1,12 @@
+// material textures, one layer of materialTextures per texture, see MaterialTable
+#include "draw_constants.glsl"
+
+uniform sampler2DArray materialTextures;
+layout(std140) uniform Materials {
+    ivec4 materialLayers[64]; // MaterialTable::MAX_MATERIALS; diffuse and packed maps (z, w unused), -1 if the material has no such texture
+};
+
+vec4 sampleMaterial(int map, vec2 texCoords, vec4 fallback) {
+    int layer = materialIndex < 0 ? -1 : materialLayers[materialIndex][map];
+    return layer < 0 ? fallback : texture(materialTextures, vec3(texCoords, float(layer)));
+}
@@ -0,0 +1,8 @@
+// packed maps: normal X and Y in red and green, height in blue, specular in alpha (see TexturePacking.h)
+const vec4 flatMaps = vec4(0.5, 0.5, 0.0, 1.0);
+
+// the packed normal has no Z, it is rebuilt from the unit length
+vec3 unpackNormal(vec4 maps) {
+    vec2 xy = maps.rg * 2.0 - 1.0;
+    return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
@@ -0,0 +1,38 @@
+// omnidirectional shadow of light 0, see PointShadowMap
+uniform samplerCube shadowStatic;   // distance to the light / shadowFarPlane of the static casters
+uniform samplerCube shadowDynamic;  // same for the moving casters
+uniform int shadowState;            // 0 - no shadows, 1 - static layer only, 2 - both layers
+uniform vec3 shadowLightPos;
+uniform float shadowFarPlane;
+
+const vec3 shadowSampleOffsets[20] = vec3[](
+    vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
+    vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+    vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+    vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+);
+
+// 1 if fragPos is lit by light 0, 0 if it is in its shadow, soft edges in between
+float getShadow(vec3 fragPos, vec3 normal, float viewDistance) {
+    if (shadowState == 0)
+        return 1.0;
+    vec3 fromLight = fragPos - shadowLightPos;
+    float currentDepth = length(fromLight);
+    if (currentDepth >= shadowFarPlane)
+        return 1.0;
+    // surfaces at a grazing angle to the light need a bigger bias against acne
+    float bias = max(0.05 * (1.0 - dot(normal, -fromLight / currentDepth)), 0.01);
+    // sharper up close, softer far away where the map's texels are large on screen anyway
+    float diskRadius = (1.0 + viewDistance / shadowFarPlane) / 25.0;
+    float lit = 0.0;
+    for (int i = 0; i < 20; i++)
+    {
+        vec3 direction = fromLight + shadowSampleOffsets[i] * diskRadius;
+        float closestDepth = texture(shadowStatic, direction).r;
+        if (shadowState == 2)
+            closestDepth = min(closestDepth, texture(shadowDynamic, direction).r);
+        lit += currentDepth - bias > closestDepth * shadowFarPlane ? 0.0 : 1.0;
+    }
+    return lit / 20.0;
+}
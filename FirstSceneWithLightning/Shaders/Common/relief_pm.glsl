@@ -0,0 +1,52 @@
+// Relief parallax mapping over the height in the packed maps, expects sampleMaterial declared before.
+// The depth pre-pass runs it too, it has to discard exactly the fragments the lit pass discards.
+#include "packed_maps.glsl"
+
+uniform float heightScale;
+
+vec2 ReliefPM(vec2 inTexCoords, vec3 inViewDir, out float lastDepthValue) {
+	const float _minLayers = 2.;
+	const float _maxLayers = 32.;
+	float _numLayers = mix(_maxLayers, _minLayers, abs(dot(vec3(0., 0., 1.), inViewDir)));
+
+	float deltaDepth = 1./_numLayers;
+	vec2 deltaTexcoord = heightScale * inViewDir.xy/(inViewDir.z * _numLayers);
+
+	vec2 currentTexCoords = inTexCoords;
+	float currentLayerDepth = 0.;
+
+	float currentDepthValue = sampleMaterial(1, currentTexCoords, flatMaps).b;
+	while (currentDepthValue > currentLayerDepth) {
+		currentLayerDepth += deltaDepth;
+		currentTexCoords -= deltaTexcoord;
+		currentDepthValue = sampleMaterial(1, currentTexCoords, flatMaps).b;
+	}
+// ======
+// Relief PM 
+// ======
+
+	deltaTexcoord *= 0.5;
+	deltaDepth *= 0.5;
+
+	currentTexCoords += deltaTexcoord;
+	currentLayerDepth -= deltaDepth;
+
+	const int _reliefSteps = 5;
+	int currentStep = _reliefSteps;
+	while (currentStep > 0) {
+		currentDepthValue = sampleMaterial(1, currentTexCoords, flatMaps).b;
+		deltaTexcoord *= 0.5;
+		deltaDepth *= 0.5;
+		if (currentDepthValue > currentLayerDepth) {
+			currentTexCoords -= deltaTexcoord;
+			currentLayerDepth += deltaDepth;
+		}
+		else {
+			currentTexCoords += deltaTexcoord;
+			currentLayerDepth -= deltaDepth;
+		}
+		currentStep--;
+	}
+	lastDepthValue = currentDepthValue;
+	return currentTexCoords;
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+void main()
+{
+    // depth only, the color writes are masked off during the pre-pass
+}
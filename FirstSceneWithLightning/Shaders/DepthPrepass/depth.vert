@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// the color pass shaders compute gl_Position with the very same expression, the GL_EQUAL depth test relies on it
+invariant gl_Position;
+
+#include "../Common/draw_constants.glsl"
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPosition;
+}
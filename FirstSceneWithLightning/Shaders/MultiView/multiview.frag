@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in GS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    flat int View;
+} fs_in;
+
+#include "../Common/materials.glsl"
+
+uniform vec3 viewPositions[4];
+uniform vec3 lightPos;
+
+void main()
+{
+    // the clusters are built for the main camera only, the extra views are lit by the lamp alone
+    vec3 color = sampleMaterial(0, fs_in.TexCoords, vec4(1.0)).rgb;
+    vec3 normal = normalize(fs_in.Normal);
+    vec3 lightDir = normalize(lightPos - fs_in.FragPos);
+    vec3 viewDir = normalize(viewPositions[fs_in.View] - fs_in.FragPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float diffuse = max(dot(lightDir, normal), 0.0);
+    float specular = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+    FragColor = vec4(color * (0.1 + diffuse) + vec3(0.2) * specular, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out VS_OUT {
+    vec3 Normal;
+    vec2 TexCoords;
+} vs_out;
+
+#include "../Common/draw_constants.glsl"
+
+void main()
+{
+    vs_out.Normal = normalMatrix * aNormal;
+    vs_out.TexCoords = aTexCoords;
+    // world space, the geometry shader projects into every view
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -4,32 +4,45 @@ out vec4 FragColor;
 in VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
-    vec3 TangentViewPos;
-    vec3 TangentFragPos;
+    mat3 TBN;
+    float ViewDepth;
 } fs_in;
 
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_normal1;
-uniform sampler2D texture_specular1;
+#include "../Common/materials.glsl"
+
+#include "../Common/packed_maps.glsl"
+
+uniform vec3 viewPos;
+
+#include "../Common/clustered_lights.glsl"
+
+#include "../Common/point_shadow.glsl"
 
 void main()
 {           
-    vec3 normal = texture(texture_normal1, fs_in.TexCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
+    vec4 maps = sampleMaterial(1, fs_in.TexCoords, flatMaps);
+    vec3 normal = unpackNormal(maps);  // this normal is in tangent space
+    normal = normalize(fs_in.TBN * normal);
    
-    vec3 color = texture(texture_diffuse1, fs_in.TexCoords).rgb;
+    vec3 color = sampleMaterial(0, fs_in.TexCoords, vec4(1.0)).rgb;
+    vec3 specularColor = vec3(0.2f * maps.a);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
     // ambient
-    vec3 ambient = 0.1 * color;
-    // diffuse
-    vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos);
-    vec3 diffuse =  max(dot(lightDir, normal), 0.0) * color;
-    // specular
-    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
-    vec3 halfwayDir = normalize(lightDir + viewDir);  
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-
-    vec3 specular = vec3(0.2f) * spec * vec3(texture(texture_specular1, fs_in.TexCoords));
-    FragColor = vec4(ambient + diffuse + specular, 1.0);
+    vec3 result = 0.1 * color;
+    uvec2 range = getClusterRange(fs_in.ViewDepth);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        vec3 lightDir;
+        int light = int(texelFetch(clusterLights, int(range.x + i)).r);
+        vec3 radiance = getLight(light, fs_in.FragPos, lightDir);
+        if (light == 0)
+            radiance *= getShadow(fs_in.FragPos, normal, length(viewPos - fs_in.FragPos));
+        // diffuse
+        vec3 diffuse = max(dot(lightDir, normal), 0.0) * color;
+        // specular
+        vec3 halfwayDir = normalize(lightDir + viewDir);  
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+        result += radiance * (diffuse + spec * specularColor);
+    }
+    FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -8,34 +8,32 @@ layout (location = 4) in vec3 aBitangent;
 out VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
-    vec3 TangentViewPos;
-    vec3 TangentFragPos;
+    mat3 TBN;
+    float ViewDepth;
 } vs_out;
 
+// gl_Position is computed exactly like in DepthPrepass/depth.vert, the color pass tests depth with GL_EQUAL
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
-
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "../Common/draw_constants.glsl"
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+    vs_out.FragPos = vec3(worldPosition);   
     vs_out.TexCoords = aTexCoords;
     
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
     vec3 T = normalize(normalMatrix * aTangent);
     vec3 N = normalize(normalMatrix * aNormal);
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
     
-    mat3 TBN = transpose(mat3(T, B, N));    
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
-    vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+    // lights are in world space now, normals from the map are brought there instead of every light into tangent space
+    vs_out.TBN = mat3(T, B, N);
+    vs_out.ViewDepth = -(view * worldPosition).z;
         
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPosition;
 }
 
@@ -7,14 +7,22 @@ in VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+    mat3 TBN;
+    float ViewDepth;
 } fs_in;
 
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_normal1;
-uniform sampler2D texture_height1;
+#include "../Common/materials.glsl"
+
+#include "../Common/packed_maps.glsl"
+
+#include "../Common/relief_pm.glsl"
 
-uniform float heightScale;
 uniform int selfShadowState;
+uniform vec3 viewPos;
+
+#include "../Common/clustered_lights.glsl"
+
+#include "../Common/point_shadow.glsl"
 
 float getParallaxSelfShadow(vec2 inTexCoords, vec3 inLightDir, float inLastDepth) {
 	float shadowMultiplier = 0.;
@@ -31,7 +39,7 @@ float getParallaxSelfShadow(vec2 inTexCoords, vec3 inLightDir, float inLastDepth
 		float currentLayerDepth = inLastDepth - _dDepth;
 		vec2 currentTexCoords = inTexCoords + _dtex;
 
-		float currentDepthValue = texture(texture_height1, currentTexCoords).r;
+		float currentDepthValue = sampleMaterial(1, currentTexCoords, flatMaps).b;
 
 		float stepIndex = 1.;
 		while (currentLayerDepth > 0.) {
@@ -44,7 +52,7 @@ float getParallaxSelfShadow(vec2 inTexCoords, vec3 inLightDir, float inLastDepth
 			stepIndex++;
 			currentLayerDepth -= _dDepth;
 			currentTexCoords += _dtex;
-			currentDepthValue = texture(texture_height1, currentTexCoords).r;
+			currentDepthValue = sampleMaterial(1, currentTexCoords, flatMaps).b;
 		}
 		if (numSamplesUnderSurface < 1)
 			shadowMultiplier = 1.;
@@ -55,58 +63,11 @@ float getParallaxSelfShadow(vec2 inTexCoords, vec3 inLightDir, float inLastDepth
 	return shadowMultiplier;
 }
 
-vec2 ReliefPM(vec2 inTexCoords, vec3 inViewDir, out float lastDepthValue) {
-	const float _minLayers = 2.;
-	const float _maxLayers = 32.;
-	float _numLayers = mix(_maxLayers, _minLayers, abs(dot(vec3(0., 0., 1.), inViewDir)));
-
-	float deltaDepth = 1./_numLayers;
-	vec2 deltaTexcoord = heightScale * inViewDir.xy/(inViewDir.z * _numLayers);
-
-	vec2 currentTexCoords = inTexCoords;
-	float currentLayerDepth = 0.;
-
-	float currentDepthValue = texture(texture_height1, currentTexCoords).r;
-	while (currentDepthValue > currentLayerDepth) {
-		currentLayerDepth += deltaDepth;
-		currentTexCoords -= deltaTexcoord;
-		currentDepthValue = texture(texture_height1, currentTexCoords).r;
-	}
-// ======
-// Relief PM 
-// ======
-
-	deltaTexcoord *= 0.5;
-	deltaDepth *= 0.5;
-
-	currentTexCoords += deltaTexcoord;
-	currentLayerDepth -= deltaDepth;
-
-	const int _reliefSteps = 5;
-	int currentStep = _reliefSteps;
-	while (currentStep > 0) {
-		currentDepthValue = texture(texture_height1, currentTexCoords).r;
-		deltaTexcoord *= 0.5;
-		deltaDepth *= 0.5;
-		if (currentDepthValue > currentLayerDepth) {
-			currentTexCoords -= deltaTexcoord;
-			currentLayerDepth += deltaDepth;
-		}
-		else {
-			currentTexCoords += deltaTexcoord;
-			currentLayerDepth -= deltaDepth;
-		}
-		currentStep--;
-	}
-	lastDepthValue = currentDepthValue;
-	return currentTexCoords;
-}
-
 void main()
 {           
     // offset texture coordinates with Parallax Mapping
     vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
-	vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos);
+	vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos); // self-shadowing light
     vec2 texCoords = fs_in.TexCoords;
     
 	float lastDepthValue;
@@ -114,27 +75,34 @@ void main()
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
     // obtain normal from normal map
-    vec3 normal = texture(texture_normal1, texCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);   
+    vec3 normal = unpackNormal(sampleMaterial(1, texCoords, flatMaps));
    
     // get diffuse color
-    vec3 color = texture(texture_diffuse1, texCoords).rgb;
+    vec3 color = sampleMaterial(0, texCoords, vec4(1.0)).rgb;
     // ambient
     vec3 ambient = 0.1f * color;
-    // diffuse
-   
-    float diff = max(dot(lightDir, normal), 0.0);
-    vec3 diffuse = diff * color;
-    // specular    
-    vec3 reflectDir = reflect(-lightDir, normal);
-    vec3 halfwayDir = normalize(lightDir + viewDir);  
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+    // diffuse and specular of every light of the cluster, in world space
+    vec3 worldNormal = normalize(fs_in.TBN * normal);
+    vec3 worldViewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 lighting = vec3(0.0);
+    uvec2 range = getClusterRange(fs_in.ViewDepth);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        vec3 worldLightDir;
+        int light = int(texelFetch(clusterLights, int(range.x + i)).r);
+        vec3 radiance = getLight(light, fs_in.FragPos, worldLightDir);
+        if (light == 0)
+            radiance *= getShadow(fs_in.FragPos, worldNormal, length(viewPos - fs_in.FragPos));
+        float diff = max(dot(worldLightDir, worldNormal), 0.0);
+        vec3 halfwayDir = normalize(worldLightDir + worldViewDir);  
+        float spec = pow(max(dot(worldNormal, halfwayDir), 0.0), 32.0);
+        lighting += radiance * (diff * color + vec3(0.2) * spec);
+    }
 	float selfShadowCoeff;
 	if (selfShadowState == 1) {
 		selfShadowCoeff = getParallaxSelfShadow(texCoords, lightDir, lastDepthValue);
 	} else {
 		selfShadowCoeff = 1.;
 	}
-    vec3 specular = vec3(0.2) * spec;
-    FragColor = vec4((ambient + diffuse + specular) * selfShadowCoeff, 1.0);
+    FragColor = vec4((ambient + lighting) * selfShadowCoeff, 1.0);
 }
\ No newline at end of file
@@ -11,28 +11,36 @@ out VS_OUT {
     vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+    mat3 TBN;
+    float ViewDepth;
 } vs_out;
 
+// also used by the pre-pass (with pm_quad_depth.frag), invariant keeps it equal to the color pass anyway
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
+#include "../Common/draw_constants.glsl"
 
-uniform vec3 lightPos;
+uniform vec3 lightPos; // the light that casts the parallax self-shadows
 uniform vec3 viewPos;
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+    vs_out.FragPos = vec3(worldPosition);   
     vs_out.TexCoords = aTexCoords;   
     
     vec3 T = normalize(mat3(model) * aTangent);
     vec3 B = normalize(mat3(model) * aBitangent);
-    vec3 N = normalize(mat3(model) * aNormal);
+    vec3 N = normalize(normalMatrix * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
 
     vs_out.TangentLightPos = TBN * lightPos;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+    vs_out.TBN = mat3(T, B, N);
+    vs_out.ViewDepth = -(view * worldPosition).z;
     
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPosition;
 }
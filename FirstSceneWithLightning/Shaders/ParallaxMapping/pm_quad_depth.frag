@@ -0,0 +1,29 @@
+#version 330 core
+// Depth pre-pass variant of pm_quad.frag. The parallax quad discards fragments whose offset texture
+// coordinates leave the texture, so its depth can't be laid down with positions only: the pre-pass
+// has to discard exactly the same fragments, otherwise the GL_EQUAL color pass leaves holes.
+// ReliefPM is shared with pm_quad.frag through Common/relief_pm.glsl, the lighting, shadows and color output are left out.
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentLightPos;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+    mat3 TBN;
+    float ViewDepth;
+} fs_in;
+
+#include "../Common/materials.glsl"
+
+#include "../Common/packed_maps.glsl"
+#include "../Common/relief_pm.glsl"
+
+void main()
+{
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+	float lastDepthValue;
+    vec2 texCoords = ReliefPM(fs_in.TexCoords, viewDir, lastDepthValue);
+    if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        discard;
+}
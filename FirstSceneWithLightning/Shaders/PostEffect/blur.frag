@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+#define MAX_RADIUS 32
+
+uniform sampler2D screenTexture;
+uniform vec2 axis; // (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform int radius;
+uniform float weights[MAX_RADIUS + 1];
+
+void main()
+{
+    vec2 direction = axis / vec2(textureSize(screenTexture, 0));
+    vec3 col = texture(screenTexture, TexCoords).rgb * weights[0];
+    for (int i = 1; i <= radius; i++)
+    {
+        col += texture(screenTexture, TexCoords + direction * i).rgb * weights[i];
+        col += texture(screenTexture, TexCoords - direction * i).rgb * weights[i];
+    }
+    FragColor = vec4(col, 1.0);
+}
@@ -3,17 +3,13 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform int isOn;
 uniform sampler2D screenTexture;
+uniform float gamma; // 1.0 unless the gamma effect is fused into this pass
 
 const float offset = 1.0 / 300.0;  
 
 void main()
 {
-	if (isOn == 0) {
-		FragColor = vec4(texture(screenTexture, TexCoords).rgb, 1.0);
-		return;
-	}
     vec2 offsets[9] = vec2[](
         vec2(-offset,  offset), // top-left
         vec2( 0.0f,    offset), // top-center
@@ -37,9 +33,11 @@ void main()
     {
         sampleTex[i] = vec3(texture(screenTexture, TexCoords.st + offsets[i]));
     }
+    // the vignette weight is the same for all taps, compute it once instead of per tap
+    float vignette = 1 - length(TexCoords*2 - 1);
     vec3 col = vec3(0.0);
     for(int i = 0; i < 9; i++)
-        col += sampleTex[i]  *  (kernel[i] + 6 * (i == 4 ? (1 - length(TexCoords*2 - 1)) / 2 : -(1 - length(TexCoords*2 - 1)) / 16));
+        col += sampleTex[i]  *  (kernel[i] + 6 * (i == 4 ? vignette / 2 : -vignette / 16));
     
-    FragColor = vec4(col, 1.0);
+    FragColor = vec4(pow(max(col, 0.0), vec3(1.0 / gamma)), 1.0);
 }  
\ No newline at end of file
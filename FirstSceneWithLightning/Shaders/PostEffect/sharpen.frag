@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform float amount;
+
+void main()
+{
+    // the pass may be drawn at a different size than its source (the final upscale), so don't use gl_FragCoord
+    ivec2 maxPixel = textureSize(screenTexture, 0) - 1;
+    ivec2 pixel = min(ivec2(TexCoords * vec2(maxPixel + 1)), maxPixel);
+    vec3 center = texelFetch(screenTexture, pixel, 0).rgb;
+    vec3 neighbours = texelFetch(screenTexture, clamp(pixel + ivec2(-1, 0), ivec2(0), maxPixel), 0).rgb
+                    + texelFetch(screenTexture, clamp(pixel + ivec2( 1, 0), ivec2(0), maxPixel), 0).rgb
+                    + texelFetch(screenTexture, clamp(pixel + ivec2( 0,-1), ivec2(0), maxPixel), 0).rgb
+                    + texelFetch(screenTexture, clamp(pixel + ivec2( 0, 1), ivec2(0), maxPixel), 0).rgb;
+    FragColor = vec4(max(center + amount * (4.0 * center - neighbours), 0.0), 1.0);
+}
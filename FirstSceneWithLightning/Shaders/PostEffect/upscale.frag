@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+
+void main()
+{
+    // the scene texture is smaller than the screen, bilinear filtering stretches it
+    FragColor = vec4(texture(screenTexture, TexCoords).rgb, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform float strength;
+
+void main()
+{
+    vec3 col = texture(screenTexture, TexCoords).rgb;
+    float dist = length(TexCoords * 2.0 - 1.0);
+    FragColor = vec4(col * (1.0 - strength * smoothstep(0.5, 1.5, dist)), 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+in vec4 FragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+void main()
+{
+    // linear distance to the light in [0, 1], the lit shaders compare distances the same way
+    gl_FragDepth = length(FragPos.xyz - lightPos) / farPlane;
+}
@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+#include "../Common/draw_constants.glsl"
+
+void main()
+{
+    // world space, the geometry shader projects onto every cube face
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -7,14 +7,18 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 Position;
 
-uniform mat4 model;
+// same position math as DepthPrepass/depth.vert
+invariant gl_Position;
+
+#include "../Common/draw_constants.glsl"
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-	Normal = mat3(transpose(inverse(model))) * aNormal;
-    Position = vec3(model * vec4(aPos, 1.0));
+	Normal = normalMatrix * aNormal;
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+    Position = vec3(worldPosition);
 	TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPosition;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// have to match StatsOverlay::TEXT_ROWS, TEXT_COLUMNS and HISTORY
+const int TEXT_ROWS = 4;
+const int TEXT_COLUMNS = 36;
+const int HISTORY = 120;
+const int GLYPH_SCALE = 2;
+const vec2 CELL = vec2(8.0, 12.0);
+const float PADDING = 6.0;
+
+// 3x5 glyphs, bit 14 is the top left pixel: digits, A-Z, space . : / % -
+const int FONT[42] = int[42](
+    31599, 11415, 29671, 29647, 23497, 31183, 31215, 29257, 31727, 31695,
+    11245, 27566, 14627, 27502, 31143, 31140, 14699, 23533, 29847, 4714, 23469, 18727, 24557,
+    27501, 11114, 27556, 11123, 27565, 14478, 29842, 23407, 23402, 23549, 23213, 23186, 29351,
+    0, 2, 1040, 4772, 21157, 448);
+
+uniform vec4 rect;
+// glyph indices, four per element
+uniform ivec4 text[TEXT_ROWS * TEXT_COLUMNS / 4];
+// milliseconds, oldest first, four per element
+uniform vec4 frameTimes[HISTORY / 4];
+uniform vec3 percentiles; // p50, p95, p99
+uniform float graphMs;    // frame time at the top of the graph
+uniform float budgetMs;
+
+void main()
+{
+    // pixels from the top left corner of the overlay
+    vec2 pixel = vec2(TexCoords.x, 1.0 - TexCoords.y) * rect.zw;
+    vec4 color = vec4(0.0, 0.0, 0.0, 0.6);
+
+    vec2 textPixel = pixel - vec2(PADDING);
+    float textHeight = float(TEXT_ROWS) * CELL.y;
+    if (textPixel.x >= 0.0 && textPixel.y >= 0.0 && textPixel.y < textHeight) {
+        ivec2 cell = ivec2(textPixel / CELL);
+        ivec2 glyphPixel = ivec2(mod(textPixel, CELL)) / GLYPH_SCALE;
+        if (cell.x < TEXT_COLUMNS && glyphPixel.x < 3 && glyphPixel.y < 5) {
+            int character = cell.y * TEXT_COLUMNS + cell.x;
+            int glyph = FONT[text[character / 4][character % 4]];
+            if (((glyph >> (14 - glyphPixel.y * 3 - glyphPixel.x)) & 1) != 0)
+                color = vec4(1.0);
+        }
+    }
+
+    // frame time graph under the text, the newest frame on the right
+    float graphWidth = rect.z - PADDING * 2.0;
+    float graphHeight = rect.w - textHeight - PADDING * 3.0;
+    vec2 graphPixel = vec2(pixel.x - PADDING, rect.w - PADDING - pixel.y);
+    if (graphPixel.x >= 0.0 && graphPixel.x < graphWidth && graphPixel.y >= 0.0 && graphPixel.y < graphHeight) {
+        int frame = int(graphPixel.x / graphWidth * float(HISTORY));
+        float ms = frameTimes[frame / 4][frame % 4];
+        float msPerPixel = graphMs / graphHeight;
+        float pixelMs = graphPixel.y * msPerPixel;
+        if (pixelMs < ms) {
+            if (ms <= budgetMs)
+                color = vec4(0.2, 0.8, 0.3, 0.9);
+            else if (ms <= budgetMs * 2.0)
+                color = vec4(0.9, 0.8, 0.2, 0.9);
+            else
+                color = vec4(0.9, 0.25, 0.2, 0.9);
+        }
+        // the budget dashed, the percentiles as lines on top
+        if (abs(pixelMs - budgetMs) < msPerPixel * 0.5 && mod(graphPixel.x, 8.0) < 4.0)
+            color = vec4(0.3, 0.8, 1.0, 1.0);
+        if (abs(pixelMs - percentiles.x) < msPerPixel * 0.5)
+            color = vec4(1.0);
+        if (abs(pixelMs - percentiles.y) < msPerPixel * 0.5)
+            color = vec4(1.0, 0.7, 0.2, 1.0);
+        if (abs(pixelMs - percentiles.z) < msPerPixel * 0.5)
+            color = vec4(1.0, 0.3, 0.3, 1.0);
+    }
+    FragColor = color;
+}
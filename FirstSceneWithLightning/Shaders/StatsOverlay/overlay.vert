@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+// the overlay in pixels: left, top, width, height from the top left corner of the screen
+uniform vec4 rect;
+uniform vec2 screenSize;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec2 pixel = rect.xy + vec2(aTexCoords.x, 1.0 - aTexCoords.y) * rect.zw;
+    gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+}
@@ -7,14 +7,14 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
+#include "Common/draw_constants.glsl"
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
     FragPos = vec3(model * vec4(aPosition, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
 	TexCoords = aTexCoords;
 
 	gl_Position = projection * view * model * vec4(aPosition, 1.0f);
@@ -0,0 +1,127 @@
+#include "ShadowMapping.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Log.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+PointShadowMap::PointShadowMap(unsigned int size, float farPlane)
+    : size(size), farPlane(farPlane), staticCube(0), staticFBO(0), dynamicCube(0), dynamicFBO(0),
+      isStaticValid(false), staticLightPos(0.f), staticVersion(0), hasDynamicLayer(false), matricesProgram(0), matricesLocation(-1)
+{
+}
+
+unsigned int PointShadowMap::Update(Shader &depthShader, const glm::vec3 &lightPos, unsigned int staticVersion, bool hasDynamicCasters,
+                                    const function<void(Shader &)> &drawStatic, const function<void(Shader &)> &drawDynamic)
+{
+    if (!staticFBO) {
+        createLayer(staticCube, staticFBO);
+        createLayer(dynamicCube, dynamicFBO);
+    }
+    unsigned int renderedLayers = 0;
+    bool isLightMoved = lightPos != staticLightPos;
+    if (!isStaticValid || isLightMoved || staticVersion != this->staticVersion) {
+        renderLayer(staticFBO, depthShader, lightPos, drawStatic);
+        isStaticValid = true;
+        staticLightPos = lightPos;
+        this->staticVersion = staticVersion;
+        renderedLayers++;
+    }
+    if (hasDynamicCasters) {
+        renderLayer(dynamicFBO, depthShader, lightPos, drawDynamic);
+        renderedLayers++;
+    }
+    hasDynamicLayer = hasDynamicCasters;
+    return renderedLayers;
+}
+
+void PointShadowMap::Bind(Shader &shader, unsigned int firstUnit, bool isEnabled) const
+{
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    GlStats::BindTexture(GL_TEXTURE_CUBE_MAP, staticCube);
+    shader.setInt("shadowStatic", firstUnit);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    GlStats::BindTexture(GL_TEXTURE_CUBE_MAP, dynamicCube);
+    shader.setInt("shadowDynamic", firstUnit + 1);
+    glActiveTexture(GL_TEXTURE0);
+    // 0 - no shadows, 1 - static layer only, 2 - both layers
+    shader.setInt("shadowState", !isEnabled || !isStaticValid ? 0 : (hasDynamicLayer ? 2 : 1));
+    shader.setVec3("shadowLightPos", staticLightPos);
+    shader.setFloat("shadowFarPlane", farPlane);
+}
+
+void PointShadowMap::Invalidate()
+{
+    isStaticValid = false;
+}
+
+void PointShadowMap::Clear()
+{
+    unsigned int FBOs[] = { staticFBO, dynamicFBO }, cubes[] = { staticCube, dynamicCube };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_FRAMEBUFFER, FBOs[i]);
+        GpuResourceRegistry::Get().Remove(GPU_TEXTURE, cubes[i]);
+    }
+    glDeleteFramebuffers(2, FBOs);
+    glDeleteTextures(2, cubes);
+    staticFBO = dynamicFBO = staticCube = dynamicCube = 0;
+    isStaticValid = false;
+}
+
+void PointShadowMap::createLayer(unsigned int &cube, unsigned int &FBO)
+{
+    glGenTextures(1, &cube);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+    for (unsigned int i = 0; i < 6; i++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, cube, GpuResourceRegistry::TextureBytes(size, size, 6, 4, false), "point shadow map");
+
+    glGenFramebuffers(1, &FBO);
+    GpuResourceRegistry::Get().Add(GPU_FRAMEBUFFER, FBO, 0, "point shadow map");
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    // layered attachment, gl_Layer in the geometry shader picks the face
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cube, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG(LOG_ERROR) << "ERROR::SHADOW::FRAMEBUFFER:: Shadow cube map framebuffer is not complete!";
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PointShadowMap::renderLayer(unsigned int FBO, Shader &depthShader, const glm::vec3 &lightPos, const function<void(Shader &)> &draw)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, farPlane);
+    // cube map face order +X, -X, +Y, -Y, +Z, -Z with the up vectors cube maps expect
+    glm::mat4 faces[6] = {
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3( 1.f,  0.f,  0.f), glm::vec3(0.f, -1.f,  0.f)),
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3(-1.f,  0.f,  0.f), glm::vec3(0.f, -1.f,  0.f)),
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.f,  1.f,  0.f), glm::vec3(0.f,  0.f,  1.f)),
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.f, -1.f,  0.f), glm::vec3(0.f,  0.f, -1.f)),
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.f,  0.f,  1.f), glm::vec3(0.f, -1.f,  0.f)),
+        projection * glm::lookAt(lightPos, lightPos + glm::vec3( 0.f,  0.f, -1.f), glm::vec3(0.f, -1.f,  0.f))
+    };
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, size, size);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    depthShader.Use();
+    // the name doesn't change, look the location up again only for another program
+    if (depthShader.ID != matricesProgram) {
+        matricesProgram = depthShader.ID;
+        matricesLocation = glGetUniformLocation(depthShader.ID, "shadowMatrices");
+    }
+    glUniformMatrix4fv(matricesLocation, 6, GL_FALSE, glm::value_ptr(faces[0]));
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS);
+    depthShader.setVec3("lightPos", lightPos);
+    depthShader.setFloat("farPlane", farPlane);
+    draw(depthShader);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef SHADOW_MAPPING_H
+#define SHADOW_MAPPING_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+#include <functional>
+using namespace std;
+
+// Omnidirectional shadows of one point light, kept in two depth cube maps (distance to the light / farPlane).
+// The static layer holds walls, floors and everything else that never moves: it is redrawn only when the light
+// moves or new static geometry shows up, so a light standing still costs no shadow rendering at all.
+// The dynamic layer holds only the casters that move and is redrawn every frame while there are any;
+// the lit shaders take the nearer of the two depths.
+// All 6 faces of a layer are drawn in one pass, the geometry shader sends every triangle to each face.
+class PointShadowMap
+{
+public:
+    PointShadowMap(unsigned int size, float farPlane);
+
+    // redraws whatever is out of date, the draw functions draw the static or the dynamic casters with the depth shader.
+    // Changes the framebuffer and the viewport. Returns how many layers were drawn (0, 1 or 2).
+    unsigned int Update(Shader &depthShader, const glm::vec3 &lightPos, unsigned int staticVersion, bool hasDynamicCasters,
+                        const function<void(Shader &)> &drawStatic, const function<void(Shader &)> &drawDynamic);
+    // binds the layers to texture units firstUnit and firstUnit + 1 and sets the shadow uniforms, the shader has to be in use
+    void Bind(Shader &shader, unsigned int firstUnit, bool isEnabled) const;
+    // makes the next Update() redraw everything
+    void Invalidate();
+    // deletes the maps, has to be called while the GL context is still alive
+    void Clear();
+
+private:
+    unsigned int size;
+    float farPlane;
+    unsigned int staticCube, staticFBO;
+    unsigned int dynamicCube, dynamicFBO;
+
+    bool isStaticValid;
+    glm::vec3 staticLightPos;
+    unsigned int staticVersion;
+    bool hasDynamicLayer;
+    // location of shadowMatrices in the last depth program rendered with
+    unsigned int matricesProgram;
+    GLint matricesLocation;
+
+    void createLayer(unsigned int &cube, unsigned int &FBO);
+    void renderLayer(unsigned int FBO, Shader &depthShader, const glm::vec3 &lightPos, const function<void(Shader &)> &draw);
+};
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is always there on x64 and on x86 builds with /arch:SSE2 (the default since VS2012).
+// Code that uses the intrinsics keeps a plain C++ path for other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE 1
+#include <emmintrin.h>
+#else
+#define USE_SSE 0
+#endif
+
+#endif
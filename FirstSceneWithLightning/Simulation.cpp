@@ -0,0 +1,205 @@
+#include "Simulation.h"
+#include "Log.h"
+
+#include "GLFW/glfw3.h"
+
+#include <chrono>
+
+const double KEY_PRESS_THRESHOLD = 0.2;
+
+Simulation::Simulation(const Camera &camera, const glm::vec3 &lightOrigin, double cursorX, double cursorY, double stepsPerSecond)
+    : stepSeconds(1.0 / stepsPerSecond), running(false), camera(camera), cursorX(cursorX), cursorY(cursorY),
+      time(0.0), lampTime(0.0), tick(0), lightOrigin(lightOrigin), lightPos(lightOrigin)
+{
+    for (int i = 0; i < 1024; i++)
+    {
+        pressedKeys[i] = false;
+        lastTimePressed[i] = -KEY_PRESS_THRESHOLD;
+    }
+    // the renderer may ask for a snapshot before the first step is done
+    publish();
+}
+
+Simulation::~Simulation()
+{
+    Stop();
+}
+
+void Simulation::Start()
+{
+    running = true;
+    thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::Stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void Simulation::PushInput(const InputEvent &event)
+{
+    input.Push(event);
+}
+
+const SceneSnapshot &Simulation::LatestSnapshot()
+{
+    snapshots.Update();
+    return snapshots.ReadBuffer();
+}
+
+void Simulation::run()
+{
+    typedef std::chrono::steady_clock clock;
+    const clock::duration stepDuration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(stepSeconds));
+    clock::time_point nextStep = clock::now();
+    while (running)
+    {
+        step();
+        nextStep += stepDuration;
+        clock::time_point now = clock::now();
+        if (nextStep < now - 10 * stepDuration)
+        {
+            // we were stalled for a long time (debugger, window drag), don't try to catch up every missed step
+            nextStep = now;
+        }
+        std::this_thread::sleep_until(nextStep);
+    }
+}
+
+void Simulation::step()
+{
+    time += stepSeconds;
+    tick++;
+    processInput();
+    processCameraMovement();
+    processActionKeys();
+
+    if (!toggles.isLampPaused) {
+        lampTime += stepSeconds;
+    }
+    lightPos = lightOrigin;
+    lightPos.x += 2 * glm::sin((float)lampTime);
+    lightPos.y += 2.5 * glm::cos((float)lampTime);
+    publish();
+}
+
+void Simulation::processInput()
+{
+    InputEvent event;
+    while (input.Pop(event))
+    {
+        if (event.type == KEY_EVENT)
+        {
+            if (event.key < 0 || event.key >= 1024)
+                continue;
+            if (event.action == GLFW_PRESS) {
+                pressedKeys[event.key] = true;
+            } else if (event.action == GLFW_RELEASE) {
+                pressedKeys[event.key] = false;
+            }
+        }
+        else if (event.type == CURSOR_EVENT)
+        {
+            float xoffset = event.x - cursorX;
+            float yoffset = cursorY - event.y; // reversed since y-coordinates go from bottom to top
+            camera.ProcessMouseMovement(xoffset, yoffset);
+            cursorX = event.x;
+            cursorY = event.y;
+            if (toggles.debugLevel > 1) {
+                LOG(LOG_DEBUG) << "Camera direction: " << camera.Front.x << " " << camera.Front.y << " " << camera.Front.z;
+            }
+        }
+    }
+}
+
+void Simulation::processCameraMovement()
+{
+    float deltaTime = (float)stepSeconds;
+    if (pressedKeys[GLFW_KEY_SPACE]) {
+        camera.ProcessKeyboard(UP, deltaTime);
+    }
+    if (pressedKeys[GLFW_KEY_X]) {
+        camera.ProcessKeyboard(DOWN, deltaTime);
+    }
+    if (pressedKeys[GLFW_KEY_W]) {
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    }
+    if (pressedKeys[GLFW_KEY_A]) {
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    }
+    if (pressedKeys[GLFW_KEY_S]) {
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    }
+    if (pressedKeys[GLFW_KEY_D]) {
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    }
+}
+
+void Simulation::processActionKeys()
+{
+    toggleOnKey(GLFW_KEY_F, toggles.isFlashlightOn, nullptr, nullptr);
+    toggleOnKey(GLFW_KEY_I, toggles.isGammaCorrectionOn, "Enabled gamma correction", "Disabled gamma correction");
+    toggleOnKey(GLFW_KEY_P, toggles.isFigureReflecting, "Bench is reflecting skybox", "Bench is look-through");
+    toggleOnKey(GLFW_KEY_O, toggles.isParallaxSelfShadowing, "Enabled Parallax Self-Shadowing", "Disabled Parallax Self-Shadowing");
+    toggleOnKey(GLFW_KEY_E, toggles.isPostEffectOn, "Enabled PostEffect", "Disabled PostEffect");
+    toggleOnKey(GLFW_KEY_1, toggles.isBlurOn, "Enabled Blur", "Disabled Blur");
+    toggleOnKey(GLFW_KEY_2, toggles.isSharpenOn, "Enabled Sharpen", "Disabled Sharpen");
+    toggleOnKey(GLFW_KEY_3, toggles.isVignetteOn, "Enabled Vignette", "Disabled Vignette");
+    toggleOnKey(GLFW_KEY_C, toggles.isComputePostEffectsOn, "PostEffects use compute shaders", "PostEffects use fragment shaders");
+    toggleOnKey(GLFW_KEY_R, toggles.isDynamicResolutionOn, "Enabled dynamic resolution", "Disabled dynamic resolution");
+    toggleOnKey(GLFW_KEY_H, toggles.isShadowsOn, "Enabled shadows", "Disabled shadows");
+    toggleOnKey(GLFW_KEY_K, toggles.isLampPaused, "Lamp stopped", "Lamp is flying");
+    toggleOnKey(GLFW_KEY_Z, toggles.isDepthPrepassOn, "Enabled depth pre-pass", "Disabled depth pre-pass");
+    toggleOnKey(GLFW_KEY_U, toggles.isOcclusionCullingOn, "Enabled occlusion culling", "Disabled occlusion culling");
+    toggleOnKey(GLFW_KEY_L, toggles.isLightSwarmOn, "Added 256 flying lights", "Removed flying lights");
+    toggleOnKey(GLFW_KEY_V, toggles.isMultiViewOn, "Stereo and overview views in one pass", "Single view");
+    toggleOnKey(GLFW_KEY_M, toggles.isCapturePaused, "Frame capture paused", "Frame capture resumed");
+    toggleOnKey(GLFW_KEY_T, toggles.isStatsOverlayOn, nullptr, nullptr);
+    if (pressedKeys[GLFW_KEY_LEFT_BRACKET] || pressedKeys[GLFW_KEY_RIGHT_BRACKET]) {
+        if (isKeyTriggered(GLFW_KEY_RIGHT_BRACKET)) {
+            toggles.blurRadius += pressedKeys[GLFW_KEY_RIGHT_BRACKET] ? 2 : -2;
+            toggles.blurRadius = toggles.blurRadius < 1 ? 1 : (toggles.blurRadius > 32 ? 32 : toggles.blurRadius);
+            if (toggles.debugLevel > 0) {
+                LOG(LOG_INFO) << "Blur radius: " << toggles.blurRadius;
+            }
+        }
+    }
+    if (pressedKeys[GLFW_KEY_B] && isKeyTriggered(GLFW_KEY_B)) {
+        toggles.postBenchmarkRequests++;
+    }
+    if (pressedKeys[GLFW_KEY_G] && isKeyTriggered(GLFW_KEY_G)) {
+        toggles.debugLevel = toggles.debugLevel ? 0 : 1;
+        LOG(LOG_INFO) << (toggles.debugLevel ? "Event log is on!" : "Event log is off!");
+    }
+}
+
+void Simulation::toggleOnKey(int key, bool &flag, const char *onMessage, const char *offMessage)
+{
+    if (!pressedKeys[key] || !isKeyTriggered(key))
+        return;
+    flag ^= 1;
+    if (toggles.debugLevel > 0 && onMessage) {
+        LOG(LOG_INFO) << (flag ? onMessage : offMessage);
+    }
+}
+
+bool Simulation::isKeyTriggered(int key)
+{
+    if (time - lastTimePressed[key] <= KEY_PRESS_THRESHOLD)
+        return false;
+    lastTimePressed[key] = time;
+    return true;
+}
+
+void Simulation::publish()
+{
+    SceneSnapshot &snapshot = snapshots.WriteBuffer();
+    snapshot.camera = camera;
+    snapshot.lightPos = lightPos;
+    snapshot.toggles = toggles;
+    snapshot.time = time;
+    snapshot.tick = tick;
+    snapshots.Publish();
+}
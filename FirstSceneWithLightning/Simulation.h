@@ -0,0 +1,110 @@
+#pragma once
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "Camera.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <thread>
+
+// Switches the user flips with the keyboard, the renderer only reads them
+struct SceneToggles {
+    bool isFlashlightOn = false;
+    bool isFigureReflecting = true;
+    bool isParallaxSelfShadowing = false;
+    bool isPostEffectOn = false;
+    bool isGammaCorrectionOn = false;
+    bool isBlurOn = false;
+    bool isSharpenOn = false;
+    bool isVignetteOn = false;
+    bool isComputePostEffectsOn = false;
+    bool isDynamicResolutionOn = false;
+    bool isLightSwarmOn = false;
+    bool isShadowsOn = true;
+    bool isLampPaused = false;
+    bool isDepthPrepassOn = true;
+    bool isOcclusionCullingOn = true;
+    bool isMultiViewOn = false;
+    bool isCapturePaused = false;
+    bool isStatsOverlayOn = false;
+    int blurRadius = 8;
+    int debugLevel = 0;
+    // one-shot requests are counters, the renderer acts whenever the value differs from the one it saw last
+    unsigned int postBenchmarkRequests = 0;
+};
+
+// Everything the renderer needs to know about the scene at one simulation step. Never changed after it is published.
+struct SceneSnapshot {
+    Camera camera;
+    glm::vec3 lightPos;
+    SceneToggles toggles;
+    double time = 0.0;          // simulation time in seconds
+    unsigned long long tick = 0;
+};
+
+enum INPUT_EVENT_TYPE {
+    KEY_EVENT,
+    CURSOR_EVENT
+};
+
+// GLFW callback data, copied as is to the simulation thread
+struct InputEvent {
+    INPUT_EVENT_TYPE type;
+    int key;
+    int action;
+    double x, y;
+};
+
+// Runs input handling, camera movement and light animation at a fixed rate on its own thread.
+// Input comes in through a lock-free queue filled by the GLFW callbacks on the main thread,
+// results go out as snapshots, the render thread always takes the newest one.
+class Simulation
+{
+public:
+    Simulation(const Camera &camera, const glm::vec3 &lightOrigin, double cursorX, double cursorY, double stepsPerSecond = 120.0);
+    ~Simulation();
+
+    void Start();
+    void Stop();
+
+    // called from the GLFW callbacks (one producer thread), drops the event if the simulation fell far behind
+    void PushInput(const InputEvent &event);
+
+    // render thread: takes the newest published snapshot, the returned reference stays valid until the next call
+    const SceneSnapshot &LatestSnapshot();
+
+private:
+    const double stepSeconds;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    SpscQueue<InputEvent, 1024> input;
+    TripleBuffer<SceneSnapshot> snapshots;
+
+    // state owned by the simulation thread
+    Camera camera;
+    SceneToggles toggles;
+    bool pressedKeys[1024];
+    double lastTimePressed[1024];
+    double cursorX, cursorY;
+    double time;
+    double lampTime; // only runs while the lamp isn't paused
+    unsigned long long tick;
+    glm::vec3 lightOrigin;
+    glm::vec3 lightPos;
+
+    void run();
+    void step();
+    void processInput();
+    void processCameraMovement();
+    void processActionKeys();
+    // flips the flag once per press, holding the key doesn't flip it back and forth every step
+    void toggleOnKey(int key, bool &flag, const char *onMessage, const char *offMessage);
+    bool isKeyTriggered(int key);
+    void publish();
+};
+#endif
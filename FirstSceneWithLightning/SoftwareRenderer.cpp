@@ -0,0 +1,467 @@
+#include "SoftwareRenderer.h"
+#include "PostProcessing.h"
+#include "Simd.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+#include <algorithm>
+#include <cmath>
+
+// std::fill takes it by reference
+const unsigned int SoftwareRenderer::NO_TRIANGLE;
+
+SoftwareRenderer::SoftwareRenderer(ThreadPool &pool, unsigned int width, unsigned int height)
+    : pool(pool), width(0), height(0), stride(0), tilesX(0), tilesY(0),
+      viewProjection(1.f), inverseViewProjection(1.f), viewPos(0.f), skybox(nullptr)
+{
+    Resize(width, height);
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+    for (map<string, SoftwareTexture *>::iterator it = textures.begin(); it != textures.end(); ++it)
+        delete it->second;
+}
+
+void SoftwareRenderer::Resize(unsigned int width, unsigned int height)
+{
+    this->width = width;
+    this->height = height;
+    stride = (width + 3) & ~3u;
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    tileTriangles.assign(tilesX * tilesY, vector<unsigned int>());
+    depth.assign(stride * height, 1.f);
+    nearestTriangle.assign(stride * height, NO_TRIANGLE);
+    color.assign(stride * height, glm::vec3(0.f));
+}
+
+const SoftwareTexture *SoftwareRenderer::LoadTexture(const string &path)
+{
+    map<string, SoftwareTexture *>::iterator loaded = textures.find(path);
+    if (loaded != textures.end())
+        return loaded->second;
+    SoftwareTexture *texture = new SoftwareTexture();
+    if (!texture->Load(path)) {
+        delete texture;
+        texture = nullptr;
+    }
+    // failures are remembered too, so a missing file is reported once
+    textures[path] = texture;
+    return texture;
+}
+
+void SoftwareRenderer::SetSkybox(const SoftwareCubemap *skybox)
+{
+    this->skybox = skybox;
+}
+
+void SoftwareRenderer::SetLights(const vector<Light> &lights)
+{
+    this->lights = lights;
+}
+
+void SoftwareRenderer::BeginFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos)
+{
+    viewProjection = projection * view;
+    inverseViewProjection = glm::inverse(viewProjection);
+    this->viewPos = viewPos;
+    vertices.clear();
+    triangles.clear();
+    materials.clear();
+    for (unsigned int i = 0; i < tileTriangles.size(); i++)
+        tileTriangles[i].clear();
+}
+
+void SoftwareRenderer::DrawMesh(const Mesh &mesh, const glm::mat4 &model, const SoftwareMaterial &material)
+{
+    unsigned int materialIndex = materials.size();
+    materials.push_back(material);
+    unsigned int base = vertices.size();
+    vertices.resize(base + mesh.vertices.size());
+    glm::mat4 transform = viewProjection * model;
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    glm::mat3 tangentMatrix = glm::mat3(model);
+    pool.ParallelFor(mesh.vertices.size(), 4096, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const Vertex &source = mesh.vertices[i];
+            ShadedVertex &target = vertices[base + i];
+            glm::vec4 position(source.Position, 1.f);
+            target.clip = transform * position;
+            target.worldPos = glm::vec3(model * position);
+            target.normal = normalMatrix * source.Normal;
+            target.tangent = tangentMatrix * source.Tangent;
+            target.bitangent = tangentMatrix * source.Bitangent;
+            target.uv = source.TexCoords;
+        }
+    });
+    if (mesh.indices.empty()) {
+        for (unsigned int i = 0; i + 2 < mesh.vertices.size(); i += 3)
+            addClippedTriangle(base + i, base + i + 1, base + i + 2, materialIndex);
+    } else {
+        for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+            addClippedTriangle(base + mesh.indices[i], base + mesh.indices[i + 1], base + mesh.indices[i + 2], materialIndex);
+    }
+}
+
+void SoftwareRenderer::EndFrame()
+{
+    pool.ParallelFor(tilesX * tilesY, 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int tile = begin; tile < end; tile++)
+            renderTile(tile);
+    });
+}
+
+void SoftwareRenderer::Blur(int radius)
+{
+    if (radius <= 0)
+        return;
+    blurScratch.resize(color.size());
+    blurPass(color, blurScratch, radius, true);
+    blurPass(blurScratch, color, radius, false);
+}
+
+void SoftwareRenderer::ReadPixels(vector<unsigned char> &rgb, float gamma) const
+{
+    rgb.resize(width * height * 3);
+    float exponent = 1.f / gamma;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        // the framebuffer goes bottom-up like GL's, images top-down
+        const glm::vec3 *row = &color[(height - 1 - y) * stride];
+        unsigned char *target = &rgb[y * width * 3];
+        for (unsigned int x = 0; x < width; x++)
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                float value = glm::clamp(row[x][c], 0.f, 1.f);
+                if (gamma != 1.f)
+                    value = std::pow(value, exponent);
+                target[x * 3 + c] = (unsigned char)(value * 255.f + 0.5f);
+            }
+    }
+}
+
+bool SoftwareRenderer::SaveImage(const string &path, float gamma) const
+{
+    vector<unsigned char> rgb;
+    ReadPixels(rgb, gamma);
+    string extension = path.size() >= 4 ? path.substr(path.size() - 4) : string();
+    int type = SOIL_SAVE_TYPE_TGA;
+    if (extension == ".bmp" || extension == ".BMP")
+        type = SOIL_SAVE_TYPE_BMP;
+    else if (extension == ".dds" || extension == ".DDS")
+        type = SOIL_SAVE_TYPE_DDS;
+    if (!SOIL_save_image(path.c_str(), type, width, height, 3, &rgb[0])) {
+        LOG(LOG_ERROR) << "ERROR::SOFTWARE_RENDERER::SAVE:: Couldn't write " << path;
+        return false;
+    }
+    return true;
+}
+
+unsigned int SoftwareRenderer::GetWidth() const
+{
+    return width;
+}
+
+unsigned int SoftwareRenderer::GetHeight() const
+{
+    return height;
+}
+
+unsigned int SoftwareRenderer::GetTriangleCount() const
+{
+    return triangles.size();
+}
+
+float SoftwareRenderer::GetDepth(unsigned int x, unsigned int y) const
+{
+    return depth[y * stride + x];
+}
+
+void SoftwareRenderer::addClippedTriangle(unsigned int a, unsigned int b, unsigned int c, unsigned int material)
+{
+    unsigned int corners[3] = { a, b, c };
+    float distances[3];
+    unsigned int insideCount = 0;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &clip = vertices[corners[i]].clip;
+        distances[i] = clip.z + clip.w;
+        insideCount += distances[i] >= 0.f;
+    }
+    if (insideCount == 3) {
+        addTriangle(a, b, c, material);
+        return;
+    }
+    if (insideCount == 0)
+        return;
+    // near plane clipping, the new corners are interpolated vertices appended to the frame's vertices
+    unsigned int polygon[4];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        unsigned int next = (i + 1) % 3;
+        if (distances[i] >= 0.f)
+            polygon[count++] = corners[i];
+        if ((distances[i] >= 0.f) != (distances[next] >= 0.f))
+        {
+            float t = distances[i] / (distances[i] - distances[next]);
+            ShadedVertex from = vertices[corners[i]], to = vertices[corners[next]];
+            ShadedVertex middle;
+            middle.clip = from.clip + (to.clip - from.clip) * t;
+            middle.worldPos = from.worldPos + (to.worldPos - from.worldPos) * t;
+            middle.normal = from.normal + (to.normal - from.normal) * t;
+            middle.tangent = from.tangent + (to.tangent - from.tangent) * t;
+            middle.bitangent = from.bitangent + (to.bitangent - from.bitangent) * t;
+            middle.uv = from.uv + (to.uv - from.uv) * t;
+            polygon[count++] = vertices.size();
+            vertices.push_back(middle);
+        }
+    }
+    for (unsigned int i = 2; i < count; i++)
+        addTriangle(polygon[0], polygon[i - 1], polygon[i], material);
+}
+
+void SoftwareRenderer::addTriangle(unsigned int a, unsigned int b, unsigned int c, unsigned int material)
+{
+    Triangle triangle;
+    triangle.vertices[0] = a;
+    triangle.vertices[1] = b;
+    triangle.vertices[2] = c;
+    triangle.material = material;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &clip = vertices[triangle.vertices[i]].clip;
+        triangle.invW[i] = 1.f / clip.w;
+        triangle.x[i] = (clip.x * triangle.invW[i] * 0.5f + 0.5f) * width;
+        triangle.y[i] = (clip.y * triangle.invW[i] * 0.5f + 0.5f) * height;
+        triangle.z[i] = clip.z * triangle.invW[i];
+    }
+    float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+    if (std::fabs(area) < 1e-8f)
+        return;
+    // both faces are drawn like in the GL path, clockwise triangles are turned around
+    if (area < 0.f) {
+        std::swap(triangle.vertices[1], triangle.vertices[2]);
+        std::swap(triangle.x[1], triangle.x[2]);
+        std::swap(triangle.y[1], triangle.y[2]);
+        std::swap(triangle.z[1], triangle.z[2]);
+        std::swap(triangle.invW[1], triangle.invW[2]);
+        area = -area;
+    }
+    triangle.invArea = 1.f / area;
+
+    float minX = min(triangle.x[0], min(triangle.x[1], triangle.x[2]));
+    float maxX = max(triangle.x[0], max(triangle.x[1], triangle.x[2]));
+    float minY = min(triangle.y[0], min(triangle.y[1], triangle.y[2]));
+    float maxY = max(triangle.y[0], max(triangle.y[1], triangle.y[2]));
+    if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+        return;
+    unsigned int tileX0 = (unsigned int)max(0.f, minX) / TILE_SIZE, tileX1 = min((unsigned int)maxX, width - 1) / TILE_SIZE;
+    unsigned int tileY0 = (unsigned int)max(0.f, minY) / TILE_SIZE, tileY1 = min((unsigned int)maxY, height - 1) / TILE_SIZE;
+    unsigned int index = triangles.size();
+    triangles.push_back(triangle);
+    // tiles keep their triangles in submission order, so equal depths resolve the same way as on the GPU
+    for (unsigned int ty = tileY0; ty <= tileY1; ty++)
+        for (unsigned int tx = tileX0; tx <= tileX1; tx++)
+            tileTriangles[ty * tilesX + tx].push_back(index);
+}
+
+void SoftwareRenderer::renderTile(unsigned int tile)
+{
+    int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    // columns up to the padded stride so every 4-pixel group is whole
+    int columnEnd = min(tileX + (int)TILE_SIZE, (int)stride);
+    int rowEnd = min(tileY + (int)TILE_SIZE, (int)height);
+    for (int y = tileY; y < rowEnd; y++)
+    {
+        std::fill(&depth[y * stride + tileX], &depth[y * stride] + columnEnd, 1.f);
+        std::fill(&nearestTriangle[y * stride + tileX], &nearestTriangle[y * stride] + columnEnd, NO_TRIANGLE);
+    }
+
+    // visibility: nearest triangle of every pixel
+    const vector<unsigned int> &tileList = tileTriangles[tile];
+    for (unsigned int i = 0; i < tileList.size(); i++)
+    {
+        const Triangle &triangle = triangles[tileList[i]];
+        const float *x = triangle.x, *y = triangle.y, *z = triangle.z;
+        float stepX[3] = { -(y[2] - y[1]), -(y[0] - y[2]), -(y[1] - y[0]) };
+        float stepY[3] = { x[2] - x[1], x[0] - x[2], x[1] - x[0] };
+        float originX[3] = { x[1], x[2], x[0] }, originY[3] = { y[1], y[2], y[0] };
+        float depthStepX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * triangle.invArea;
+        float depthStepY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * triangle.invArea;
+
+        int x0 = max(tileX, (int)std::floor(min(x[0], min(x[1], x[2])))) & ~3;
+        int x1 = min(columnEnd - 1, (int)std::ceil(max(x[0], max(x[1], x[2]))));
+        int y0 = max(tileY, (int)std::floor(min(y[0], min(y[1], y[2]))));
+        int y1 = min(rowEnd - 1, (int)std::ceil(max(y[0], max(y[1], y[2]))));
+        for (int row = y0; row <= y1; row++)
+        {
+            float py = row + 0.5f, px = x0 + 0.5f;
+            float edge[3];
+            for (unsigned int e = 0; e < 3; e++)
+                edge[e] = stepY[e] * (py - originY[e]) + stepX[e] * (px - originX[e]);
+            float rowDepth = z[0] + depthStepX * (px - x[0]) + depthStepY * (py - y[0]);
+            float *depthRow = &depth[row * stride];
+            unsigned int *triangleRow = &nearestTriangle[row * stride];
+#if USE_SSE
+            const __m128 lanes = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128i triangleIndex = _mm_set1_epi32((int)tileList[i]);
+            __m128 edge0 = _mm_add_ps(_mm_set1_ps(edge[0]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[0])));
+            __m128 edge1 = _mm_add_ps(_mm_set1_ps(edge[1]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[1])));
+            __m128 edge2 = _mm_add_ps(_mm_set1_ps(edge[2]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[2])));
+            __m128 pixelDepth = _mm_add_ps(_mm_set1_ps(rowDepth), _mm_mul_ps(lanes, _mm_set1_ps(depthStepX)));
+            const __m128 edgeStep0 = _mm_set1_ps(stepX[0] * 4.f);
+            const __m128 edgeStep1 = _mm_set1_ps(stepX[1] * 4.f);
+            const __m128 edgeStep2 = _mm_set1_ps(stepX[2] * 4.f);
+            const __m128 depthStep = _mm_set1_ps(depthStepX * 4.f);
+            for (int column = x0; column <= x1; column += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+                __m128 oldDepth = _mm_loadu_ps(depthRow + column);
+                // GL_LESS
+                __m128 isNearer = _mm_and_ps(inside, _mm_cmplt_ps(pixelDepth, oldDepth));
+                if (_mm_movemask_ps(isNearer)) {
+                    _mm_storeu_ps(depthRow + column, _mm_or_ps(_mm_and_ps(isNearer, pixelDepth), _mm_andnot_ps(isNearer, oldDepth)));
+                    __m128i mask = _mm_castps_si128(isNearer);
+                    __m128i oldTriangles = _mm_loadu_si128((__m128i *)(triangleRow + column));
+                    _mm_storeu_si128((__m128i *)(triangleRow + column),
+                        _mm_or_si128(_mm_and_si128(mask, triangleIndex), _mm_andnot_si128(mask, oldTriangles)));
+                }
+                edge0 = _mm_add_ps(edge0, edgeStep0);
+                edge1 = _mm_add_ps(edge1, edgeStep1);
+                edge2 = _mm_add_ps(edge2, edgeStep2);
+                pixelDepth = _mm_add_ps(pixelDepth, depthStep);
+            }
+#else
+            for (int column = x0; column <= x1; column++)
+            {
+                if (edge[0] >= 0.f && edge[1] >= 0.f && edge[2] >= 0.f && rowDepth < depthRow[column]) {
+                    depthRow[column] = rowDepth;
+                    triangleRow[column] = tileList[i];
+                }
+                for (unsigned int e = 0; e < 3; e++)
+                    edge[e] += stepX[e];
+                rowDepth += depthStepX;
+            }
+#endif
+        }
+    }
+
+    // shading: once per pixel, for the triangle that won
+    int visibleColumnEnd = min(tileX + (int)TILE_SIZE, (int)width);
+    for (int y = tileY; y < rowEnd; y++)
+        for (int x = tileX; x < visibleColumnEnd; x++)
+        {
+            unsigned int triangle = nearestTriangle[y * stride + x];
+            float px = x + 0.5f, py = y + 0.5f;
+            color[y * stride + x] = triangle == NO_TRIANGLE ? background(px, py) : shadePixel(triangles[triangle], px, py);
+        }
+}
+
+glm::vec3 SoftwareRenderer::shadePixel(const Triangle &triangle, float px, float py) const
+{
+    const float *x = triangle.x, *y = triangle.y;
+    // screen-space barycentrics, then perspective-correct ones
+    float b0 = ((x[2] - x[1]) * (py - y[1]) - (y[2] - y[1]) * (px - x[1])) * triangle.invArea * triangle.invW[0];
+    float b1 = ((x[0] - x[2]) * (py - y[2]) - (y[0] - y[2]) * (px - x[2])) * triangle.invArea * triangle.invW[1];
+    float b2 = ((x[1] - x[0]) * (py - y[0]) - (y[1] - y[0]) * (px - x[0])) * triangle.invArea * triangle.invW[2];
+    float sum = b0 + b1 + b2;
+    b0 /= sum;
+    b1 /= sum;
+    b2 /= sum;
+    const ShadedVertex &v0 = vertices[triangle.vertices[0]];
+    const ShadedVertex &v1 = vertices[triangle.vertices[1]];
+    const ShadedVertex &v2 = vertices[triangle.vertices[2]];
+    glm::vec3 position = v0.worldPos * b0 + v1.worldPos * b1 + v2.worldPos * b2;
+    glm::vec3 normal = glm::normalize(v0.normal * b0 + v1.normal * b1 + v2.normal * b2);
+
+    const SoftwareMaterial &material = materials[triangle.material];
+    if (material.shading == SOFTWARE_NORMAL_MAPPED) {
+        glm::vec2 uv = v0.uv * b0 + v1.uv * b1 + v2.uv * b2;
+        glm::vec3 tangent = v0.tangent * b0 + v1.tangent * b1 + v2.tangent * b2;
+        glm::vec3 bitangent = v0.bitangent * b0 + v1.bitangent * b1 + v2.bitangent * b2;
+        return shadeNormalMapped(material, position, uv, normal, tangent, bitangent);
+    }
+    if (material.shading == SOFTWARE_REFLECTION || material.shading == SOFTWARE_REFRACTION) {
+        glm::vec3 incident = glm::normalize(position - viewPos);
+        glm::vec3 direction = material.shading == SOFTWARE_REFLECTION ? glm::reflect(incident, normal)
+                                                                       : glm::refract(incident, normal, 1.f / 1.52f);
+        return skybox ? skybox->Sample(direction) : glm::vec3(0.f);
+    }
+    return material.color;
+}
+
+glm::vec3 SoftwareRenderer::shadeNormalMapped(const SoftwareMaterial &material, const glm::vec3 &position, const glm::vec2 &uv,
+                                              const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent) const
+{
+    glm::vec3 surfaceNormal = normal;
+    if (material.normal && glm::dot(tangent, tangent) > 0.f && glm::dot(bitangent, bitangent) > 0.f) {
+        glm::vec3 mapped = glm::normalize(material.normal->Sample(uv) * 2.f - 1.f);
+        glm::mat3 TBN(glm::normalize(tangent), glm::normalize(bitangent), normal);
+        surfaceNormal = glm::normalize(TBN * mapped);
+    }
+    glm::vec3 albedo = material.diffuse ? material.diffuse->Sample(uv) : material.color;
+    glm::vec3 specularColor = material.specular ? material.specular->Sample(uv) * 0.2f : glm::vec3(0.2f);
+    glm::vec3 viewDir = glm::normalize(viewPos - position);
+    glm::vec3 result = albedo * 0.1f;
+    for (unsigned int i = 0; i < lights.size(); i++)
+    {
+        // same falloff and spot cone as getLight() in the GL shaders
+        const Light &light = lights[i];
+        glm::vec3 toLight = light.position - position;
+        float distance2 = glm::dot(toLight, toLight);
+        float radius2 = light.radius * light.radius;
+        if (distance2 >= radius2)
+            continue;
+        glm::vec3 lightDir = toLight / std::sqrt(max(distance2, 1e-8f));
+        float window = 1.f - distance2 / radius2;
+        float attenuation = window * window;
+        if (light.spotCosOuter > -1.f)
+            attenuation *= glm::smoothstep(light.spotCosOuter, light.spotCosInner, glm::dot(-lightDir, light.direction));
+        if (attenuation <= 0.f)
+            continue;
+        float diffuse = max(glm::dot(lightDir, surfaceNormal), 0.f);
+        glm::vec3 halfwayDir = glm::normalize(lightDir + viewDir);
+        float specular = std::pow(max(glm::dot(surfaceNormal, halfwayDir), 0.f), 32.f);
+        result += light.color * attenuation * (albedo * diffuse + specularColor * specular);
+    }
+    return result;
+}
+
+glm::vec3 SoftwareRenderer::background(float px, float py) const
+{
+    if (!skybox)
+        return glm::vec3(0.05f);
+    // the pixel's point on the far plane, seen from the camera
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(px / width * 2.f - 1.f, py / height * 2.f - 1.f, 1.f, 1.f);
+    return skybox->Sample(glm::vec3(farPoint) / farPoint.w - viewPos);
+}
+
+void SoftwareRenderer::blurPass(const vector<glm::vec3> &source, vector<glm::vec3> &target, int radius, bool isHorizontal)
+{
+    vector<float> weights = getGaussianBlurWeights(radius);
+    radius = (int)weights.size() - 1;
+    pool.ParallelFor(height, 16, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; y++)
+            for (unsigned int x = 0; x < width; x++)
+            {
+                glm::vec3 sum = source[y * stride + x] * weights[0];
+                for (int i = 1; i <= radius; i++)
+                {
+                    // clamped to the edge like the GL render targets
+                    if (isHorizontal) {
+                        sum += source[y * stride + min((int)width - 1, (int)x + i)] * weights[i];
+                        sum += source[y * stride + max(0, (int)x - i)] * weights[i];
+                    } else {
+                        sum += source[min((int)height - 1, (int)y + i) * stride + x] * weights[i];
+                        sum += source[max(0, (int)y - i) * stride + x] * weights[i];
+                    }
+                }
+                target[y * stride + x] = sum;
+            }
+    });
+}
@@ -0,0 +1,121 @@
+#pragma once
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "ClusteredLighting.h"
+#include "SoftwareTexture.h"
+#include "ThreadPool.h"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+enum SOFTWARE_SHADING {
+    SOFTWARE_NORMAL_MAPPED, // Blinn-Phong with diffuse, normal and specular maps, like nm_quad.frag
+    SOFTWARE_REFLECTION,    // skybox reflected by the surface, like SkyboxReflection/shader.frag
+    SOFTWARE_REFRACTION,    // skybox seen through glass
+    SOFTWARE_UNLIT          // flat color, like light_cube.frag
+};
+
+struct SoftwareMaterial {
+    SOFTWARE_SHADING shading;
+    const SoftwareTexture *diffuse;  // color is used when there is none
+    const SoftwareTexture *normal;   // tangent space, the vertex normal is used when there is none
+    const SoftwareTexture *specular; // the specular strength is 0.2 when there is none
+    glm::vec3 color;
+};
+
+// Draws meshes on the CPU without any GL context, for machines with no GPU at all and as a reference picture.
+// DrawMesh transforms the vertices on the worker threads and sorts the triangles into 32x32 pixel tiles.
+// EndFrame then gives every thread whole tiles: the triangles of a tile are rasterized 4 pixels at a time with SSE
+// into a depth buffer that remembers the nearest triangle of each pixel, and only that triangle is shaded,
+// so hidden surfaces cost no shading. Pixels no triangle covers show the skybox.
+class SoftwareRenderer
+{
+public:
+    SoftwareRenderer(ThreadPool &pool, unsigned int width, unsigned int height);
+    ~SoftwareRenderer();
+
+    void Resize(unsigned int width, unsigned int height);
+    // each path is loaded once, textures live as long as the renderer; nullptr if it couldn't be loaded
+    const SoftwareTexture *LoadTexture(const string &path);
+    void SetSkybox(const SoftwareCubemap *skybox);
+    void SetLights(const vector<Light> &lights);
+
+    // forgets the previous frame's triangles
+    void BeginFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos);
+    // only the vertex data of the mesh is used, it may be a CPU-only mesh
+    void DrawMesh(const Mesh &mesh, const glm::mat4 &model, const SoftwareMaterial &material);
+    // rasterizes and shades everything drawn since BeginFrame
+    void EndFrame();
+    // the Gaussian blur post effect with the weights of setGaussianBlurUniforms
+    void Blur(int radius);
+
+    // 8-bit RGB, top row first
+    void ReadPixels(vector<unsigned char> &rgb, float gamma = 1.f) const;
+    // TGA, BMP or DDS by the extension (SOIL)
+    bool SaveImage(const string &path, float gamma = 1.f) const;
+
+    unsigned int GetWidth() const;
+    unsigned int GetHeight() const;
+    unsigned int GetTriangleCount() const;
+    // normalized device depth of the nearest triangle at pixel (x, y), y going up like GL's; 1 where nothing is drawn
+    float GetDepth(unsigned int x, unsigned int y) const;
+
+private:
+    static const unsigned int TILE_SIZE = 32;
+    static const unsigned int NO_TRIANGLE = 0xFFFFFFFFu;
+
+    // vertex shader output
+    struct ShadedVertex {
+        glm::vec4 clip;
+        glm::vec3 worldPos;
+        glm::vec3 normal;
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+        glm::vec2 uv;
+    };
+    // screen-space setup shared by the rasterizer and the shading
+    struct Triangle {
+        unsigned int vertices[3];
+        unsigned int material;
+        float x[3], y[3], z[3], invW[3];
+        float invArea;
+    };
+
+    ThreadPool &pool;
+    unsigned int width, height;
+    unsigned int stride; // row length padded to a multiple of 4
+    unsigned int tilesX, tilesY;
+
+    glm::mat4 viewProjection;
+    glm::mat4 inverseViewProjection;
+    glm::vec3 viewPos;
+    const SoftwareCubemap *skybox;
+    vector<Light> lights;
+    map<string, SoftwareTexture *> textures;
+
+    vector<ShadedVertex> vertices;
+    vector<Triangle> triangles;
+    vector<SoftwareMaterial> materials;
+    vector<vector<unsigned int> > tileTriangles;
+
+    vector<float> depth;
+    vector<unsigned int> nearestTriangle;
+    vector<glm::vec3> color;
+    vector<glm::vec3> blurScratch;
+
+    void addClippedTriangle(unsigned int a, unsigned int b, unsigned int c, unsigned int material);
+    void addTriangle(unsigned int a, unsigned int b, unsigned int c, unsigned int material);
+    void renderTile(unsigned int tile);
+    glm::vec3 shadePixel(const Triangle &triangle, float px, float py) const;
+    glm::vec3 shadeNormalMapped(const SoftwareMaterial &material, const glm::vec3 &position, const glm::vec2 &uv,
+                                const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent) const;
+    glm::vec3 background(float px, float py) const;
+    void blurPass(const vector<glm::vec3> &source, vector<glm::vec3> &target, int radius, bool isHorizontal);
+};
+#endif
@@ -0,0 +1,114 @@
+#include "SoftwareTexture.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+#include <cmath>
+
+SoftwareTexture::SoftwareTexture() : width(0), height(0)
+{
+}
+
+bool SoftwareTexture::Load(const string &path)
+{
+    int imageWidth, imageHeight, components;
+    unsigned char *data = SOIL_load_image(path.c_str(), &imageWidth, &imageHeight, &components, SOIL_LOAD_RGB);
+    if (!data) {
+        LOG(LOG_ERROR) << "ERROR::SOFTWARE_TEXTURE::LOAD:: Texture failed to load at path: " << path;
+        return false;
+    }
+    width = imageWidth;
+    height = imageHeight;
+    texels.resize(width * height);
+    for (unsigned int i = 0; i < texels.size(); i++)
+        texels[i] = glm::vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]) / 255.f;
+    SOIL_free_image_data(data);
+    return true;
+}
+
+glm::vec3 SoftwareTexture::Sample(const glm::vec2 &uv) const
+{
+    return sample(uv.x, uv.y, true);
+}
+
+glm::vec3 SoftwareTexture::SampleClamped(const glm::vec2 &uv) const
+{
+    return sample(uv.x, uv.y, false);
+}
+
+unsigned int SoftwareTexture::GetWidth() const
+{
+    return width;
+}
+
+unsigned int SoftwareTexture::GetHeight() const
+{
+    return height;
+}
+
+glm::vec3 SoftwareTexture::texel(int x, int y) const
+{
+    return texels[y * width + x];
+}
+
+glm::vec3 SoftwareTexture::sample(float u, float v, bool isRepeating) const
+{
+    if (texels.empty())
+        return glm::vec3(1.f);
+    // texel centers are at half-integers, as in GL
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    float floorX = std::floor(x), floorY = std::floor(y);
+    float fractionX = x - floorX, fractionY = y - floorY;
+    int x0 = (int)floorX, y0 = (int)floorY;
+    int x1 = x0 + 1, y1 = y0 + 1;
+    if (isRepeating) {
+        x0 = ((x0 % (int)width) + width) % width;
+        x1 = ((x1 % (int)width) + width) % width;
+        y0 = ((y0 % (int)height) + height) % height;
+        y1 = ((y1 % (int)height) + height) % height;
+    } else {
+        x0 = glm::clamp(x0, 0, (int)width - 1);
+        x1 = glm::clamp(x1, 0, (int)width - 1);
+        y0 = glm::clamp(y0, 0, (int)height - 1);
+        y1 = glm::clamp(y1, 0, (int)height - 1);
+    }
+    glm::vec3 bottom = texel(x0, y0) * (1.f - fractionX) + texel(x1, y0) * fractionX;
+    glm::vec3 top = texel(x0, y1) * (1.f - fractionX) + texel(x1, y1) * fractionX;
+    return bottom * (1.f - fractionY) + top * fractionY;
+}
+
+bool SoftwareCubemap::Load(const vector<string> &faces, const string &directory)
+{
+    bool isLoaded = faces.size() == 6;
+    for (unsigned int i = 0; i < 6 && i < faces.size(); i++)
+        isLoaded = this->faces[i].Load(directory + "/" + faces[i]) && isLoaded;
+    return isLoaded;
+}
+
+glm::vec3 SoftwareCubemap::Sample(const glm::vec3 &direction) const
+{
+    // major axis picks the face, the other two components are the face coordinates (GL spec, table 8.19)
+    glm::vec3 absolute = glm::abs(direction);
+    unsigned int face;
+    float sc, tc, ma;
+    if (absolute.x >= absolute.y && absolute.x >= absolute.z) {
+        face = direction.x > 0.f ? 0 : 1;
+        sc = direction.x > 0.f ? -direction.z : direction.z;
+        tc = -direction.y;
+        ma = absolute.x;
+    } else if (absolute.y >= absolute.z) {
+        face = direction.y > 0.f ? 2 : 3;
+        sc = direction.x;
+        tc = direction.y > 0.f ? direction.z : -direction.z;
+        ma = absolute.y;
+    } else {
+        face = direction.z > 0.f ? 4 : 5;
+        sc = direction.z > 0.f ? direction.x : -direction.x;
+        tc = -direction.y;
+        ma = absolute.z;
+    }
+    if (ma <= 0.f)
+        return glm::vec3(0.f);
+    return faces[face].SampleClamped(glm::vec2((sc / ma + 1.f) * 0.5f, (tc / ma + 1.f) * 0.5f));
+}
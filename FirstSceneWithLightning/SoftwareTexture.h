@@ -0,0 +1,46 @@
+#pragma once
+#ifndef SOFTWARE_TEXTURE_H
+#define SOFTWARE_TEXTURE_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Image in main memory for the software renderer. Rows are kept in file order like glTexImage2D gets them,
+// so texture coordinates mean the same as in the GL shaders.
+class SoftwareTexture
+{
+public:
+    SoftwareTexture();
+
+    bool Load(const string &path);
+    // bilinear, repeating like GL_REPEAT, rgb in [0, 1]
+    glm::vec3 Sample(const glm::vec2 &uv) const;
+    // bilinear, clamped like GL_CLAMP_TO_EDGE
+    glm::vec3 SampleClamped(const glm::vec2 &uv) const;
+
+    unsigned int GetWidth() const;
+    unsigned int GetHeight() const;
+
+private:
+    unsigned int width, height;
+    vector<glm::vec3> texels;
+
+    glm::vec3 texel(int x, int y) const;
+    glm::vec3 sample(float u, float v, bool isRepeating) const;
+};
+
+// The six faces of a skybox, sampled by direction with the GL cube map face rules
+class SoftwareCubemap
+{
+public:
+    // faces in the GL order +X, -X, +Y, -Y, +Z, -Z
+    bool Load(const vector<string> &faces, const string &directory);
+    glm::vec3 Sample(const glm::vec3 &direction) const;
+
+private:
+    SoftwareTexture faces[6];
+};
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity has to be a power of two; one slot is always kept free to tell a full queue from an empty one.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer side, returns false (and drops the item) if the queue is full
+    bool Push(const T &item)
+    {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t nextTail = (currentTail + 1) & (Capacity - 1);
+        if (nextTail == head.load(std::memory_order_acquire))
+            return false;
+        buffer[currentTail] = item;
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, returns false if there is nothing to take
+    bool Pop(T &item)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+            return false;
+        item = buffer[currentHead];
+        head.store((currentHead + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+    T buffer[Capacity];
+    // head and tail live on separate cache lines so the two threads don't fight over one line
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+#endif
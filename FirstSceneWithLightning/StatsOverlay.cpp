@@ -0,0 +1,115 @@
+#include "StatsOverlay.h"
+#include "GlStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// std::min takes it by reference
+const unsigned int StatsOverlay::HISTORY;
+
+StatsOverlay::StatsOverlay(unsigned int quadVAO)
+    : shader("Shaders/StatsOverlay/overlay.vert", "Shaders/StatsOverlay/overlay.frag"), quadVAO(quadVAO),
+      nextFrame(0), frameCount(0)
+{
+    for (unsigned int i = 0; i < HISTORY; i++)
+        frameTimes[i] = 0.f;
+    for (unsigned int i = 0; i < TEXT_ROWS * TEXT_COLUMNS; i++)
+        text[i] = glyphIndex(' ');
+}
+
+void StatsOverlay::AddFrame(float frameMs)
+{
+    frameTimes[nextFrame] = frameMs;
+    nextFrame = (nextFrame + 1) % HISTORY;
+    frameCount = std::min(frameCount + 1, HISTORY);
+}
+
+float StatsOverlay::GetPercentile(float percentile) const
+{
+    if (frameCount == 0)
+        return 0.f;
+    // the filled part of the ring is the first frameCount entries until it wraps, all of it afterwards
+    vector<float> sorted(frameTimes, frameTimes + frameCount);
+    unsigned int rank = std::min((unsigned int)(percentile / 100.f * frameCount), frameCount - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+void StatsOverlay::Draw(unsigned int screenWidth, unsigned int screenHeight, float budgetMs)
+{
+    float p50 = GetPercentile(50.f), p95 = GetPercentile(95.f), p99 = GetPercentile(99.f);
+    char line[64];
+    snprintf(line, sizeof(line), "P50 %.1f  P95 %.1f  P99 %.1f MS", p50, p95, p99);
+    setLine(0, line);
+    setLine(1, "DRAWS " + formatCount(GlStats::Get(GL_STAT_DRAW_CALLS)) + "  TRIS " + formatCount(GlStats::Get(GL_STAT_TRIANGLES)));
+    setLine(2, "PROGRAMS " + formatCount(GlStats::Get(GL_STAT_PROGRAM_SWITCHES))
+        + "  TEXTURES " + formatCount(GlStats::Get(GL_STAT_TEXTURE_BINDS)));
+    snprintf(line, sizeof(line), "  UPLOAD %.1f KB", (GlStats::Get(GL_STAT_BUFFER_BYTES) + GlStats::Get(GL_STAT_TEXTURE_BYTES)) / 1024.0);
+    setLine(3, "UNIFORMS " + formatCount(GlStats::Get(GL_STAT_UNIFORM_UPLOADS)) + line);
+
+    // oldest first, frames that haven't happened yet are empty bars
+    float ordered[HISTORY];
+    for (unsigned int i = 0; i < HISTORY; i++)
+        ordered[i] = frameTimes[(nextFrame + i) % HISTORY];
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glViewport(0, 0, screenWidth, screenHeight);
+    shader.Use();
+    // 6 pixel padding around the text and the graph, 8x12 pixel cells
+    shader.setVec4("rect", glm::vec4(10.f, 10.f, TEXT_COLUMNS * 8.f + 12.f, TEXT_ROWS * 12.f + 18.f + 80.f));
+    shader.setVec2("screenSize", (float)screenWidth, (float)screenHeight);
+    shader.setVec3("percentiles", glm::vec3(p50, p95, p99));
+    shader.setFloat("graphMs", std::max(budgetMs * 2.f, p99 * 1.25f));
+    shader.setFloat("budgetMs", budgetMs);
+    glUniform4iv(glGetUniformLocation(shader.ID, "text"), TEXT_ROWS * TEXT_COLUMNS / 4, text);
+    glUniform4fv(glGetUniformLocation(shader.ID, "frameTimes"), HISTORY / 4, ordered);
+    GlStats::Count(GL_STAT_UNIFORM_UPLOADS, 2);
+    glBindVertexArray(quadVAO);
+    GlStats::DrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+}
+
+void StatsOverlay::Clear()
+{
+    shader.Delete();
+}
+
+void StatsOverlay::setLine(unsigned int row, const string &line)
+{
+    for (unsigned int i = 0; i < TEXT_COLUMNS; i++)
+        text[row * TEXT_COLUMNS + i] = glyphIndex(i < line.size() ? line[i] : ' ');
+}
+
+int StatsOverlay::glyphIndex(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'Z')
+        return 10 + c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return 10 + c - 'a';
+    switch (c) {
+    case '.': return 37;
+    case ':': return 38;
+    case '/': return 39;
+    case '%': return 40;
+    case '-': return 41;
+    default: return 36; // space
+    }
+}
+
+string StatsOverlay::formatCount(unsigned long long count)
+{
+    char text[32];
+    if (count < 1000)
+        snprintf(text, sizeof(text), "%llu", count);
+    else if (count < 1000000)
+        snprintf(text, sizeof(text), "%.1fK", count / 1000.0);
+    else
+        snprintf(text, sizeof(text), "%.1fM", count / 1000000.0);
+    return text;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+#include <string>
+using namespace std;
+
+// Frame times of the last HISTORY frames with their p50/p95/p99, drawn in the top left corner of the screen
+// together with the GlStats counters of the last frame: a few lines of text and a graph of the frame times.
+// The text is a 3x5 font in the fragment shader, the whole overlay is one quad.
+class StatsOverlay
+{
+public:
+    // have to match Shaders/StatsOverlay/overlay.frag
+    static const unsigned int TEXT_ROWS = 4;
+    static const unsigned int TEXT_COLUMNS = 36;
+    static const unsigned int HISTORY = 120;
+
+    // quadVAO is the screen quad of the post effects
+    StatsOverlay(unsigned int quadVAO);
+
+    // the oldest frame drops out of the window
+    void AddFrame(float frameMs);
+    // of the frames in the window, percentile in [0, 100]
+    float GetPercentile(float percentile) const;
+    // over whatever is bound as the draw framebuffer, budgetMs is the frame time the graph marks
+    void Draw(unsigned int screenWidth, unsigned int screenHeight, float budgetMs);
+    void Clear();
+
+private:
+    Shader shader;
+    unsigned int quadVAO;
+    float frameTimes[HISTORY]; // ring, the oldest one is at nextFrame
+    unsigned int nextFrame, frameCount;
+    int text[TEXT_ROWS * TEXT_COLUMNS]; // glyph indices of the font in the shader
+
+    void setLine(unsigned int row, const string &line);
+    static int glyphIndex(char c);
+    // 950, 12.3K, 4.5M
+    static string formatCount(unsigned long long count);
+};
+#endif
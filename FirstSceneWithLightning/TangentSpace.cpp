@@ -0,0 +1,263 @@
+#include "TangentSpace.h"
+#include "Simd.h"
+
+#include <cfloat>
+#include <cmath>
+
+// triangles and vertices per ParallelFor chunk, meshes of one chunk or less are done in place
+static const unsigned int TRIANGLE_CHUNK = 2048;
+static const unsigned int VERTEX_CHUNK = 4096;
+
+static void runChunks(ThreadPool *pool, unsigned int count, unsigned int chunkSize, const function<void(unsigned int, unsigned int)> &job)
+{
+    if (pool && count > chunkSize)
+        pool->ParallelFor(count, chunkSize, job);
+    else if (count)
+        job(0, count);
+}
+
+static glm::vec3 safeNormalize(const glm::vec3 &v)
+{
+    float lengthSquared = glm::dot(v, v);
+    return lengthSquared > FLT_MIN ? v / sqrtf(lengthSquared) : glm::vec3(0.f);
+}
+
+// element i of a TangentSource attribute
+template <typename T> static const T &attribute(const void *start, size_t stride, unsigned int i)
+{
+    return *(const T *)((const unsigned char *)start + stride * i);
+}
+
+static const glm::vec3 &position(const TangentSource &source, unsigned int i)
+{
+    return attribute<glm::vec3>(source.positions, source.positionStride, i);
+}
+
+static const glm::vec3 &normalOf(const TangentSource &source, unsigned int i)
+{
+    return attribute<glm::vec3>(source.normals, source.normalStride, i);
+}
+
+static const glm::vec2 &texCoords(const TangentSource &source, unsigned int i)
+{
+    return attribute<glm::vec2>(source.texCoords, source.texCoordStride, i);
+}
+
+// corner angle from its cosine, weight of the corner's tangent at its vertex. Negative for a triangle with
+// mirrored texture coordinates, 0 for one that has no texture space (degenerate positions or coordinates)
+static float cornerWeight(float cosine, float orientation, bool isValid)
+{
+    cosine = cosine < -1.f ? -1.f : (cosine > 1.f ? 1.f : cosine);
+    return isValid ? acosf(cosine) * orientation : 0.f;
+}
+
+// every corner of the triangle of vertices v gets xyz - the face tangent projected onto the corner normal's plane
+// and normalized, pointing along +u of the texture, w - cornerWeight
+static void triangleCorners(const TangentSource &source, const unsigned int v[3], glm::vec4 corners[3])
+{
+    glm::vec3 edge1 = position(source, v[1]) - position(source, v[0]);
+    glm::vec3 edge2 = position(source, v[2]) - position(source, v[0]);
+    glm::vec2 deltaUV1 = texCoords(source, v[1]) - texCoords(source, v[0]);
+    glm::vec2 deltaUV2 = texCoords(source, v[2]) - texCoords(source, v[0]);
+    // twice the signed area in texture space, the tangent is faceTangent / area
+    float area = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+    glm::vec3 faceTangent = edge1 * deltaUV2.y - edge2 * deltaUV1.y;
+    float orientation = area > 0.f ? 1.f : -1.f;
+    bool isValid = fabsf(area) > FLT_MIN;
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        glm::vec3 normal = safeNormalize(normalOf(source, v[c]));
+        glm::vec3 tangent = safeNormalize(faceTangent - normal * glm::dot(normal, faceTangent)) * orientation;
+        glm::vec3 toNext = position(source, v[(c + 1) % 3]) - position(source, v[c]);
+        glm::vec3 toPrevious = position(source, v[(c + 2) % 3]) - position(source, v[c]);
+        toNext = safeNormalize(toNext - normal * glm::dot(normal, toNext));
+        toPrevious = safeNormalize(toPrevious - normal * glm::dot(normal, toPrevious));
+        corners[c] = glm::vec4(tangent, cornerWeight(glm::dot(toNext, toPrevious), orientation, isValid));
+    }
+}
+
+#if USE_SSE
+// x, y and z of 4 vectors, one per lane
+struct Vec3x4 {
+    __m128 x, y, z;
+};
+
+static Vec3x4 gather(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d)
+{
+    Vec3x4 r;
+    r.x = _mm_setr_ps(a.x, b.x, c.x, d.x);
+    r.y = _mm_setr_ps(a.y, b.y, c.y, d.y);
+    r.z = _mm_setr_ps(a.z, b.z, c.z, d.z);
+    return r;
+}
+
+static Vec3x4 sub(const Vec3x4 &a, const Vec3x4 &b)
+{
+    Vec3x4 r = { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+    return r;
+}
+
+static Vec3x4 scale(const Vec3x4 &a, __m128 s)
+{
+    Vec3x4 r = { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+    return r;
+}
+
+static __m128 dot(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// a - n * dot(n, a), n is normalized
+static Vec3x4 projectOnPlane(const Vec3x4 &a, const Vec3x4 &n)
+{
+    return sub(a, scale(n, dot(n, a)));
+}
+
+// zero vectors stay zero, like safeNormalize
+static Vec3x4 normalize(const Vec3x4 &a)
+{
+    __m128 lengthSquared = dot(a, a);
+    __m128 isLong = _mm_cmpgt_ps(lengthSquared, _mm_set1_ps(FLT_MIN));
+    Vec3x4 r = scale(a, _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(lengthSquared)));
+    r.x = _mm_and_ps(isLong, r.x);
+    r.y = _mm_and_ps(isLong, r.y);
+    r.z = _mm_and_ps(isLong, r.z);
+    return r;
+}
+
+// triangleCorners for 4 triangles at once, everything but the acos of the corner angles is done in the lanes
+static void triangleCorners4(const TangentSource &source, const unsigned int v[4][3], glm::vec4 corners[12])
+{
+    Vec3x4 position[3], normal[3];
+    __m128 texU[3], texV[3];
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        position[c] = gather(::position(source, v[0][c]), ::position(source, v[1][c]), ::position(source, v[2][c]), ::position(source, v[3][c]));
+        normal[c] = normalize(gather(normalOf(source, v[0][c]), normalOf(source, v[1][c]), normalOf(source, v[2][c]), normalOf(source, v[3][c])));
+        const glm::vec2 uv[4] = { texCoords(source, v[0][c]), texCoords(source, v[1][c]), texCoords(source, v[2][c]), texCoords(source, v[3][c]) };
+        texU[c] = _mm_setr_ps(uv[0].x, uv[1].x, uv[2].x, uv[3].x);
+        texV[c] = _mm_setr_ps(uv[0].y, uv[1].y, uv[2].y, uv[3].y);
+    }
+    Vec3x4 edge1 = sub(position[1], position[0]);
+    Vec3x4 edge2 = sub(position[2], position[0]);
+    __m128 deltaU1 = _mm_sub_ps(texU[1], texU[0]), deltaV1 = _mm_sub_ps(texV[1], texV[0]);
+    __m128 deltaU2 = _mm_sub_ps(texU[2], texU[0]), deltaV2 = _mm_sub_ps(texV[2], texV[0]);
+    __m128 area = _mm_sub_ps(_mm_mul_ps(deltaU1, deltaV2), _mm_mul_ps(deltaU2, deltaV1));
+    Vec3x4 faceTangent = sub(scale(edge1, deltaV2), scale(edge2, deltaV1));
+    __m128 isPositive = _mm_cmpgt_ps(area, _mm_setzero_ps());
+    __m128 orientation = _mm_or_ps(_mm_and_ps(isPositive, _mm_set1_ps(1.f)), _mm_andnot_ps(isPositive, _mm_set1_ps(-1.f)));
+    __m128 absArea = _mm_andnot_ps(_mm_set1_ps(-0.f), area);
+    int validMask = _mm_movemask_ps(_mm_cmpgt_ps(absArea, _mm_set1_ps(FLT_MIN)));
+    float orientations[4];
+    _mm_storeu_ps(orientations, orientation);
+
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        Vec3x4 tangent = scale(normalize(projectOnPlane(faceTangent, normal[c])), orientation);
+        Vec3x4 toNext = normalize(projectOnPlane(sub(position[(c + 1) % 3], position[c]), normal[c]));
+        Vec3x4 toPrevious = normalize(projectOnPlane(sub(position[(c + 2) % 3], position[c]), normal[c]));
+        float x[4], y[4], z[4], cosine[4];
+        _mm_storeu_ps(x, tangent.x);
+        _mm_storeu_ps(y, tangent.y);
+        _mm_storeu_ps(z, tangent.z);
+        _mm_storeu_ps(cosine, dot(toNext, toPrevious));
+        for (unsigned int i = 0; i < 4; i++)
+            corners[i * 3 + c] = glm::vec4(x[i], y[i], z[i], cornerWeight(cosine[i], orientations[i], (validMask >> i) & 1));
+    }
+}
+#endif
+
+// some tangent for a vertex no triangle gave one to
+static glm::vec3 anyPerpendicular(const glm::vec3 &normal)
+{
+    glm::vec3 axis = fabsf(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    return glm::normalize(axis - normal * glm::dot(normal, axis));
+}
+
+// the tangent and bitangent of vertex i go to the vec3s outputStride * i bytes after tangents and bitangents
+static void generate(const TangentSource &source, const vector<unsigned int> &indices, glm::vec3 *tangents, glm::vec3 *bitangents,
+                     size_t outputStride, ThreadPool *pool)
+{
+    const unsigned int triangleCount = (unsigned int)(indices.empty() ? source.vertexCount : indices.size()) / 3;
+    const unsigned int vertexCount = source.vertexCount;
+    auto cornerVertex = [&indices](unsigned int corner) { return indices.empty() ? corner : indices[corner]; };
+
+    // 1. what every triangle corner gives to its vertex
+    vector<glm::vec4> corners(triangleCount * 3);
+    runChunks(pool, triangleCount, TRIANGLE_CHUNK, [&](unsigned int begin, unsigned int end) {
+        unsigned int t = begin;
+#if USE_SSE
+        for (; t + 4 <= end; t += 4)
+        {
+            unsigned int v[4][3];
+            for (unsigned int i = 0; i < 4; i++)
+                for (unsigned int c = 0; c < 3; c++)
+                    v[i][c] = cornerVertex((t + i) * 3 + c);
+            triangleCorners4(source, v, &corners[t * 3]);
+        }
+#endif
+        for (; t < end; t++)
+        {
+            const unsigned int v[3] = { cornerVertex(t * 3), cornerVertex(t * 3 + 1), cornerVertex(t * 3 + 2) };
+            triangleCorners(source, v, &corners[t * 3]);
+        }
+    });
+
+    // 2. corners of every vertex, cornerStart[i]..cornerStart[i + 1] in vertexCorners
+    vector<unsigned int> cornerStart(vertexCount + 1, 0);
+    for (unsigned int corner = 0; corner < triangleCount * 3; corner++)
+        cornerStart[cornerVertex(corner) + 1]++;
+    for (unsigned int i = 0; i < vertexCount; i++)
+        cornerStart[i + 1] += cornerStart[i];
+    vector<unsigned int> vertexCorners(triangleCount * 3);
+    vector<unsigned int> nextCorner(cornerStart.begin(), cornerStart.end() - 1);
+    for (unsigned int corner = 0; corner < triangleCount * 3; corner++)
+        vertexCorners[nextCorner[cornerVertex(corner)]++] = corner;
+
+    // 3. the angle-weighted sum of the corners with the vertex's handedness, orthogonalized against its normal
+    runChunks(pool, vertexCount, VERTEX_CHUNK, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            float handedness = 0.f;
+            for (unsigned int k = cornerStart[i]; k < cornerStart[i + 1]; k++)
+                handedness += corners[vertexCorners[k]].w;
+            float sign = handedness < 0.f ? -1.f : 1.f;
+            glm::vec3 sum(0.f);
+            for (unsigned int k = cornerStart[i]; k < cornerStart[i + 1]; k++)
+            {
+                const glm::vec4 &corner = corners[vertexCorners[k]];
+                if (corner.w * sign > 0.f)
+                    sum += glm::vec3(corner) * fabsf(corner.w);
+            }
+            glm::vec3 normal = safeNormalize(normalOf(source, i));
+            glm::vec3 tangent = safeNormalize(sum - normal * glm::dot(normal, sum));
+            if (tangent == glm::vec3(0.f))
+                tangent = anyPerpendicular(normal);
+            *(glm::vec3 *)((unsigned char *)tangents + outputStride * i) = tangent;
+            *(glm::vec3 *)((unsigned char *)bitangents + outputStride * i) = sign * glm::cross(normal, tangent);
+        }
+    });
+}
+
+void GenerateTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices, ThreadPool *pool)
+{
+    if (vertices.empty())
+        return;
+    TangentSource source;
+    source.vertexCount = (unsigned int)vertices.size();
+    source.positions = &vertices[0].Position;
+    source.normals = &vertices[0].Normal;
+    source.texCoords = &vertices[0].TexCoords;
+    source.positionStride = source.normalStride = source.texCoordStride = sizeof(Vertex);
+    generate(source, indices, &vertices[0].Tangent, &vertices[0].Bitangent, sizeof(Vertex), pool);
+}
+
+void GenerateTangents(const TangentSource &source, const vector<unsigned int> &indices, vector<glm::vec3> &tangents,
+                      vector<glm::vec3> &bitangents, ThreadPool *pool)
+{
+    tangents.resize(source.vertexCount);
+    bitangents.resize(source.vertexCount);
+    if (source.vertexCount)
+        generate(source, indices, &tangents[0], &bitangents[0], sizeof(glm::vec3), pool);
+}
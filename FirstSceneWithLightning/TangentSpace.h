@@ -0,0 +1,34 @@
+#pragma once
+#ifndef TANGENT_SPACE_H
+#define TANGENT_SPACE_H
+
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <vector>
+using namespace std;
+
+// Per-vertex tangents and bitangents for normal mapping, the way MikkTSpace builds them: every triangle corner
+// contributes its face tangent projected onto the vertex normal, weighted by the corner angle, and the bitangent
+// is cross(Normal, Tangent) times the handedness of the texture mapping.
+// MikkTSpace splits vertices whose triangles disagree on the handedness (mirrored UVs), here the index buffer
+// stays as it is and such a vertex takes the handedness with the larger angle; only corners of it count.
+// Vertices without usable texture coordinates get some tangent perpendicular to the normal.
+//
+// indices is a triangle list, empty for a non-indexed one. Normals don't have to be normalized.
+// With a pool the triangles and then the vertices are split into chunks, small meshes run in place anyway.
+void GenerateTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices, ThreadPool *pool = nullptr);
+
+// Vertex attributes that aren't in a vector<Vertex>, e.g. straight from the importer: element i of an attribute is
+// stride * i bytes after its start, a stride of 0 repeats the first element for every vertex
+struct TangentSource {
+    unsigned int vertexCount;
+    const void *positions, *normals; // glm::vec3
+    const void *texCoords;           // glm::vec2
+    size_t positionStride, normalStride, texCoordStride;
+};
+// the same into side arrays, for vertices that are written straight into a mapped buffer afterwards.
+// tangents and bitangents get source.vertexCount elements
+void GenerateTangents(const TangentSource &source, const vector<unsigned int> &indices, vector<glm::vec3> &tangents,
+                      vector<glm::vec3> &bitangents, ThreadPool *pool = nullptr);
+#endif
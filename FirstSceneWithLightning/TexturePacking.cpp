@@ -0,0 +1,105 @@
+#include "TexturePacking.h"
+#include "TextureStreaming.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+#include <fstream>
+#include <vector>
+
+// decodes path to components channels, the first map decides width and height and the others are scaled to it
+static bool loadMap(const string &path, int components, unsigned int &width, unsigned int &height, vector<unsigned char> &texels)
+{
+    int imageWidth, imageHeight, imageComponents;
+    unsigned char *data = SOIL_load_image(path.c_str(), &imageWidth, &imageHeight, &imageComponents,
+                                          components == 1 ? SOIL_LOAD_L : SOIL_LOAD_RGB);
+    if (!data) {
+        LOG(LOG_ERROR) << "ERROR::TEXTURE_PACKING::LOAD:: Texture failed to load at path: " << path;
+        return false;
+    }
+    texels.assign(data, data + imageWidth * imageHeight * components);
+    SOIL_free_image_data(data);
+    if (width == 0) {
+        width = imageWidth;
+        height = imageHeight;
+    } else if ((unsigned int)imageWidth != width || (unsigned int)imageHeight != height) {
+        vector<unsigned char> scaled;
+        resizeImage(texels, imageWidth, imageHeight, components, width, height, scaled);
+        texels.swap(scaled);
+    }
+    return true;
+}
+
+bool PackTextureChannels(const string &normalPath, const string &heightPath, const string &specularPath, const string &outputPath)
+{
+    unsigned int width = 0, height = 0;
+    vector<unsigned char> normals, heights, speculars;
+    if (!normalPath.empty() && !loadMap(normalPath, 3, width, height, normals))
+        return false;
+    if (!heightPath.empty() && !loadMap(heightPath, 1, width, height, heights))
+        return false;
+    if (!specularPath.empty() && !loadMap(specularPath, 1, width, height, speculars))
+        return false;
+    if (width == 0) {
+        LOG(LOG_ERROR) << "ERROR::TEXTURE_PACKING::PACK:: Nothing to pack into " << outputPath;
+        return false;
+    }
+
+    vector<unsigned char> packed(width * height * 4);
+    for (unsigned int i = 0; i < width * height; i++)
+    {
+        packed[i * 4] = normals.empty() ? 128 : normals[i * 3];
+        packed[i * 4 + 1] = normals.empty() ? 128 : normals[i * 3 + 1];
+        packed[i * 4 + 2] = heights.empty() ? 0 : heights[i];
+        packed[i * 4 + 3] = speculars.empty() ? 255 : speculars[i];
+    }
+    // TGA is lossless, JPEG would smear the normals
+    if (!SOIL_save_image(outputPath.c_str(), SOIL_SAVE_TYPE_TGA, width, height, 4, &packed[0])) {
+        LOG(LOG_ERROR) << "ERROR::TEXTURE_PACKING::SAVE:: Couldn't write " << outputPath;
+        return false;
+    }
+    return true;
+}
+
+void PackSceneTextures(SceneDescription &scene)
+{
+    for (unsigned int m = 0; m < scene.materials.size(); m++)
+    {
+        SceneMaterial &material = scene.materials[m];
+        string normalPath, heightPath, specularPath, directory;
+        bool isPacked = false;
+        for (unsigned int t = 0; t < material.textures.size(); t++)
+        {
+            const SceneMaterialTexture &texture = material.textures[t];
+            if (texture.type == "texture_normal" && normalPath.empty())
+                normalPath = texture.path;
+            else if (texture.type == "texture_height" && heightPath.empty())
+                heightPath = texture.path;
+            else if (texture.type == "texture_specular" && specularPath.empty())
+                specularPath = texture.path;
+            else if (texture.type == "texture_packed")
+                isPacked = true;
+            else
+                continue;
+            if (directory.empty())
+                directory = texture.path.substr(0, texture.path.find_last_of("/\\") + 1);
+        }
+        if (isPacked || (normalPath.empty() && heightPath.empty() && specularPath.empty()))
+            continue;
+        SceneMaterialTexture packed;
+        packed.type = "texture_packed";
+        packed.path = directory + material.name + "_PACKED.tga";
+        if (PackTextureChannels(normalPath, heightPath, specularPath, packed.path))
+            material.textures.push_back(packed);
+    }
+}
+
+bool ArePackedTexturesPresent(const SceneDescription &scene)
+{
+    for (unsigned int m = 0; m < scene.materials.size(); m++)
+        for (unsigned int t = 0; t < scene.materials[m].textures.size(); t++)
+            if (scene.materials[m].textures[t].type == "texture_packed" &&
+                !ifstream(scene.materials[m].textures[t].path.c_str(), ios::in | ios::binary))
+                return false;
+    return true;
+}
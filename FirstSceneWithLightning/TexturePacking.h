@@ -0,0 +1,22 @@
+#pragma once
+#ifndef TEXTURE_PACKING_H
+#define TEXTURE_PACKING_H
+
+#include "SceneDescription.h"
+
+#include <string>
+using namespace std;
+
+// A material's normal, height and specular maps merged into one RGBA texture of type texture_packed:
+// normal X and Y in red and green (the shaders rebuild Z), height in blue, specular in alpha.
+// The lit scene shaders fetch it and the diffuse map instead of up to three separate textures.
+// A map that is missing is packed as its neutral value: flat normal, no depth, full specular.
+
+// writes the packed maps to outputPath as TGA, sized like the first map given; an empty path skips a map
+bool PackTextureChannels(const string &normalPath, const string &heightPath, const string &specularPath, const string &outputPath);
+// packs the maps of every material that has some and no texture_packed yet into <name>_PACKED.tga next to them
+// and adds that texture to the material. The separate maps stay in the scene for the software renderer.
+void PackSceneTextures(SceneDescription &scene);
+// false if a texture_packed file of the scene is gone
+bool ArePackedTexturesPresent(const SceneDescription &scene);
+#endif
@@ -0,0 +1,474 @@
+#include "TextureStreaming.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "Log.h"
+
+#include <SOIL.h>
+
+#include <algorithm>
+#include <cmath>
+
+static const unsigned int NO_TEXTURE = 0xFFFFFFFFu;
+
+static GLenum formatOfComponents(unsigned int components)
+{
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+void resizeImage(const vector<unsigned char> &source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned int components,
+                 unsigned int width, unsigned int height, vector<unsigned char> &target)
+{
+    // bilinear, texel centers at half-integers
+    target.resize(width * height * components);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        float sourceY = max((y + 0.5f) * sourceHeight / height - 0.5f, 0.f);
+        unsigned int y0 = min((unsigned int)sourceY, sourceHeight - 1), y1 = min(y0 + 1, sourceHeight - 1);
+        float fractionY = sourceY - y0;
+        for (unsigned int x = 0; x < width; x++)
+        {
+            float sourceX = max((x + 0.5f) * sourceWidth / width - 0.5f, 0.f);
+            unsigned int x0 = min((unsigned int)sourceX, sourceWidth - 1), x1 = min(x0 + 1, sourceWidth - 1);
+            float fractionX = sourceX - x0;
+            for (unsigned int c = 0; c < components; c++)
+            {
+                float top = source[(y0 * sourceWidth + x0) * components + c] * (1.f - fractionX) + source[(y0 * sourceWidth + x1) * components + c] * fractionX;
+                float bottom = source[(y1 * sourceWidth + x0) * components + c] * (1.f - fractionX) + source[(y1 * sourceWidth + x1) * components + c] * fractionX;
+                target[(y * width + x) * components + c] = (unsigned char)(top * (1.f - fractionY) + bottom * fractionY + 0.5f);
+            }
+        }
+    }
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, unsigned int residentSize)
+    : budgetBytes(budgetBytes), residentBytes(0), residentSize(max(residentSize, 1u)), frame(0), isStopping(false)
+{
+    loader = std::thread(&TextureStreamer::loaderLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    requestAvailable.notify_one();
+    if (loader.joinable())
+        loader.join();
+}
+
+unsigned int TextureStreamer::Load(const string &path)
+{
+    map<string, unsigned int>::iterator loaded = textureByPath.find(path);
+    if (loaded != textureByPath.end())
+        return textures[loaded->second].id;
+
+    StreamedTexture texture;
+    texture.paths.push_back(path);
+    texture.isArray = false;
+    LoadRequest request;
+    request.paths = texture.paths;
+    request.isArray = false;
+    request.width = request.height = 0;
+    request.firstLevel = 0;
+    request.lastLevel = NO_TEXTURE;
+    request.maxSize = residentSize;
+    vector<MipLevel> levels;
+    if (!decode(request, texture.width, texture.height, texture.components, levels)) {
+        texture.width = texture.height = 0;
+        texture.components = 4;
+        levels.clear();
+    }
+    textureByPath[path] = textures.size();
+    return addTexture(texture, levels);
+}
+
+unsigned int TextureStreamer::AddArray(const vector<string> &paths, const vector<vector<unsigned char> > &layers, unsigned int width, unsigned int height)
+{
+    StreamedTexture texture;
+    texture.paths = paths;
+    texture.isArray = true;
+    texture.width = width;
+    texture.height = height;
+    texture.components = 4;
+    vector<MipLevel> levels;
+    for (unsigned int i = 0; i < layers.size(); i++)
+    {
+        MipLevel image;
+        image.width = width;
+        image.height = height;
+        image.texels = layers[i];
+        appendMips(image, texture.components, 0, NO_TEXTURE, residentSize, levels);
+    }
+    return addTexture(texture, levels);
+}
+
+void TextureStreamer::Request(unsigned int texture, float screenSize)
+{
+    map<unsigned int, unsigned int>::iterator streamed = textureById.find(texture);
+    if (streamed == textureById.end())
+        return;
+    StreamedTexture &target = textures[streamed->second];
+    target.screenSize = target.lastUsedFrame == frame ? max(target.screenSize, screenSize) : screenSize;
+    target.lastUsedFrame = frame;
+}
+
+void TextureStreamer::Update(size_t uploadBytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < results.size(); i++)
+            waitingUploads.push_back(std::move(results[i]));
+        results.clear();
+    }
+    // at least one upload per frame even if it alone is bigger than uploadBytes
+    size_t uploaded = 0;
+    unsigned int applied = 0;
+    for (; applied < waitingUploads.size() && (applied == 0 || uploaded < uploadBytes); applied++)
+    {
+        LoadResult &result = waitingUploads[applied];
+        if (result.texture >= textures.size())
+            continue;
+        for (unsigned int i = 0; i < result.levels.size(); i++)
+            uploaded += levelBytes(textures[result.texture], result.levels[i].width, result.levels[i].height);
+        applyResult(result);
+    }
+    waitingUploads.erase(waitingUploads.begin(), waitingUploads.begin() + applied);
+
+    // the budget may have been lowered
+    while (residentBytes > budgetBytes && evictOne(NO_TEXTURE)) {
+    }
+
+    // what could be freed for new detail: everything above the level each texture needs now
+    size_t available = budgetBytes > residentBytes ? budgetBytes - residentBytes : 0;
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        const StreamedTexture &texture = textures[i];
+        unsigned int wanted = wantedLevel(texture);
+        if (!texture.isLoading && texture.residentLevel < wanted)
+            available += texture.residentBytes - chainBytes(texture, wanted);
+    }
+    bool hasRequests = false;
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        StreamedTexture &texture = textures[i];
+        if (texture.isLoading || texture.lastUsedFrame != frame)
+            continue;
+        unsigned int wanted = wantedLevel(texture);
+        // ask only for what the budget can hold, so a full budget doesn't decode the same file every frame
+        while (wanted < texture.residentLevel && chainBytes(texture, wanted) - texture.residentBytes > available)
+            wanted++;
+        if (wanted >= texture.residentLevel)
+            continue;
+        available -= chainBytes(texture, wanted) - texture.residentBytes;
+        LoadRequest request;
+        request.texture = i;
+        request.paths = texture.paths;
+        request.isArray = texture.isArray;
+        request.width = texture.width;
+        request.height = texture.height;
+        request.firstLevel = wanted;
+        request.lastLevel = texture.residentLevel;
+        request.maxSize = NO_TEXTURE;
+        texture.isLoading = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+        hasRequests = true;
+    }
+    if (hasRequests)
+        requestAvailable.notify_one();
+    frame++;
+}
+
+void TextureStreamer::Clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.clear();
+        results.clear();
+    }
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_TEXTURE, textures[i].id);
+        glDeleteTextures(1, &textures[i].id);
+    }
+    textures.clear();
+    textureByPath.clear();
+    textureById.clear();
+    waitingUploads.clear();
+    residentBytes = 0;
+}
+
+void TextureStreamer::SetBudget(size_t budgetBytes)
+{
+    this->budgetBytes = budgetBytes;
+}
+
+size_t TextureStreamer::GetBudget() const
+{
+    return budgetBytes;
+}
+
+size_t TextureStreamer::GetResidentBytes() const
+{
+    return residentBytes;
+}
+
+unsigned int TextureStreamer::GetLoadingCount() const
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < textures.size(); i++)
+        count += textures[i].isLoading;
+    return count;
+}
+
+unsigned int TextureStreamer::GetTextureCount() const
+{
+    return textures.size();
+}
+
+void TextureStreamer::loaderLoop()
+{
+    while (true)
+    {
+        LoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            requestAvailable.wait(lock, [this] { return isStopping || !requests.empty(); });
+            if (isStopping)
+                return;
+            request = requests.front();
+            requests.pop_front();
+        }
+        LoadResult result;
+        result.texture = request.texture;
+        result.firstLevel = request.firstLevel;
+        unsigned int width, height, components;
+        if (!decode(request, width, height, components, result.levels))
+            result.levels.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+void TextureStreamer::upload(StreamedTexture &texture, unsigned int firstLevel, vector<MipLevel> &levels)
+{
+    GLenum target = texture.isArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    glBindTexture(target, texture.id);
+    // small mips of RGB images have rows that aren't a multiple of 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t bytes = 0;
+    for (unsigned int i = 0; i < levels.size(); i++)
+    {
+        size_t uploadBytes = levelBytes(texture, levels[i].width, levels[i].height);
+        if (texture.isArray)
+            GlStats::TexImage3D(target, i, texture.format, levels[i].width, levels[i].height, texture.paths.size(), texture.format, GL_UNSIGNED_BYTE,
+                                levels[i].texels.data(), uploadBytes);
+        else
+            GlStats::TexImage2D(target, i, texture.format, levels[i].width, levels[i].height, texture.format, GL_UNSIGNED_BYTE,
+                                levels[i].texels.data(), uploadBytes);
+        bytes += uploadBytes;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    glBindTexture(target, 0);
+
+    residentBytes = residentBytes - texture.residentBytes + bytes;
+    texture.residentBytes = bytes;
+    GpuResourceRegistry::Get().SetBytes(GPU_TEXTURE, texture.id, bytes);
+    texture.residentLevel = firstLevel;
+    texture.coarserLevels.clear();
+    for (unsigned int i = 1; i < levels.size(); i++)
+        texture.coarserLevels.push_back(std::move(levels[i]));
+}
+
+unsigned int TextureStreamer::addTexture(StreamedTexture &texture, vector<MipLevel> &levels)
+{
+    glGenTextures(1, &texture.id);
+    GpuResourceRegistry::Get().Add(GPU_TEXTURE, texture.id, 0, texture.paths.empty() ? string("texture streamer") : texture.paths[0]);
+    texture.format = formatOfComponents(texture.components);
+    texture.smallestLevel = texture.residentLevel = texture.firstSmallLevel = 0;
+    texture.residentBytes = 0;
+    texture.screenSize = 0.f;
+    texture.lastUsedFrame = 0;
+    texture.isLoading = false;
+    if (!levels.empty()) {
+        unsigned int largest = max(texture.width, texture.height);
+        while ((largest >> texture.smallestLevel) > 1)
+            texture.smallestLevel++;
+        texture.firstSmallLevel = texture.smallestLevel + 1 - levels.size();
+        GLenum target = texture.isArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        glBindTexture(target, texture.id);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        upload(texture, texture.firstSmallLevel, levels);
+    }
+    textureById[texture.id] = textures.size();
+    textures.push_back(std::move(texture));
+    return textures.back().id;
+}
+
+void TextureStreamer::applyResult(LoadResult &result)
+{
+    StreamedTexture &texture = textures[result.texture];
+    texture.isLoading = false;
+    // the result covers firstLevel down to the resident level, nothing else changes a texture while it loads
+    if (result.levels.size() != texture.residentLevel - result.firstLevel + 1) {
+        // the file is gone or changed, keep what is resident and stop streaming this texture
+        LOG(LOG_ERROR) << "ERROR::TEXTURE_STREAMER::UPDATE:: Couldn't load finer mips of " << texture.paths[0];
+        texture.firstSmallLevel = texture.residentLevel;
+        return;
+    }
+    // the camera may have moved away while it loaded
+    unsigned int dropped = 0;
+    while (result.firstLevel + dropped < min(wantedLevel(texture), texture.residentLevel))
+        dropped++;
+    size_t added = 0;
+    for (unsigned int i = dropped; i + 1 < result.levels.size(); i++)
+        added += levelBytes(texture, result.levels[i].width, result.levels[i].height);
+    while (residentBytes + added > budgetBytes && evictOne(result.texture)) {
+    }
+    // whatever still doesn't fit is not uploaded
+    for (; residentBytes + added > budgetBytes && dropped + 1 < result.levels.size(); dropped++)
+        added -= levelBytes(texture, result.levels[dropped].width, result.levels[dropped].height);
+    if (dropped + 1 >= result.levels.size())
+        return;
+    vector<MipLevel> levels;
+    for (unsigned int i = dropped; i < result.levels.size(); i++)
+        levels.push_back(std::move(result.levels[i]));
+    for (unsigned int i = 0; i < texture.coarserLevels.size(); i++)
+        levels.push_back(std::move(texture.coarserLevels[i]));
+    upload(texture, result.firstLevel + dropped, levels);
+}
+
+bool TextureStreamer::evictOne(unsigned int keep)
+{
+    unsigned int victim = NO_TEXTURE;
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        const StreamedTexture &texture = textures[i];
+        if (i == keep || texture.isLoading || texture.residentLevel >= wantedLevel(texture))
+            continue;
+        if (victim == NO_TEXTURE || texture.lastUsedFrame < textures[victim].lastUsedFrame ||
+            (texture.lastUsedFrame == textures[victim].lastUsedFrame && texture.residentBytes > textures[victim].residentBytes))
+            victim = i;
+    }
+    if (victim == NO_TEXTURE)
+        return false;
+    StreamedTexture &texture = textures[victim];
+    vector<MipLevel> levels;
+    levels.swap(texture.coarserLevels);
+    upload(texture, texture.residentLevel + 1, levels);
+    return true;
+}
+
+unsigned int TextureStreamer::wantedLevel(const StreamedTexture &texture) const
+{
+    if (texture.lastUsedFrame != frame || texture.screenSize <= 0.f)
+        return texture.firstSmallLevel;
+    // a texel per pixel: every halving of the on-screen size is one mip coarser
+    float ratio = max(texture.width, texture.height) / texture.screenSize;
+    unsigned int level = ratio <= 1.f ? 0 : (unsigned int)std::floor(std::log2(ratio));
+    return min(level, texture.firstSmallLevel);
+}
+
+size_t TextureStreamer::levelBytes(const StreamedTexture &texture, unsigned int width, unsigned int height) const
+{
+    // drivers usually pad RGB texels to 4 bytes
+    size_t texelBytes = texture.components == 3 ? 4 : texture.components;
+    return texelBytes * width * height * texture.paths.size();
+}
+
+size_t TextureStreamer::chainBytes(const StreamedTexture &texture, unsigned int firstLevel) const
+{
+    size_t bytes = 0;
+    for (unsigned int level = firstLevel; level <= texture.smallestLevel; level++)
+        bytes += levelBytes(texture, max(texture.width >> level, 1u), max(texture.height >> level, 1u));
+    return bytes;
+}
+
+bool TextureStreamer::decode(const LoadRequest &request, unsigned int &width, unsigned int &height, unsigned int &components, vector<MipLevel> &levels)
+{
+    for (unsigned int i = 0; i < request.paths.size(); i++)
+    {
+        int imageWidth, imageHeight, imageComponents;
+        unsigned char *data = SOIL_load_image(request.paths[i].c_str(), &imageWidth, &imageHeight, &imageComponents,
+                                              request.isArray ? SOIL_LOAD_RGBA : SOIL_LOAD_AUTO);
+        if (!data) {
+            LOG(LOG_ERROR) << "ERROR::TEXTURE_STREAMER::LOAD:: Texture failed to load at path: " << request.paths[i];
+            return false;
+        }
+        components = request.isArray ? 4 : imageComponents;
+        MipLevel image;
+        image.width = imageWidth;
+        image.height = imageHeight;
+        image.texels.assign(data, data + image.width * image.height * components);
+        SOIL_free_image_data(data);
+        if (request.isArray && (image.width != request.width || image.height != request.height)) {
+            vector<unsigned char> scaled;
+            resizeImage(image.texels, image.width, image.height, components, request.width, request.height, scaled);
+            image.width = request.width;
+            image.height = request.height;
+            image.texels.swap(scaled);
+        }
+        width = image.width;
+        height = image.height;
+        appendMips(image, components, request.firstLevel, request.lastLevel, request.maxSize, levels);
+    }
+    return true;
+}
+
+void TextureStreamer::appendMips(MipLevel image, unsigned int components, unsigned int firstLevel, unsigned int lastLevel,
+                                 unsigned int maxSize, vector<MipLevel> &levels)
+{
+    unsigned int kept = 0;
+    for (unsigned int level = 0; level <= lastLevel; level++)
+    {
+        if (level >= firstLevel && max(image.width, image.height) <= maxSize) {
+            if (kept == levels.size()) {
+                levels.push_back(MipLevel());
+                levels[kept].width = image.width;
+                levels[kept].height = image.height;
+            }
+            levels[kept].texels.insert(levels[kept].texels.end(), image.texels.begin(), image.texels.end());
+            kept++;
+        }
+        if (image.width == 1 && image.height == 1)
+            break;
+        MipLevel next;
+        downsample(image, components, next);
+        image.width = next.width;
+        image.height = next.height;
+        image.texels.swap(next.texels);
+    }
+}
+
+void TextureStreamer::downsample(const MipLevel &source, unsigned int components, MipLevel &target)
+{
+    target.width = max(source.width / 2, 1u);
+    target.height = max(source.height / 2, 1u);
+    target.texels.resize(target.width * target.height * components);
+    for (unsigned int y = 0; y < target.height; y++)
+    {
+        unsigned int y0 = min(y * 2, source.height - 1), y1 = min(y * 2 + 1, source.height - 1);
+        for (unsigned int x = 0; x < target.width; x++)
+        {
+            unsigned int x0 = min(x * 2, source.width - 1), x1 = min(x * 2 + 1, source.width - 1);
+            for (unsigned int c = 0; c < components; c++)
+            {
+                unsigned int sum = source.texels[(y0 * source.width + x0) * components + c] + source.texels[(y0 * source.width + x1) * components + c] +
+                                   source.texels[(y1 * source.width + x0) * components + c] + source.texels[(y1 * source.width + x1) * components + c];
+                target.texels[(y * target.width + x) * components + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
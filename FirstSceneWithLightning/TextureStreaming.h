@@ -0,0 +1,128 @@
+#pragma once
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// bilinear scaling of an 8-bit image with interleaved components
+void resizeImage(const vector<unsigned char> &source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned int components,
+                 unsigned int width, unsigned int height, vector<unsigned char> &target);
+
+// Keeps 2D textures and 2D texture arrays within a memory budget by holding only the mip levels they need on screen.
+// A texture starts with its small mips (residentSize texels and below), the renderer reports every frame
+// how many pixels each texture covers and finer mips are decoded and downsampled on a loader thread, then
+// uploaded a few megabytes per frame. When an upload doesn't fit the budget, the textures that were
+// used longest ago lose their finest mip one at a time.
+// GL 3.3 has no partial residency, so a texture's finest resident mip is always its level 0: changing the
+// resident set re-specifies the whole chain under the same texture id, meshes keep using the id they have.
+class TextureStreamer
+{
+public:
+    TextureStreamer(size_t budgetBytes, unsigned int residentSize = 64);
+    ~TextureStreamer();
+
+    // creates the texture with its small mips, the same path gives the same texture.
+    // Like TextureFromFile a texture that couldn't be loaded is still a valid (empty) id
+    unsigned int Load(const string &path);
+    // a GL_TEXTURE_2D_ARRAY with a layer per path, the layers are already decoded to RGBA at full size;
+    // files of another size are scaled to width x height when finer mips are decoded again
+    unsigned int AddArray(const vector<string> &paths, const vector<vector<unsigned char> > &layers, unsigned int width, unsigned int height);
+    // the texture covers about screenSize pixels across this frame, textures not requested are the first to go
+    void Request(unsigned int texture, float screenSize);
+    // once per frame after the requests: uploads finished loads (up to uploadBytes), evicts and starts new loads
+    void Update(size_t uploadBytes);
+    // deletes every texture, needs the GL context
+    void Clear();
+
+    void SetBudget(size_t budgetBytes);
+    size_t GetBudget() const;
+    size_t GetResidentBytes() const;
+    // textures that have finer mips on the way
+    unsigned int GetLoadingCount() const;
+    unsigned int GetTextureCount() const;
+
+private:
+    // all layers of the mip one after another
+    struct MipLevel {
+        unsigned int width, height;
+        vector<unsigned char> texels;
+    };
+    struct StreamedTexture {
+        vector<string> paths;         // one per layer
+        bool isArray;
+        unsigned int id;
+        GLenum format;
+        unsigned int components;
+        unsigned int width, height;   // of the full image
+        unsigned int smallestLevel;   // 1x1
+        unsigned int residentLevel;   // finest mip in memory, GL level 0 of the texture
+        unsigned int firstSmallLevel; // coarsest mip the texture can be evicted to
+        vector<MipLevel> coarserLevels; // residentLevel + 1 and down, kept to evict without decoding the file again
+        size_t residentBytes;
+        float screenSize;             // largest request this frame
+        unsigned long long lastUsedFrame;
+        bool isLoading;
+    };
+    // mips firstLevel..lastLevel of a texture, decoded from the file on the loader thread
+    struct LoadRequest {
+        unsigned int texture;
+        vector<string> paths;
+        bool isArray;
+        unsigned int width, height;   // of array layers
+        unsigned int firstLevel, lastLevel;
+        unsigned int maxSize;
+    };
+    struct LoadResult {
+        unsigned int texture;
+        unsigned int firstLevel;
+        vector<MipLevel> levels;
+    };
+
+    size_t budgetBytes;
+    size_t residentBytes;
+    unsigned int residentSize;
+    unsigned long long frame;
+    vector<StreamedTexture> textures;
+    map<string, unsigned int> textureByPath;
+    map<unsigned int, unsigned int> textureById;
+    // results that didn't fit this frame's upload budget
+    vector<LoadResult> waitingUploads;
+
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable requestAvailable;
+    deque<LoadRequest> requests;
+    vector<LoadResult> results;
+    bool isStopping;
+
+    void loaderLoop();
+    // makes levels the texture's whole chain, the first of them is mip firstLevel of the image
+    void upload(StreamedTexture &texture, unsigned int firstLevel, vector<MipLevel> &levels);
+    // registers the texture with its first mips, returns the GL id
+    unsigned int addTexture(StreamedTexture &texture, vector<MipLevel> &levels);
+    void applyResult(LoadResult &result);
+    // drops the finest mip of the texture that was used longest ago and has more detail than it needs, not touching keep
+    bool evictOne(unsigned int keep);
+    unsigned int wantedLevel(const StreamedTexture &texture) const;
+    size_t levelBytes(const StreamedTexture &texture, unsigned int width, unsigned int height) const;
+    // memory of the chain from firstLevel down to 1x1
+    size_t chainBytes(const StreamedTexture &texture, unsigned int firstLevel) const;
+
+    // mips of the request's files, array layers are RGBA and scaled to the request's size
+    static bool decode(const LoadRequest &request, unsigned int &width, unsigned int &height, unsigned int &components, vector<MipLevel> &levels);
+    // mips of the image from firstLevel to lastLevel that are at most maxSize texels on a side, after those of the previous layers
+    static void appendMips(MipLevel image, unsigned int components, unsigned int firstLevel, unsigned int lastLevel,
+                           unsigned int maxSize, vector<MipLevel> &levels);
+    // 2x2 box filter, an odd last row or column is averaged with itself
+    static void downsample(const MipLevel &source, unsigned int components, MipLevel &target);
+};
+#endif
@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+    : generation(0), isStopping(false), job(nullptr), count(0), chunkSize(1), nextChunk(0), chunksLeft(0), busyWorkers(0)
+{
+    if (workerCount == 0) {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    workAvailable.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::ParallelFor(unsigned int count, unsigned int chunkSize, const function<void(unsigned int, unsigned int)> &job)
+{
+    if (count == 0)
+        return;
+    if (chunkSize == 0)
+        chunkSize = 1;
+    unsigned int chunks = (count + chunkSize - 1) / chunkSize;
+    if (workers.empty() || chunks == 1) {
+        job(0, count);
+        return;
+    }
+    std::lock_guard<std::mutex> callLock(callMutex);
+    {
+        // a worker that woke up too late for the previous loop may still be on its way out of runChunks()
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this] { return busyWorkers == 0; });
+        this->job = &job;
+        this->count = count;
+        this->chunkSize = chunkSize;
+        nextChunk = 0;
+        chunksLeft = chunks;
+        generation++;
+    }
+    workAvailable.notify_all();
+    runChunks();
+    // job is a reference to the caller's function, no worker may still be inside it when we return
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this] { return chunksLeft == 0 && busyWorkers == 0; });
+    this->job = nullptr;
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned long long seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this, seenGeneration] { return isStopping || generation != seenGeneration; });
+            if (isStopping)
+                return;
+            seenGeneration = generation;
+            busyWorkers++;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        workDone.notify_all();
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    while (true)
+    {
+        unsigned int chunk = nextChunk.fetch_add(1);
+        unsigned int begin = chunk * chunkSize;
+        if (begin >= count)
+            return;
+        unsigned int end = begin + chunkSize < count ? begin + chunkSize : count;
+        (*job)(begin, end);
+        chunksLeft.fetch_sub(1);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Fixed set of worker threads for data-parallel loops on the render thread's behalf.
+// The calling thread works on the loop too, so a pool with 0 workers simply runs the loop in place.
+class ThreadPool
+{
+public:
+    // workerCount 0 means one worker per hardware thread, minus the caller's
+    explicit ThreadPool(unsigned int workerCount = 0);
+    ~ThreadPool();
+
+    // runs job(begin, end) over [0, count) in chunks of at most chunkSize and returns when every chunk is done.
+    // Calls from different threads are serialized.
+    void ParallelFor(unsigned int count, unsigned int chunkSize, const function<void(unsigned int, unsigned int)> &job);
+
+    // workers plus the calling thread
+    unsigned int GetThreadCount() const;
+
+private:
+    vector<std::thread> workers;
+    std::mutex callMutex; // one ParallelFor at a time
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    unsigned long long generation; // bumped for every ParallelFor so workers don't pick up a finished job twice
+    bool isStopping;
+
+    const function<void(unsigned int, unsigned int)> *job;
+    unsigned int count;
+    unsigned int chunkSize;
+    std::atomic<unsigned int> nextChunk;
+    std::atomic<unsigned int> chunksLeft;
+    unsigned int busyWorkers;
+
+    void workerLoop();
+    void runChunks();
+};
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free handoff of the newest value from one writer thread to one reader thread.
+// The writer always has a buffer to fill and the reader always has a complete one to look at,
+// the third buffer sits in the middle and is swapped with either side by a single atomic exchange.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : writeIndex(0), middle(1), readIndex(2) {}
+
+    // writer side: the buffer to fill before calling Publish()
+    T &WriteBuffer()
+    {
+        return buffers[writeIndex];
+    }
+
+    // writer side: makes the filled buffer the newest one
+    void Publish()
+    {
+        unsigned int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // reader side: picks up the newest published buffer if there is one, returns true if it changed
+    bool Update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT))
+            return false;
+        unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    // reader side: the buffer picked up by the last Update()
+    const T &ReadBuffer() const
+    {
+        return buffers[readIndex];
+    }
+
+private:
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int FRESH_BIT = 4;
+
+    T buffers[3];
+    unsigned int writeIndex;           // owned by the writer
+    std::atomic<unsigned int> middle;  // shared, index plus FRESH_BIT if the writer published since the last Update()
+    unsigned int readIndex;            // owned by the reader
+};
+#endif
@@ -2,39 +2,66 @@
 #include "Camera.h"
 #include "Model.h"
 #include "MeshGenerators.h"
+#include "PostProcessing.h"
+#include "DynamicResolution.h"
+#include "Simulation.h"
+#include "SceneGraph.h"
+#include "SceneLoader.h"
+#include "TexturePacking.h"
+#include "ClusteredLighting.h"
+#include "ShadowMapping.h"
+#include "ThreadPool.h"
+#include "PassStatistics.h"
+#include "OcclusionCulling.h"
+#include "SoftwareRenderer.h"
+#include "TextureStreaming.h"
+#include "RenderGraph.h"
+#include "MultiView.h"
+#include "FrameCapture.h"
+#include "Log.h"
+#include "GpuResources.h"
+#include "GlStats.h"
+#include "StatsOverlay.h"
+#include "Bvh.h"
 #include "cube_vertices.h"
 
 #include "GLFW/glfw3.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 // GLEW VERSION IS 4.0
 
-bool pressedKeys[1024];
-GLfloat lastTimePressed[1024] = {0};
-GLfloat frameDeltaTime = 0.0f;
-GLfloat lastFrameTime = 0.0; 
-const GLfloat KEY_PRESS_THRESHOLD = 0.2;
-
-bool isFlashlightOn = false;
-bool isFigureReflecting = true;
-bool isParallaxSelfShadowing = false;
-bool isPostEffectOn = false;
-bool isGammaCorrectionOn = false;
-double mousePrevX, mousePrevY;
-Camera mainCamera(glm::vec3(0.0f, 0.0f, 3.0f));
 const unsigned int screenWidth = 1280;
 const unsigned int screenHeight = 720;
-int DebugLevel = 0;
+unsigned int framebufferWidth = screenWidth;
+unsigned int framebufferHeight = screenHeight;
+bool isFramebufferResized = false;
+// input, camera and animation run on the simulation thread, the main thread renders its snapshots
+Simulation *simulation = nullptr;
+// the post effect setups run on the render thread and read the blur radius of the snapshot being drawn
+int blurRadius = 8;
+// video memory for material textures, finer mips of the textures seen longest ago are dropped to stay within it
+const size_t textureBudgetBytes = 256u << 20;
+const size_t textureUploadBytesPerFrame = 8u << 20;
+// estimated video memory of everything the app creates, going over it is logged as a warning
+const size_t gpuBudgetBytes = 768u << 20;
+// frame time dynamic resolution aims for, also marked on the stats overlay graph
+const double frameBudgetMs = 1000.0 / 60.0;
+// relief mapping depth of the parallax material; the depth pre-pass and the lit pass have to use the same one,
+// the lit pass only shades fragments whose depth equals the pre-pass depth
+const float parallaxHeightScale = 0.1f;
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
-    if (action == GLFW_PRESS) {
-        pressedKeys[key] = true;
-    } else if (action == GLFW_RELEASE) {
-        pressedKeys[key] = false;
-    }
+    InputEvent event;
+    event.type = KEY_EVENT;
+    event.key = key;
+    event.action = action;
+    simulation->PushInput(event);
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
@@ -42,117 +69,191 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
-    float xoffset = xpos - mousePrevX;
-    float yoffset = mousePrevY - ypos; // reversed since y-coordinates go from bottom to top
-    mainCamera.ProcessMouseMovement(xoffset, yoffset);
-    mousePrevX = xpos;
-    mousePrevY = ypos;
-    if (DebugLevel > 1) {
-        std::cout << "Camera direction:" << std::endl <<
-        mainCamera.Front.x << " " << mainCamera.Front.y << " " << mainCamera.Front.z << std::endl;
-    }
+    InputEvent event;
+    event.type = CURSOR_EVENT;
+    event.x = xpos;
+    event.y = ypos;
+    simulation->PushInput(event);
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    isFramebufferResized = true;
 }
 
-void processCameraMovement(Camera &camera) {
-    if (pressedKeys[GLFW_KEY_SPACE]) {
-        camera.ProcessKeyboard(UP, frameDeltaTime);
-    }
-    if (pressedKeys[GLFW_KEY_X]) {
-        camera.ProcessKeyboard(DOWN, frameDeltaTime);
-    }
-    if (pressedKeys[GLFW_KEY_W]) {
-        camera.ProcessKeyboard(FORWARD, frameDeltaTime);
-    }
-    if (pressedKeys[GLFW_KEY_A]) {
-        camera.ProcessKeyboard(LEFT, frameDeltaTime);
-    }
-    if (pressedKeys[GLFW_KEY_S]) {
-        camera.ProcessKeyboard(BACKWARD, frameDeltaTime);
-    }
-    if (pressedKeys[GLFW_KEY_D]) {
-        camera.ProcessKeyboard(RIGHT, frameDeltaTime);
+// lights of the scene file, spot angles turned into the cosines the shaders compare with
+vector<Light> createSceneLights(const SceneDescription &sceneDescription)
+{
+    vector<Light> sceneLights;
+    for (unsigned int i = 0; i < sceneDescription.lights.size(); i++)
+    {
+        const SceneLight &sceneLight = sceneDescription.lights[i];
+        Light light;
+        light.position = sceneLight.position;
+        light.radius = sceneLight.radius;
+        light.color = sceneLight.color;
+        light.direction = glm::normalize(sceneLight.spotDirection);
+        if (sceneLight.spotOuterAngle > 0.f) {
+            light.spotCosOuter = glm::cos(glm::radians(sceneLight.spotOuterAngle));
+            light.spotCosInner = glm::cos(glm::radians(sceneLight.spotInnerAngle));
+        }
+        sceneLights.push_back(light);
     }
+    return sceneLights;
 }
 
-void processActionKeys() {
-    if (pressedKeys[GLFW_KEY_F]) {
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_F] > KEY_PRESS_THRESHOLD) {
-            isFlashlightOn ^= 1;
-            lastTimePressed[GLFW_KEY_F] = lastFrameTime;
-        }
-    }
-    if (0 && pressedKeys[GLFW_KEY_I]) { //Turned off this for now, doesn't seem to have effect
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_I] > KEY_PRESS_THRESHOLD) {
-            isGammaCorrectionOn ? glDisable(GL_FRAMEBUFFER_SRGB) : glEnable(GL_FRAMEBUFFER_SRGB);
-            isGammaCorrectionOn ^= 1;
-            if (DebugLevel > 0) {
-                std::cout <<
-                    (isGammaCorrectionOn ? "Enabled GL_FRAMEBUFFER_SRGB" : "Disabled GL_FRAMEBUFFER_SRGB")
-                    << std::endl;
-            }
-            lastTimePressed[GLFW_KEY_I] = lastFrameTime;
-        }
-    }
-    if (pressedKeys[GLFW_KEY_P]) {
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_P] > KEY_PRESS_THRESHOLD) {
-            isFigureReflecting ^= 1;
-            lastTimePressed[GLFW_KEY_P] = lastFrameTime;
-            if (DebugLevel > 0) {
-                std::cout <<
-                    (isFigureReflecting ? "Bench is reflecting skybox" : "Bench is look-through")
-                    << std::endl;
-            }
-        }
-    }
-    if (pressedKeys[GLFW_KEY_O]) {
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_O] > KEY_PRESS_THRESHOLD) {
-            isParallaxSelfShadowing ^= 1;
-            lastTimePressed[GLFW_KEY_O] = lastFrameTime;
-            if (DebugLevel > 0) {
-                std::cout << 
-                    (isParallaxSelfShadowing ? "Enabled Parallax Self-Shadowing" : "Disabled Parallax Self-Shadowing")
-                    << std::endl;
+// draws the scene once from its camera with the software renderer and writes the picture, no window and no GL needed
+int renderHeadless(const string &outputPath, unsigned int width, unsigned int height, int blurRadius)
+{
+    typedef std::chrono::steady_clock clock;
+    SceneDescription sceneDescription;
+    if (!LoadScene("Scenes/first.scene", sceneDescription))
+        return -1;
+    SceneGraph sceneGraph;
+    ThreadPool workerPool;
+    SceneLoader sceneLoader(sceneDescription, sceneGraph, true);
+    sceneLoader.SetThreadPool(&workerPool);
+    sceneLoader.ResolveAll();
+    vector<Light> lights = createSceneLights(sceneDescription);
+    if (!lights.empty())
+        sceneLoader.SetLightPosition(lights[0].position);
+    sceneGraph.UpdateWorldTransforms();
+
+    SoftwareRenderer renderer(workerPool, width, height);
+    SoftwareCubemap skybox;
+    skybox.Load(sceneDescription.skyboxFaces, sceneDescription.skyboxDirectory);
+    renderer.SetSkybox(&skybox);
+    renderer.SetLights(lights);
+
+    Camera camera(sceneDescription.cameraPosition);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)width / height, 0.1f, 100.0f);
+    clock::time_point start = clock::now();
+    renderer.BeginFrame(camera.GetViewMatrix(), projection, camera.Position);
+    sceneLoader.DrawSoftware(renderer, true);
+    renderer.EndFrame();
+    renderer.Blur(blurRadius);
+    double frameMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    std::cout << "Software frame " << width << "x" << height << ": " << renderer.GetTriangleCount() << " triangles, "
+        << frameMs << " ms on " << workerPool.GetThreadCount() << " threads" << std::endl;
+    return renderer.SaveImage(outputPath) ? 0 : -1;
+}
+
+// builds a BVH over the model and traces a grid of primary rays at it from the front, prints Mrays/s of every query kind
+int runBvhBenchmark(const string &modelPath)
+{
+    typedef std::chrono::steady_clock clock;
+    ThreadPool workerPool;
+    Model model(modelPath, false, true, nullptr, false, &workerPool);
+    if (model.meshes.empty())
+        return -1;
+    Bvh bvh;
+    clock::time_point start = clock::now();
+    bvh.Build(model, workerPool);
+    double buildMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    std::cout << "BVH: " << bvh.GetTriangleCount() << " triangles, " << bvh.GetNodeCount() << " nodes, built in "
+        << buildMs << " ms on " << workerPool.GetThreadCount() << " threads" << std::endl;
+    if (bvh.GetTriangleCount() == 0)
+        return -1;
+
+    // pinhole camera in front of the model looking at its center, rays of 2x2 pixel blocks go next to each other
+    const unsigned int resolution = 1024;
+    glm::vec3 center = (bvh.GetBoundsMin() + bvh.GetBoundsMax()) * 0.5f;
+    float radius = glm::length(bvh.GetBoundsMax() - bvh.GetBoundsMin()) * 0.5f;
+    glm::vec3 eye = center + glm::normalize(glm::vec3(0.3f, 0.4f, 1.f)) * radius * 2.5f;
+    glm::vec3 forward = glm::normalize(center - eye);
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.f, 1.f, 0.f)));
+    glm::vec3 up = glm::cross(right, forward);
+    float halfSize = 0.45f;
+    vector<Ray> rays;
+    rays.reserve(resolution * resolution);
+    for (unsigned int blockY = 0; blockY < resolution; blockY += 2)
+        for (unsigned int blockX = 0; blockX < resolution; blockX += 2)
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                float x = ((blockX + i % 2 + 0.5f) / resolution * 2.f - 1.f) * halfSize;
+                float y = ((blockY + i / 2 + 0.5f) / resolution * 2.f - 1.f) * halfSize;
+                rays.push_back(Ray(eye, glm::normalize(forward + right * x + up * y)));
             }
-        }
+
+    vector<RayHit> hits(rays.size());
+    vector<unsigned char> occluded;
+    unsigned int hitCount = 0;
+    auto report = [&](const char *name, clock::time_point begin) {
+        double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+        std::cout << "  " << name << ": " << rays.size() / seconds / 1e6 << " Mrays/s" << std::endl;
+    };
+    start = clock::now();
+    for (unsigned int i = 0; i < rays.size(); i++)
+        hits[i] = bvh.Intersect(rays[i]);
+    report("closest hit, single rays, 1 thread", start);
+    for (unsigned int i = 0; i < hits.size(); i++)
+        hitCount += hits[i].IsHit();
+    start = clock::now();
+    for (unsigned int i = 0; i < rays.size(); i += 4)
+        bvh.IntersectPacket(&rays[i], &hits[i]);
+    report("closest hit, packets of 4, 1 thread", start);
+    start = clock::now();
+    bvh.IntersectBatch(rays, hits, workerPool);
+    report("closest hit, batch on all threads", start);
+    start = clock::now();
+    bvh.IsOccludedBatch(rays, occluded, workerPool);
+    report("any hit, batch on all threads", start);
+    std::cout << "  " << hitCount << " of " << rays.size() << " rays hit the model" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    // FirstSceneWithLightning --bvh-benchmark [model path]
+    if (argc >= 2 && string(argv[1]) == "--bvh-benchmark")
+        return runBvhBenchmark(argc >= 3 ? argv[2] : "Objects/Bench/bench.obj");
+    // FirstSceneWithLightning --pack-textures <packed.tga> <normal map|-> <height map|-> <specular map|->
+    if (argc >= 6 && string(argv[1]) == "--pack-textures")
+    {
+        string paths[3];
+        for (unsigned int i = 0; i < 3; i++)
+            paths[i] = string(argv[3 + i]) == "-" ? string() : string(argv[3 + i]);
+        return PackTextureChannels(paths[0], paths[1], paths[2], argv[2]) ? 0 : -1;
     }
-    if (pressedKeys[GLFW_KEY_E]) {
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_E] > KEY_PRESS_THRESHOLD) {
-            isPostEffectOn ^= 1;
-            lastTimePressed[GLFW_KEY_E] = lastFrameTime;
-            if (DebugLevel > 0) {
-                std::cout <<
-                    (isPostEffectOn ? "Enabled PostEffect" : "Disabled PostEffect")
-                    << std::endl;
-            }
+    // FirstSceneWithLightning --software <picture.tga> [width height [blur radius]]
+    if (argc >= 3 && string(argv[1]) == "--software")
+    {
+        unsigned int width = argc >= 5 ? std::atoi(argv[3]) : screenWidth;
+        unsigned int height = argc >= 5 ? std::atoi(argv[4]) : screenHeight;
+        int blur = argc >= 6 ? std::atoi(argv[5]) : 0;
+        if (width == 0 || height == 0)
+        {
+            std::cout << "ERROR::SOFTWARE_RENDERER:: Wrong picture size" << std::endl;
+            return -1;
         }
+        return renderHeadless(argv[2], width, height, blur);
     }
-    if (pressedKeys[GLFW_KEY_G]) {
-        if (lastFrameTime - lastTimePressed[GLFW_KEY_G] > KEY_PRESS_THRESHOLD) {
-            DebugLevel = DebugLevel ? 0 : 1;
-            lastTimePressed[GLFW_KEY_G] = lastFrameTime;
-            std::cout <<
-                (DebugLevel ? "Event log is on!" : "Event log is off!")
-                << std::endl;
-        }
+    // FirstSceneWithLightning [--capture <frame_%05d.tga|session.raw|"|command">] [--log <file>]
+    // --capture records every frame (see FrameCapture.h), --log writes the log to a file instead of the console
+    string captureOutput, logPath;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (string(argv[i]) == "--capture")
+            captureOutput = argv[i + 1];
+        else if (string(argv[i]) == "--log")
+            logPath = argv[i + 1];
     }
-}
+    // from here on lines are written by the log thread, the frame never waits on the console
+    Logger::Get().Start(logPath);
+    GpuResourceRegistry::Get().SetBudget(gpuBudgetBytes);
 
-int main()
-{
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
     GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Computer Graphics, Chukharev 301", nullptr, nullptr);
     if (window == nullptr)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        LOG(LOG_ERROR) << "Failed to create GLFW window";
         glfwTerminate();
         return -1;
     }
@@ -160,15 +261,30 @@ int main()
     glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK)
     {
-        std::cout << "Failed to initialize GLEW" << std::endl;
+        LOG(LOG_ERROR) << "Failed to initialize GLEW";
         return -1;
     }
     
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // framebuffer can be larger than the window on high-DPI screens
+    int initialWidth, initialHeight;
+    glfwGetFramebufferSize(window, &initialWidth, &initialHeight);
+    framebufferWidth = initialWidth;
+    framebufferHeight = initialHeight;
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    SceneDescription sceneDescription;
+    if (!LoadScene("Scenes/first.scene", sceneDescription))
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glm::vec3 lightOrigin = sceneDescription.lights.empty() ? glm::vec3(0.f) : sceneDescription.lights[0].position;
+    double cursorX, cursorY;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    Simulation sceneSimulation(Camera(sceneDescription.cameraPosition), lightOrigin, cursorX, cursorY);
+    simulation = &sceneSimulation;
     glfwSetKeyCallback(window, key_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwGetCursorPos(window, &mousePrevX, &mousePrevY);
 
     glEnable(GL_DEPTH_TEST);
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -182,16 +298,11 @@ int main()
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    GpuResourceRegistry::Get().Add(GPU_VERTEX_ARRAY, skyboxVAO, 0, "skybox");
+    GpuResourceRegistry::Get().Add(GPU_BUFFER, skyboxVBO, sizeof(skyboxVertices), "skybox");
 
-    vector<std::string> faces{
-        "posx.tga",
-        "negx.tga",
-        "posy.png",
-        "negy.png",
-        "posz.tga",
-        "negz.tga"
-    };
-    unsigned int cubemapTexture = loadCubemap(faces, "Textures/Skybox");
+    // the skybox is behind everything, it is loaded right away unlike the rest of the scene
+    unsigned int cubemapTexture = loadCubemap(sceneDescription.skyboxFaces, sceneDescription.skyboxDirectory);
     //////////////////////////////////Regular stuff creation
     Shader skyboxShader("Shaders/Skybox/skybox.vert", "Shaders/Skybox/skybox.frag");
     Shader parallaxShader("Shaders/ParallaxMapping/pm_quad.vert", "Shaders/ParallaxMapping/pm_quad.frag");
@@ -199,40 +310,18 @@ int main()
     Shader modelShader("Shaders/SkyboxReflection/shader.vert", "Shaders/SkyboxReflection/shader.frag");
     Shader cubeLampShader("Shaders/simpleShader.vert", "Shaders/light_cube.frag");
     Shader screenShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/screenShader.frag");
-    Model ourModel("Objects/Bench/bench.obj");
-    vector<Texture> textures;
-    Texture texture;
-    texture.type = "texture_diffuse";
-    texture.path = "Textures/Bricks/bricks.jpg";
-    texture.id = TextureFromFile("bricks.jpg", "Textures/Bricks");
-    textures.push_back(texture);
-    texture.type = "texture_normal";
-    texture.path = "Textures/Bricks/bricks_NORMAL.jpg";
-    texture.id = TextureFromFile("bricks_NORMAL.jpg", "Textures/Bricks");
-    textures.push_back(texture);
-    texture.type = "texture_height";
-    texture.path = "Textures/Bricks/bricks_DISP.jpg";
-    texture.id = TextureFromFile("bricks_DISP.jpg", "Textures/Bricks");
-    textures.push_back(texture);
-    Mesh parallaxBrickWall = createQuadMesh(textures);
-    textures.clear();
-
-    texture.type = "texture_diffuse";
-    texture.path = "Textures/Blackwood/blackwood.jpg";
-    texture.id = TextureFromFile("blackwood.jpg", "Textures/Blackwood");
-    textures.push_back(texture);
-    texture.type = "texture_normal";
-    texture.path = "Textures/Blackwood/blackwood_NORMAL.jpg";
-    texture.id = TextureFromFile("blackwood_NORMAL.jpg", "Textures/Blackwood");
-    textures.push_back(texture);
-    texture.type = "texture_specular";
-    texture.path = "Textures/Blackwood/blackwood_SPECULAR.jpg";
-    texture.id = TextureFromFile("blackwood_SPECULAR.jpg", "Textures/Blackwood");
-    textures.push_back(texture);
-    Mesh normalWoodenFloor = createQuadMesh(textures);
-    Mesh normalWoodenBenchPost = createQuadMesh(textures);
-    textures.clear();
-    Mesh flyingCubeLamp = createCubeMesh(textures);
+    Shader gammaShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/gamma.frag");
+    Shader blurShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/blur.frag");
+    Shader sharpenShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/sharpen.frag");
+    Shader vignetteShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/vignette.frag");
+    Shader upscaleShader("Shaders/PostEffect/screenShader.vert", "Shaders/PostEffect/upscale.frag");
+    Shader shadowDepthShader("Shaders/Shadow/point_shadow.vert", "Shaders/Shadow/point_shadow.frag", "Shaders/Shadow/point_shadow.geom");
+    Shader depthPrepassShader("Shaders/DepthPrepass/depth.vert", "Shaders/DepthPrepass/depth.frag");
+    // the relief walls discard fragments whose parallax offset leaves the texture, their pre-pass has to discard exactly
+    // the same ones or the GL_EQUAL lit pass leaves holes
+    Shader parallaxDepthShader("Shaders/ParallaxMapping/pm_quad.vert", "Shaders/ParallaxMapping/pm_quad_depth.frag");
+    // stereo and overview views in one pass, the geometry shader sends every triangle to each view's layer
+    Shader multiViewShader("Shaders/MultiView/multiview.vert", "Shaders/MultiView/multiview.frag", "Shaders/MultiView/multiview.geom");
     
     //////////////////////////////////Creating PostEffect Framebuffer
     // framebuffer configuration
@@ -257,147 +346,428 @@ int main()
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    // create a color attachment texture
-    unsigned int textureColorbuffer;
-    glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, screenWidth, screenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, screenWidth, screenHeight); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GpuResourceRegistry::Get().Add(GPU_VERTEX_ARRAY, quadVAO, 0, "screen quad");
+    GpuResourceRegistry::Get().Add(GPU_BUFFER, quadVBO, sizeof(quadVertices), "screen quad");
+    RenderTargetPool renderTargets;
+    PostProcessChain postChain(renderTargets, quadVAO);
+    // frame times and GL call counts over the finished frame (T)
+    StatsOverlay statsOverlay(quadVAO);
+    // passes of every frame, transient targets come from renderTargets
+    RenderGraph frameGraph(renderTargets);
+    MultiViewTarget multiViewTarget;
+    vector<View> views;
+    FrameCapture frameCapture;
+    if (!captureOutput.empty() && frameCapture.Start(captureOutput, framebufferWidth, framebufferHeight))
+        LOG(LOG_INFO) << "Recording " << framebufferWidth << "x" << framebufferHeight << " frames to " << captureOutput;
+    postChain.AddEffect("Blur", {
+        { &blurShader, [](Shader &shader) { shader.setVec2("axis", 1.f, 0.f); setGaussianBlurUniforms(shader, blurRadius); } },
+        { &blurShader, [](Shader &shader) { shader.setVec2("axis", 0.f, 1.f); setGaussianBlurUniforms(shader, blurRadius); } }
+    });
+    postChain.AddEffect("Sharpen", { { &sharpenShader, [](Shader &shader) { shader.setFloat("amount", 0.5f); } } });
+    postChain.AddEffect("Vignette", { { &vignetteShader, [](Shader &shader) { shader.setFloat("strength", 0.6f); } } });
+    // edge blur and gamma correction are both on quite often, screenShader can do the gamma step itself then
+    postChain.AddEffect("EdgeBlur", { { &screenShader, [](Shader &shader) { shader.setFloat("gamma", 1.0f); } } });
+    postChain.AddEffect("Gamma", { { &gammaShader, [](Shader &shader) { shader.setFloat("gamma", 2.2f); } } });
+    postChain.SetUpscalePass({ &upscaleShader, nullptr });
+    postChain.AddFusion({ "EdgeBlur", "Gamma" }, { &screenShader, [](Shader &shader) { shader.setFloat("gamma", 2.2f); } });
+    // compute-shader versions of the convolutions, tile sizes have to match local_size in the shaders
+    vector<Shader *> computeShaders;
+    if (isComputeSupported())
+    {
+        Shader *blurHComputeShader = new Shader("Shaders/PostEffect/Compute/blur_h.comp");
+        Shader *blurVComputeShader = new Shader("Shaders/PostEffect/Compute/blur_v.comp");
+        Shader *sharpenComputeShader = new Shader("Shaders/PostEffect/Compute/sharpen.comp");
+        Shader *vignetteComputeShader = new Shader("Shaders/PostEffect/Compute/vignette.comp");
+        computeShaders = { blurHComputeShader, blurVComputeShader, sharpenComputeShader, vignetteComputeShader };
+        postChain.SetComputePasses("Blur", {
+            { blurHComputeShader, [](Shader &shader) { setGaussianBlurUniforms(shader, blurRadius); }, 128, 1 },
+            { blurVComputeShader, [](Shader &shader) { setGaussianBlurUniforms(shader, blurRadius); }, 1, 128 }
+        });
+        postChain.SetComputePasses("Sharpen", { { sharpenComputeShader, [](Shader &shader) { shader.setFloat("amount", 0.5f); }, 16, 16 } });
+        postChain.SetComputePasses("Vignette", { { vignetteComputeShader, [](Shader &shader) { shader.setFloat("strength", 0.6f); }, 16, 16 } });
+    }
+    else
+    {
+        LOG(LOG_WARNING) << "Compute shaders are not supported, PostEffects will use fragment shaders only";
+    }
 
     //////////////////////////////////Pre-loop configs
     skyboxShader.Use();
     skyboxShader.setInt("skybox", 0);
     modelShader.Use();
     modelShader.setInt("skybox", 0);
+    // material textures come from the arrays of the scene's MaterialTable
+    MaterialTable::SetupShader(parallaxShader);
+    MaterialTable::SetupShader(normalShader);
+    MaterialTable::SetupShader(parallaxDepthShader);
+    MaterialTable::SetupShader(multiViewShader);
+    // every shader that draws scene objects takes their model matrix from the DrawConstants block
+    Shader *sceneShaders[] = { &parallaxShader, &normalShader, &parallaxDepthShader, &modelShader, &cubeLampShader,
+                               &shadowDepthShader, &depthPrepassShader, &multiViewShader };
+    for (unsigned int i = 0; i < sizeof(sceneShaders) / sizeof(sceneShaders[0]); i++)
+        DrawConstantRing::SetupShader(*sceneShaders[i]);
+
+    // 3D scene resolution follows the GPU frame time when dynamic resolution is on
+    GpuFrameTimer frameTimer;
+    DynamicResolution dynamicResolution(frameBudgetMs);
+
+    // worker threads of the culling, the light clusters and tangent generation of loaded models
+    ThreadPool workerPool;
+    // meshes, models and textures are loaded over the first frames, nearest to the camera first
+    SceneGraph sceneGraph;
+    SceneLoader sceneLoader(sceneDescription, sceneGraph);
+    sceneLoader.SetThreadPool(&workerPool);
+    // textures come up with their small mips, finer ones stream in as objects get close
+    TextureStreamer textureStreamer(textureBudgetBytes);
+    sceneLoader.SetTextureStreamer(&textureStreamer);
 
-    // lighting info
-    glm::vec3 oldLightPos(0.5f, 1.0f, 0.3f);
-    glm::vec3 lightPos(0.5f, 1.0f, 0.3f);
+    // the first light follows the animated light position
+    vector<Light> sceneLights = createSceneLights(sceneDescription);
+    vector<Light> lights;
+    ClusteredLighting clusteredLighting(workerPool);
+    OcclusionCuller occlusionCuller(workerPool);
+    // shadows of the flying lamp, they reach as far as its light
+    PointShadowMap lampShadow(1024, sceneLights.empty() ? 30.f : sceneLights[0].radius);
+    std::function<void(Shader &)> drawStaticCasters = [&sceneLoader](Shader &shader) { sceneLoader.DrawShadowCasters(shader, false); };
+    std::function<void(Shader &)> drawDynamicCasters = [&sceneLoader](Shader &shader) { sceneLoader.DrawShadowCasters(shader, true); };
+
+    // fragments shaded by each pass, the pre-pass count is what the lit passes would shade without it
+    PassStatistics passStatistics;
+    unsigned int prepassStat = passStatistics.AddPass("depth pre-pass");
+    unsigned int parallaxStat = passStatistics.AddPass("parallax");
+    unsigned int normalStat = passStatistics.AddPass("normal mapping");
+    unsigned int reflectionStat = passStatistics.AddPass("reflection");
+    unsigned int multiViewStat = passStatistics.AddPass("multi-view");
+    double lastStatisticsReport = glfwGetTime();
+    double lastFrameTime = glfwGetTime();
+
+    unsigned int seenPostBenchmarkRequests = 0;
+    sceneSimulation.Start();
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
-        GLfloat currentFrameTime = glfwGetTime();
-        frameDeltaTime = currentFrameTime - lastFrameTime;
-        lastFrameTime = currentFrameTime;
-        
-        processCameraMovement(mainCamera);
-        processActionKeys();
+        // newest state the simulation thread has finished, it keeps stepping while we draw this one
+        SceneSnapshot scene = sceneSimulation.LatestSnapshot();
+        const SceneToggles &toggles = scene.toggles;
+        Camera &mainCamera = scene.camera;
+        const glm::vec3 &lightPos = scene.lightPos;
+        blurRadius = toggles.blurRadius;
+
+        if (framebufferWidth == 0 || framebufferHeight == 0) {
+            // minimized, nothing to draw into
+            glfwPollEvents();
+            lastFrameTime = glfwGetTime();
+            continue;
+        }
+        if (isFramebufferResized) {
+            // targets of the old size won't be asked for again
+            renderTargets.Trim();
+            isFramebufferResized = false;
+        }
+        double gpuFrameMs;
+        if (frameTimer.Poll(gpuFrameMs) && toggles.isDynamicResolutionOn) {
+            if (dynamicResolution.Update(gpuFrameMs) && toggles.debugLevel > 0) {
+                LOG(LOG_INFO) << "Render scale: " << dynamicResolution.GetScale() << " (GPU frame " << gpuFrameMs << " ms)";
+            }
+        }
+        if (!toggles.isDynamicResolutionOn) {
+            dynamicResolution.Reset();
+        }
+        unsigned int renderWidth = dynamicResolution.ScaledSize(framebufferWidth);
+        unsigned int renderHeight = dynamicResolution.ScaledSize(framebufferHeight);
 
         // render
         // ------
-        // bind to framebuffer and draw scene as we normally would to color texture 
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
-        ////
-        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 model;
-        glm::mat4 projection = glm::perspective(glm::radians(mainCamera.Zoom), (GLfloat)screenWidth / screenHeight, 0.1f, 100.0f);
+        // draw scene into an offscreen target if there are post effects to apply, straight to the screen otherwise
+        postChain.SetEnabled("Blur", toggles.isBlurOn);
+        postChain.SetEnabled("Sharpen", toggles.isSharpenOn);
+        postChain.SetEnabled("Vignette", toggles.isVignetteOn);
+        postChain.SetEnabled("EdgeBlur", toggles.isPostEffectOn);
+        postChain.SetEnabled("Gamma", toggles.isGammaCorrectionOn);
+        postChain.SetUseCompute(toggles.isComputePostEffectsOn);
+        if (toggles.postBenchmarkRequests != seenPostBenchmarkRequests) {
+            // wide kernels at high resolutions are where the two paths differ the most
+            postChain.Benchmark(1920, 1080, 20);
+            postChain.Benchmark(3840, 2160, 20);
+            seenPostBenchmarkRequests = toggles.postBenchmarkRequests;
+        }
+        if (sceneLoader.PendingCount() > 0) {
+            // a few milliseconds of loading per frame keeps the window responsive while the scene fills in
+            unsigned int pending = sceneLoader.ResolvePending(4.0);
+            if (pending == 0 && toggles.debugLevel > 0) {
+                LOG(LOG_INFO) << "Scene is loaded";
+            }
+        }
+        // only the lamp moves, so only its node gets recomputed each frame
+        sceneLoader.SetLightPosition(lightPos);
+        sceneGraph.UpdateWorldTransforms();
+
+        frameTimer.Begin();
+        glm::mat4 projection = glm::perspective(glm::radians(mainCamera.Zoom), (GLfloat)framebufferWidth / framebufferHeight, 0.1f, 100.0f);
         glm::mat4 view = mainCamera.GetViewMatrix();
 
-        lightPos = oldLightPos;
-        lightPos.x += 2 * glm::sin(lastFrameTime);
-        lightPos.y += 2.5 * glm::cos(lastFrameTime);
-
-        parallaxShader.Use();
-        parallaxShader.setMat4("projection", projection);
-        parallaxShader.setMat4("view", view);
-  
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(0.f, 0.f, -2.f));
-        model = glm::scale(model, glm::vec3(2.f));
-        parallaxShader.setMat4("model", model);
-        parallaxShader.setVec3("viewPos", mainCamera.Position);
-        parallaxShader.setVec3("lightPos", lightPos);
-        parallaxShader.setFloat("heightScale", 0.1f);
-        parallaxShader.setInt("selfShadowState", isParallaxSelfShadowing);
-        parallaxBrickWall.Draw(parallaxShader);
-
-        normalShader.Use();
-        normalShader.setMat4("projection", projection);
-        normalShader.setMat4("view", view);
-        normalShader.setVec3("viewPos", mainCamera.Position);
-        normalShader.setVec3("lightPos", lightPos);
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(0.f, -1.9f, 0.f));
-        model = glm::rotate(model, (GLfloat)glm::radians(270.), glm::vec3(1.f, 0.f, 0.f));
-        model = glm::scale(model, glm::vec3(2.f));
-        normalShader.setMat4("model", model);
-        normalWoodenFloor.Draw(normalShader);
-
-        normalShader.Use();
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(0.f, -2.f, 6.f));
-        model = glm::rotate(model, (GLfloat)glm::radians(270.), glm::vec3(1.f, 0.f, 0.f));
-        model = glm::scale(model, glm::vec3(2.f));
-        normalShader.setMat4("model", model);
-        normalWoodenBenchPost.Draw(normalShader);
-
-        modelShader.Use();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-        model = glm::mat4(1.f);
-        model = glm::translate(model, glm::vec3(0.0f, -2.f, 6.0f));
-        model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-        modelShader.setMat4("model", model);
-        modelShader.setVec3("cameraPos", mainCamera.Position);
-        modelShader.setInt("reflectState", isFigureReflecting);
-        ourModel.Draw(modelShader);
-
-        cubeLampShader.Use();
-        cubeLampShader.setMat4("projection", projection);
-        cubeLampShader.setMat4("view", view);
-        model = glm::mat4(1.f);
-        model = glm::translate(model, lightPos);
-        model = glm::scale(model, glm::vec3(0.05f));
-        parallaxShader.setMat4("model", model);
-        flyingCubeLamp.Draw(cubeLampShader);
-
-        // draw skybox as last
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.Use();
-        view = glm::mat4(glm::mat3(mainCamera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-        // clear all relevant buffers
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear color to white (not really necessery actually, since we won't be able to see behind the quad anyways)
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        screenShader.Use();
-        screenShader.setBool("isOn", isPostEffectOn);
-        glBindVertexArray(quadVAO);
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        lights = sceneLights;
+        if (!lights.empty()) {
+            lights[0].position = lightPos;
+        }
+        if (toggles.isLightSwarmOn) {
+            addDemoLights(lights, 256, scene.time);
+        }
+        clusteredLighting.Update(lights, view, projection, 0.1f, 100.0f);
+        if (toggles.isOcclusionCullingOn && !toggles.isMultiViewOn) {
+            // on the CPU, the GPU never sees the objects behind the wall and the floor.
+            // Not for multiple views, the overview camera sees what hides behind them from the main one
+            sceneLoader.CullOccluded(occlusionCuller, projection * view);
+        } else {
+            sceneLoader.ClearCulling();
+        }
+        sceneLoader.RequestTextureDetail(mainCamera.Position, projection[1][1] * renderHeight * 0.5f);
+        textureStreamer.Update(textureUploadBytesPerFrame);
+
+        // the frame as a graph of passes: the scene goes through an offscreen target only if there are post effects
+        // to apply (or it is scaled), straight to the screen otherwise
+        RenderResource screen = frameGraph.ImportTarget("screen", nullptr);
+        RenderResource shadowMaps = frameGraph.ImportResource("lamp shadow maps");
+        bool isOffscreen = postChain.NeedsSceneTarget(renderWidth, renderHeight, framebufferWidth, framebufferHeight);
+        RenderResource sceneColor = isOffscreen ? frameGraph.CreateTarget("scene", renderWidth, renderHeight, true) : screen;
+        if (toggles.isMultiViewOn) {
+            // nothing reads the single view then, the graph culls all of its passes
+            sceneColor = frameGraph.ImportResource("single view");
+            isOffscreen = false;
+        }
+        // every scene pass binds the target itself, the graph may put other passes in between
+        auto bindScene = [&]() {
+            glBindFramebuffer(GL_FRAMEBUFFER, frameGraph.GetFramebuffer(sceneColor));
+            glViewport(0, 0, renderWidth, renderHeight);
+        };
+
+        if (!sceneLights.empty()) {
+            // culled when shadows are off, nothing reads the maps then
+            frameGraph.AddPass("shadows", {}, { shadowMaps }, [&]() {
+                // nothing is drawn here while the lamp stands still and only static geometry casts shadows
+                lampShadow.Update(shadowDepthShader, lightPos, sceneLoader.GetStaticCasterVersion(), sceneLoader.HasDynamicCasters(),
+                    drawStaticCasters, drawDynamicCasters);
+            });
+        }
+        frameGraph.AddPass("clear", {}, { sceneColor }, [&]() {
+            bindScene();
+            glEnable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
+            glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        });
+
+        if (toggles.isDepthPrepassOn) {
+            frameGraph.AddPass("depth pre-pass", {}, { sceneColor }, [&]() {
+                bindScene();
+                // depth of everything with an expensive shader, the position-only draws first and the relief walls with their discard last
+                passStatistics.Begin(prepassStat);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                depthPrepassShader.Use();
+                depthPrepassShader.setMat4("projection", projection);
+                depthPrepassShader.setMat4("view", view);
+                sceneLoader.DrawDepth(NORMAL_SHADING, depthPrepassShader);
+                sceneLoader.DrawDepth(REFLECTION_SHADING, depthPrepassShader);
+                parallaxDepthShader.Use();
+                parallaxDepthShader.setMat4("projection", projection);
+                parallaxDepthShader.setMat4("view", view);
+                parallaxDepthShader.setVec3("viewPos", mainCamera.Position);
+                parallaxDepthShader.setVec3("lightPos", lightPos);
+                parallaxDepthShader.setFloat("heightScale", parallaxHeightScale);
+                sceneLoader.Draw(PARALLAX_SHADING, parallaxDepthShader);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                passStatistics.End();
+            });
+        }
+
+        vector<RenderResource> litReads;
+        if (toggles.isShadowsOn) {
+            litReads.push_back(shadowMaps);
+        }
+        frameGraph.AddPass("lit", litReads, { sceneColor }, [&]() {
+            bindScene();
+            if (toggles.isDepthPrepassOn) {
+                // the lit passes only shade the fragments that won the pre-pass
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+            }
+            parallaxShader.Use();
+            parallaxShader.setMat4("projection", projection);
+            parallaxShader.setMat4("view", view);
+
+            parallaxShader.setVec3("viewPos", mainCamera.Position);
+            parallaxShader.setVec3("lightPos", lightPos);
+            parallaxShader.setFloat("heightScale", parallaxHeightScale);
+            parallaxShader.setInt("selfShadowState", toggles.isParallaxSelfShadowing);
+            clusteredLighting.Bind(parallaxShader, 8, renderWidth, renderHeight);
+            lampShadow.Bind(parallaxShader, 11, toggles.isShadowsOn);
+            passStatistics.Begin(parallaxStat);
+            sceneLoader.Draw(PARALLAX_SHADING, parallaxShader);
+            passStatistics.End();
+
+            normalShader.Use();
+            normalShader.setMat4("projection", projection);
+            normalShader.setMat4("view", view);
+            normalShader.setVec3("viewPos", mainCamera.Position);
+            clusteredLighting.Bind(normalShader, 8, renderWidth, renderHeight);
+            lampShadow.Bind(normalShader, 11, toggles.isShadowsOn);
+            passStatistics.Begin(normalStat);
+            sceneLoader.Draw(NORMAL_SHADING, normalShader);
+            passStatistics.End();
+
+            modelShader.Use();
+            modelShader.setMat4("projection", projection);
+            modelShader.setMat4("view", view);
+            modelShader.setVec3("cameraPos", mainCamera.Position);
+            modelShader.setInt("reflectState", toggles.isFigureReflecting);
+            passStatistics.Begin(reflectionStat);
+            sceneLoader.Draw(REFLECTION_SHADING, modelShader);
+            passStatistics.End();
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+
+            cubeLampShader.Use();
+            cubeLampShader.setMat4("projection", projection);
+            cubeLampShader.setMat4("view", view);
+            sceneLoader.Draw(LAMP_SHADING, cubeLampShader);
+        });
+
+        frameGraph.AddPass("skybox", {}, { sceneColor }, [&]() {
+            bindScene();
+            // draw skybox as last
+            glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+            skyboxShader.Use();
+            glm::mat4 skyboxView = glm::mat4(glm::mat3(mainCamera.GetViewMatrix())); // remove translation from the view matrix
+            skyboxShader.setMat4("view", skyboxView);
+            skyboxShader.setMat4("projection", projection);
+            // skybox cube
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            GlStats::BindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            GlStats::DrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS);
+        });
+
+        if (isOffscreen) {
+            postChain.AddPasses(frameGraph, sceneColor, renderWidth, renderHeight, screen, framebufferWidth, framebufferHeight);
+        }
+        if (toggles.isMultiViewOn) {
+            views.clear();
+            float viewAspect = (GLfloat)framebufferWidth / 3 / framebufferHeight;
+            glm::mat4 viewProjection = glm::perspective(glm::radians(mainCamera.Zoom), viewAspect, 0.1f, 100.0f);
+            MultiViewTarget::AddStereoViews(views, mainCamera.Position, mainCamera.Front, mainCamera.Up, viewProjection, 0.064f);
+            // overview camera above and behind the viewer, looking at them
+            View overview;
+            overview.position = mainCamera.Position + glm::vec3(0.f, 8.f, 4.f);
+            overview.view = glm::lookAt(overview.position, mainCamera.Position, glm::vec3(0.f, 1.f, 0.f));
+            overview.projection = viewProjection;
+            views.push_back(overview);
+            multiViewTarget.Resize(framebufferWidth / views.size(), framebufferHeight, views.size());
+
+            RenderResource viewLayers = frameGraph.ImportResource("view layers");
+            frameGraph.AddPass("multi-view scene", {}, { viewLayers }, [&]() {
+                multiViewTarget.Begin();
+                multiViewShader.Use();
+                multiViewTarget.SetViews(multiViewShader, views);
+                multiViewShader.setVec3("lightPos", lightPos);
+                passStatistics.Begin(multiViewStat);
+                sceneLoader.Draw(PARALLAX_SHADING, multiViewShader);
+                sceneLoader.Draw(NORMAL_SHADING, multiViewShader);
+                sceneLoader.Draw(REFLECTION_SHADING, multiViewShader);
+                sceneLoader.Draw(LAMP_SHADING, multiViewShader);
+                passStatistics.End();
+            });
+            frameGraph.AddPass("present views", { viewLayers }, { screen }, [&]() {
+                multiViewTarget.Present(framebufferWidth, framebufferHeight);
+            });
+        }
+        if (toggles.isStatsOverlayOn) {
+            // the last pass drawing to the screen, over whatever the frame ended up with
+            frameGraph.AddPass("stats overlay", {}, { screen }, [&]() {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                statsOverlay.Draw(framebufferWidth, framebufferHeight, (float)frameBudgetMs);
+            });
+        }
+        frameGraph.Execute();
+        frameTimer.End();
+        GlStats::EndFrame();
+        passStatistics.Poll();
+        if (toggles.debugLevel > 0 && glfwGetTime() - lastStatisticsReport > 2.0) {
+            unsigned long long shaded = passStatistics.GetSamples(parallaxStat) + passStatistics.GetSamples(normalStat)
+                + passStatistics.GetSamples(reflectionStat);
+            unsigned long long rasterized = passStatistics.GetSamples(prepassStat);
+            LOG(LOG_INFO) << "Shaded fragments: " << shaded << " (" << (double)shaded / (renderWidth * renderHeight) << " per pixel)"
+                << (toggles.isDepthPrepassOn ? ", overdraw saved by the depth pre-pass: " : "")
+                << (toggles.isDepthPrepassOn ? std::to_string(rasterized > shaded ? rasterized - shaded : 0) : "");
+            if (toggles.isOcclusionCullingOn) {
+                LOG(LOG_INFO) << "Occlusion culling: " << occlusionCuller.GetOccludedCount() << " of " << occlusionCuller.GetTestedCount()
+                    << " objects hidden, " << occlusionCuller.GetOutsideCount() << " outside the view ("
+                    << occlusionCuller.GetOccluderTriangleCount() << " occluder triangles)";
+            }
+            LOG(LOG_INFO) << "GL: " << GlStats::Get(GL_STAT_DRAW_CALLS) << " draw calls, " << GlStats::Get(GL_STAT_TRIANGLES)
+                << " triangles, " << GlStats::Get(GL_STAT_PROGRAM_SWITCHES) << " program switches, " << GlStats::Get(GL_STAT_TEXTURE_BINDS)
+                << " texture binds, " << GlStats::Get(GL_STAT_UNIFORM_UPLOADS) << " uniform uploads, "
+                << GlStats::Get(GL_STAT_BUFFER_BYTES) << " buffer bytes, " << GlStats::Get(GL_STAT_TEXTURE_BYTES) << " texture bytes; frame p50/p95/p99 " << statsOverlay.GetPercentile(50.f)
+                << "/" << statsOverlay.GetPercentile(95.f) << "/" << statsOverlay.GetPercentile(99.f) << " ms";
+            LOG(LOG_INFO) << "Render graph: " << frameGraph.GetExecutedPassCount() << " passes, " << frameGraph.GetCulledPassCount()
+                << " culled, transient targets " << (frameGraph.GetPeakTransientBytes() >> 20) << " MB alive at once of "
+                << (frameGraph.GetTotalTransientBytes() >> 20) << " MB";
+            if (frameCapture.IsRecording()) {
+                LOG(LOG_INFO) << "Capture: " << frameCapture.GetWrittenCount() << " frames written, " << frameCapture.GetDroppedCount()
+                    << " dropped";
+            }
+            LOG(LOG_INFO) << "Textures: " << (textureStreamer.GetResidentBytes() >> 20) << " of " << (textureStreamer.GetBudget() >> 20)
+                << " MB, " << textureStreamer.GetLoadingCount() << " of " << textureStreamer.GetTextureCount() << " loading finer mips";
+            GpuResourceRegistry::Get().LogSummary();
+            lastStatisticsReport = glfwGetTime();
+        }
+        // render scale changes leave targets of the previous size behind
+        renderTargets.EndFrame(120);
+        if (!toggles.isCapturePaused) {
+            frameCapture.Capture(framebufferWidth, framebufferHeight);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+        // swap to swap, the time the frame was on screen
+        double frameTime = glfwGetTime();
+        statsOverlay.AddFrame((float)((frameTime - lastFrameTime) * 1000.0));
+        lastFrameTime = frameTime;
+    }
+    sceneSimulation.Stop();
+    simulation = nullptr;
+    frameCapture.Stop();
+    renderTargets.Clear();
+    multiViewTarget.Clear();
+    clusteredLighting.Clear();
+    lampShadow.Clear();
+    passStatistics.Clear();
+    sceneLoader.Clear();
+    textureStreamer.Clear();
+    statsOverlay.Clear();
+    Shader *shaders[] = { &skyboxShader, &parallaxShader, &normalShader, &modelShader, &cubeLampShader, &screenShader, &gammaShader,
+                          &blurShader, &sharpenShader, &vignetteShader, &upscaleShader, &shadowDepthShader, &depthPrepassShader,
+                          &parallaxDepthShader, &multiViewShader };
+    for (unsigned int i = 0; i < sizeof(shaders) / sizeof(shaders[0]); i++)
+        shaders[i]->Delete();
+    for (unsigned int i = 0; i < computeShaders.size(); i++)
+    {
+        computeShaders[i]->Delete();
+        delete computeShaders[i];
+    }
+    unsigned int vertexArrays[] = { skyboxVAO, quadVAO }, buffers[] = { skyboxVBO, quadVBO };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        GpuResourceRegistry::Get().Remove(GPU_VERTEX_ARRAY, vertexArrays[i]);
+        GpuResourceRegistry::Get().Remove(GPU_BUFFER, buffers[i]);
     }
+    glDeleteVertexArrays(2, vertexArrays);
+    glDeleteBuffers(2, buffers);
+    GpuResourceRegistry::Get().Remove(GPU_TEXTURE, cubemapTexture);
+    glDeleteTextures(1, &cubemapTexture);
+    // whatever is still registered here was never freed
+    GpuResourceRegistry::Get().ReportLeaks();
     glfwTerminate();
+    Logger::Get().Stop();
     return 0;
 }